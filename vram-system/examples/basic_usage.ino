@@ -18,6 +18,8 @@
 // Include VRAM system headers
 #include "../m5client/memory_manager.h"
 #include "../m5client/resource_cache.h"
+#include "../m5client/resource_loader.h"
+#include "../m5client/memory_pressure.h"
 #include "../m5client/wifi_manager.h"
 
 // Configuration - CHANGE THESE FOR YOUR SETUP
@@ -26,9 +28,12 @@ const char* WIFI_PASSWORD = "your_wifi_password";
 const char* SERVER_URL = "http://192.168.1.100:5000";  // Change to your server IP
 
 // Global objects
+VramLogger vramLog;
 MemoryManager memoryManager;
 ResourceCache resourceCache;
+MemoryPressure memoryPressure(memoryManager, resourceCache);
 WiFiManager wifiManager;
+ResourceLoader resourceLoader(resourceCache, wifiManager.getSession());
 
 // Demo state
 int demoStep = 0;
@@ -134,6 +139,9 @@ void initializeVRAMSystem() {
   resourceCache.setMaxCacheSize(128 * 1024);  // 128KB cache for demo
   Serial.println("✓ Resource cache initialized");
   
+  // Evict on memory pressure, and whenever an allocation fails
+  memoryPressure.begin();
+  
   // Configure WiFi manager
   wifiManager.setCredentials(WIFI_SSID, WIFI_PASSWORD);
   wifiManager.setServerURL(SERVER_URL);
@@ -183,20 +191,27 @@ void loadDemoResources() {
   Serial.println("Loading demo resources...");
   showStatus("Loading Resources...");
   
-  // Load different types of resources
-  loadResource("config_main", PRIORITY_CRITICAL);
-  delay(500);
-  
-  loadResource("lib_sensor", PRIORITY_IMPORTANT);
-  delay(500);
-  
-  loadResource("ui_strings", PRIORITY_IMPORTANT);
-  delay(500);
-  
-  loadResource("data_sample", PRIORITY_NORMAL);
-  delay(500);
+  // Load different types of resources in one batch request
+  BatchItem demoResources[] = {
+    {"config_main", PRIORITY_CRITICAL, 0, 0},
+    {"lib_sensor", PRIORITY_IMPORTANT, 0, 0},
+    {"ui_strings", PRIORITY_IMPORTANT, 0, 0},
+    {"data_sample", PRIORITY_NORMAL, 0, 0}
+  };
+  size_t count = sizeof(demoResources) / sizeof(demoResources[0]);
+  
+  int loaded = resourceLoader.fetchBatch("/api/resources/batch", demoResources, count);
+  for (size_t i = 0; i < count; i++) {
+    if (demoResources[i].status == HTTP_CODE_OK) {
+      Serial.printf("✓ Resource %s cached\n", demoResources[i].resourceId.c_str());
+    } else if (demoResources[i].status == HTTP_CODE_NOT_MODIFIED) {
+      Serial.printf("✓ Resource %s unchanged\n", demoResources[i].resourceId.c_str());
+    } else {
+      Serial.printf("✗ Resource %s not loaded (%d)\n", demoResources[i].resourceId.c_str(), demoResources[i].status);
+    }
+  }
   
-  Serial.println("✓ Demo resources loaded");
+  Serial.printf("✓ %d/%d demo resources loaded\n", loaded, count);
   showStatus("Resources Loaded!");
   delay(2000);
 }
@@ -204,42 +219,27 @@ void loadDemoResources() {
 bool loadResource(const String& resourceId, int priority) {
   Serial.printf("Loading resource: %s (priority: %d)\n", resourceId.c_str(), priority);
   
-  HTTPClient http;
-  String url = wifiManager.getServerURL() + "/api/resources/" + resourceId;
-  
-  http.begin(url);
-  http.setTimeout(10000);
-  
-  int httpCode = http.GET();
-  bool success = false;
+  // The loader streams the payload directly into the cache over the shared connection.
+  // A cached copy is patched in place from a delta when the server has one.
+  String path = "/api/resources/" + resourceId;
+  bool success = resourceCache.getVersion(resourceId) > 0 &&
+                 resourceLoader.fetchDelta(path + "/delta", resourceId, priority);
+  if (!success) {
+    success = resourceLoader.fetchRaw(path + "/raw", resourceId, priority);
+  }
   
-  if (httpCode == HTTP_CODE_OK) {
-    String payload = http.getString();
-    
-    // Parse JSON response
-    DynamicJsonDocument doc(4096);
-    DeserializationError error = deserializeJson(doc, payload);
-    
-    if (!error) {
-      String data = doc["data"];
-      int size = doc["size"] | data.length();
-      
-      // Store in cache
-      success = resourceCache.store(resourceId, data, priority, size);
-      
-      if (success) {
-        Serial.printf("✓ Resource %s cached (%d bytes)\n", resourceId.c_str(), size);
-      } else {
-        Serial.printf("✗ Failed to cache resource %s\n", resourceId.c_str());
-      }
-    } else {
-      Serial.printf("✗ JSON parse error for %s: %s\n", resourceId.c_str(), error.c_str());
-    }
+  if (success && resourceLoader.getLastHttpCode() == HTTP_CODE_NOT_MODIFIED) {
+    Serial.printf("✓ Resource %s unchanged on server, cached copy kept\n", resourceId.c_str());
+  } else if (success && resourceLoader.wasPatched()) {
+    Serial.printf("✓ Resource %s patched to version %d\n", resourceId.c_str(), resourceLoader.getLastVersion());
+  } else if (success) {
+    Serial.printf("✓ Resource %s cached (%d bytes)\n", resourceId.c_str(), resourceLoader.getLastSize());
+  } else if (resourceLoader.getLastHttpCode() != HTTP_CODE_OK) {
+    Serial.printf("✗ HTTP error for %s: %d\n", resourceId.c_str(), resourceLoader.getLastHttpCode());
   } else {
-    Serial.printf("✗ HTTP error for %s: %d\n", resourceId.c_str(), httpCode);
+    Serial.printf("✗ Failed to cache resource %s\n", resourceId.c_str());
   }
   
-  http.end();
   return success;
 }
 
@@ -314,8 +314,8 @@ void handlePowerButton() {
   size_t targetFreeBytes = 50 * 1024;  // Try to free 50KB
   int freedResources = resourceCache.freeMemory(targetFreeBytes);
   
-  // Force garbage collection
-  memoryManager.forceGarbageCollection();
+  // Move the remaining payloads together so the freed pages form one run
+  resourceCache.compact();
   
   // Print stats after cleanup
   Serial.println("=== After Cleanup ===");
@@ -369,10 +369,11 @@ void runAutomatedDemo() {
 }
 
 void demonstrateResourceRetrieval() {
-  // Try to get a cached resource
-  String data = resourceCache.get("config_main");
-  if (!data.isEmpty()) {
-    Serial.printf("✓ Retrieved cached resource: %s\n", data.substring(0, 50).c_str());
+  // Borrow a cached resource in place; the view pins it until it goes out of scope
+  ResourceView data = resourceCache.view("config_main");
+  if (data) {
+    int preview = data.length() < 50 ? data.length() : 50;
+    Serial.printf("✓ Retrieved cached resource: %.*s\n", preview, data.data());
   } else {
     Serial.println("✗ Resource not in cache, would need to fetch from server");
   }
@@ -380,14 +381,14 @@ void demonstrateResourceRetrieval() {
 
 void demonstrateCacheHitMiss() {
   // Access existing resource (cache hit)
-  String hit = resourceCache.get("ui_strings");
+  ResourceView hit = resourceCache.view("ui_strings");
   
   // Access non-existing resource (cache miss)
-  String miss = resourceCache.get("nonexistent_resource");
+  ResourceView miss = resourceCache.view("nonexistent_resource");
   
   Serial.printf("Cache hit: %s, Cache miss: %s\n", 
-                hit.isEmpty() ? "false" : "true",
-                miss.isEmpty() ? "true" : "false");
+                hit ? "true" : "false",
+                miss ? "false" : "true");
 }
 
 void demonstrateMemoryMonitoring() {
@@ -410,16 +411,16 @@ void demonstrateAutomaticCleanup() {
   MemoryInfo memInfo = memoryManager.getMemoryInfo();
   
   // Simulate high memory usage condition
-  if (memInfo.usagePercent < 70) {
+  if (memInfo.usagePercent < memoryPressure.getLowWatermark()) {
     Serial.println("Memory usage normal, cleanup not needed");
     return;
   }
   
   Serial.println("Triggering automatic cleanup...");
   
-  // Free some resources using LRU algorithm
-  size_t targetBytes = (memInfo.totalHeap * 20) / 100;  // 20% of total
-  int freed = resourceCache.freeMemory(targetBytes);
+  // Evicts only what it takes to get back under the low watermark
+  int freed = memoryPressure.relieve();
   
   Serial.printf("Automatic cleanup freed %d resources\n", freed);
+  memoryPressure.printStats();
 }
\ No newline at end of file
@@ -0,0 +1,358 @@
+/*
+ * VRAM System - Benchmark
+ * Times the cache, allocator and loader hot paths on the device
+ *
+ * Every case prints one JSON object per line on Serial, so runs can be
+ * captured and compared across commits and eviction policies:
+ *   {"bench":"cache_store","variant":"TinyLFU","entries":64,"payload":1024,
+ *    "ops":64,"failures":0,"ops_per_sec":...,"p50_us":...,"p99_us":...,
+ *    "heap_min_free":...,"heap_frag":...,"pool_frag":...,"peak_tracked":...}
+ * Latencies come from the CPU cycle counter. Local cases run before WiFi
+ * is started, so its task does not interrupt them; the loader cases need
+ * the VRAM server from vram-system/server with its demo resources.
+ *
+ * Press button A to run again.
+ */
+
+// Info lines would land inside the timed regions
+#define VRAM_LOG_LEVEL VRAM_LOG_WARN
+
+#include <M5StickCPlus2.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <algorithm>
+
+#include "../../m5client/memory_manager.h"
+#include "../../m5client/resource_cache.h"
+#include "../../m5client/resource_loader.h"
+#include "../../m5client/wifi_manager.h"
+
+// Configuration - CHANGE THESE FOR YOUR SETUP; leave the SSID empty to skip the loader cases
+const char* WIFI_SSID = "your_wifi_ssid";
+const char* WIFI_PASSWORD = "your_wifi_password";
+const char* SERVER_URL = "http://192.168.1.100:5000";
+
+// Benchmark configuration
+#define BENCH_MAX_SAMPLES     512         // Latencies kept per case; more operations are sampled
+#define BENCH_ROUNDS          8           // Passes over the entries for read cases
+#define BENCH_MAX_ENTRIES     192         // Largest entry count below
+#define BENCH_ALLOC_BUDGET    (64 * 1024) // Bytes held at once by an allocator case
+#define BENCH_LOAD_REPEATS    16          // Downloads per resource
+
+const int benchEntries[] = {16, 64, BENCH_MAX_ENTRIES};
+const size_t benchPayloads[] = {64, 1024, 4096};
+const size_t benchAllocSizes[] = {32, 256, 2048, 8192};
+const char* benchResources[] = {"config_main", "lib_sensor", "ui_strings", "data_sample"};
+
+// One measured case
+struct BenchCase {
+  const char* name;
+  const char* variant;                      // Policy, allocator or resource measured
+  int entries;
+  size_t payload;
+  unsigned long ops;
+  unsigned long failures;
+  uint64_t totalCycles;
+  uint32_t samples[BENCH_MAX_SAMPLES];
+  int sampleCount;
+  uint32_t minFreeHeap;
+};
+
+// Global objects
+VramLogger vramLog;
+MemoryManager memoryManager;
+ResourceCache resourceCache;
+WiFiManager wifiManager;
+ResourceLoader resourceLoader(resourceCache, wifiManager.getSession());
+LruPolicy lruPolicy;
+
+BenchCase bench;
+int casesRun = 0;
+String hitIds[BENCH_MAX_ENTRIES];           // Stored by the cache cases
+String missIds[BENCH_MAX_ENTRIES];          // Never stored
+void* blocks[BENCH_ALLOC_BUDGET / 32];
+
+void setup() {
+  auto cfg = M5.config();
+  M5.begin(cfg);
+  M5.Display.setRotation(1);
+  M5.Display.setTextColor(GREEN);
+  M5.Display.setTextDatum(middle_center);
+  M5.Display.setFont(&fonts::Orbitron_Light_24);
+  M5.Display.setTextSize(1);
+  
+  Serial.begin(115200);
+  delay(1000);
+  
+  for (int i = 0; i < BENCH_MAX_ENTRIES; i++) {
+    char id[CACHE_ID_LENGTH];
+    snprintf(id, sizeof(id), "bench_%03d", i);
+    hitIds[i] = id;
+    snprintf(id, sizeof(id), "miss_%03d", i);
+    missIds[i] = id;
+  }
+  
+  memoryManager.begin();
+  resourceCache.begin();
+  
+  wifiManager.setCredentials(WIFI_SSID, WIFI_PASSWORD);
+  wifiManager.setServerURL(SERVER_URL);
+  
+  runBenchmarks();
+}
+
+void loop() {
+  M5.update();
+  wifiManager.update();
+  
+  if (M5.BtnA.wasPressed()) {
+    runBenchmarks();
+  }
+  
+  delay(100);
+}
+
+void showStatus(const char* message) {
+  M5.Display.clear();
+  M5.Display.drawString("VRAM Bench", M5.Display.width() / 2, 20);
+  M5.Display.setTextColor(YELLOW);
+  M5.Display.drawString(message, M5.Display.width() / 2, 60);
+  M5.Display.setTextColor(GREEN);
+}
+
+void runBenchmarks() {
+  casesRun = 0;
+  Serial.printf("{\"run\":\"start\",\"cpu_mhz\":%u,\"heap_size\":%u,\"psram\":%s,\"pool_size\":%u}\n",
+                ESP.getCpuFreqMHz(), ESP.getHeapSize(), psramFound() ? "true" : "false",
+                memoryManager.getPool().getCapacity());
+  
+  showStatus("Cache...");
+  runCacheCases("TinyLFU");
+  resourceCache.setEvictionPolicy(&lruPolicy);
+  runCacheCases(lruPolicy.name());
+  resourceCache.setEvictionPolicy(nullptr);
+  
+  showStatus("Allocator...");
+  runAllocatorCases();
+  
+  showStatus("Loader...");
+  runLoaderCases();
+  
+  Serial.printf("{\"run\":\"done\",\"cases\":%d}\n", casesRun);
+  showStatus("Done");
+}
+
+// Measurement
+void beginCase(const char* name, const char* variant, int entries, size_t payload) {
+  memset(&bench, 0, sizeof(bench));
+  bench.name = name;
+  bench.variant = variant;
+  bench.entries = entries;
+  bench.payload = payload;
+  bench.minFreeHeap = ESP.getFreeHeap();
+  memoryManager.resetStatistics();
+}
+
+void record(uint32_t cycles, bool ok = true) {
+  bench.ops++;
+  bench.totalCycles += cycles;
+  if (!ok) bench.failures++;
+  
+  // Reservoir sampling keeps every operation equally likely to be in the percentiles
+  if (bench.sampleCount < BENCH_MAX_SAMPLES) {
+    bench.samples[bench.sampleCount++] = cycles;
+  } else {
+    uint32_t slot = esp_random() % bench.ops;
+    if (slot < BENCH_MAX_SAMPLES) bench.samples[slot] = cycles;
+  }
+  
+  uint32_t freeHeap = ESP.getFreeHeap();
+  if (freeHeap < bench.minFreeHeap) bench.minFreeHeap = freeHeap;
+}
+
+float cyclesToMicros(uint32_t cycles) {
+  return (float)cycles / ESP.getCpuFreqMHz();
+}
+
+void endCase() {
+  if (bench.ops == 0) return;
+  
+  std::sort(bench.samples, bench.samples + bench.sampleCount);
+  uint32_t p50 = bench.samples[bench.sampleCount / 2];
+  uint32_t p99 = bench.samples[(bench.sampleCount * 99) / 100];
+  double seconds = (double)bench.totalCycles / (ESP.getCpuFreqMHz() * 1000000.0);
+  MemoryInfo info = memoryManager.getMemoryInfo();
+  
+  Serial.printf("{\"bench\":\"%s\",\"variant\":\"%s\",\"entries\":%d,\"payload\":%u,"
+                "\"ops\":%lu,\"failures\":%lu,\"ops_per_sec\":%.1f,\"p50_us\":%.2f,\"p99_us\":%.2f,"
+                "\"heap_min_free\":%u,\"heap_frag\":%d,\"pool_frag\":%d,\"peak_tracked\":%u}\n",
+                bench.name, bench.variant, bench.entries, bench.payload,
+                bench.ops, bench.failures, seconds > 0 ? bench.ops / seconds : 0.0,
+                cyclesToMicros(p50), cyclesToMicros(p99),
+                bench.minFreeHeap, info.fragmentation, memoryManager.getPool().getFragmentation(),
+                memoryManager.getPeakUsage());
+  casesRun++;
+}
+
+// Cache cases: store, copying and borrowed reads, misses and freeing space
+void fillCache(int entries, const String& data) {
+  for (int i = 0; i < entries; i++) {
+    resourceCache.store(hitIds[i], data, PRIORITY_NORMAL);
+  }
+}
+
+void runCacheCases(const char* policy) {
+  for (size_t p = 0; p < sizeof(benchPayloads) / sizeof(benchPayloads[0]); p++) {
+    size_t payload = benchPayloads[p];
+    String data;
+    data.reserve(payload);
+    for (size_t i = 0; i < payload; i++) data += (char)('a' + i % 26);
+    
+    for (size_t e = 0; e < sizeof(benchEntries) / sizeof(benchEntries[0]); e++) {
+      int entries = benchEntries[e];
+      resourceCache.clear();
+      
+      // Past the cache limit, stores include evictions
+      beginCase("cache_store", policy, entries, payload);
+      for (int i = 0; i < entries; i++) {
+        uint32_t start = ESP.getCycleCount();
+        bool ok = resourceCache.store(hitIds[i], data, PRIORITY_NORMAL);
+        record(ESP.getCycleCount() - start, ok);
+      }
+      endCase();
+      
+      // Entries evicted above count as failures
+      beginCase("cache_get", policy, entries, payload);
+      for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (int i = 0; i < entries; i++) {
+          uint32_t start = ESP.getCycleCount();
+          bool ok = resourceCache.get(hitIds[i]).length() > 0;
+          record(ESP.getCycleCount() - start, ok);
+        }
+      }
+      endCase();
+      
+      beginCase("cache_view", policy, entries, payload);
+      for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (int i = 0; i < entries; i++) {
+          uint32_t start = ESP.getCycleCount();
+          bool ok = resourceCache.view(hitIds[i]).valid();
+          record(ESP.getCycleCount() - start, ok);
+        }
+      }
+      endCase();
+      
+      beginCase("cache_miss", policy, entries, payload);
+      for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (int i = 0; i < entries; i++) {
+          uint32_t start = ESP.getCycleCount();
+          resourceCache.get(missIds[i]);
+          record(ESP.getCycleCount() - start);
+        }
+      }
+      endCase();
+      
+      // A quarter of the cache each time, refilled between rounds
+      beginCase("cache_free", policy, entries, payload);
+      for (int round = 0; round < BENCH_ROUNDS; round++) {
+        fillCache(entries, data);
+        uint32_t start = ESP.getCycleCount();
+        int freed = resourceCache.freeMemory(resourceCache.getCacheSize() / 4);
+        record(ESP.getCycleCount() - start, freed > 0);
+      }
+      endCase();
+    }
+  }
+  resourceCache.clear();
+}
+
+// Allocator cases: tracked allocation and release, then churn on a half-freed pool
+void runAllocatorCases() {
+  for (size_t s = 0; s < sizeof(benchAllocSizes) / sizeof(benchAllocSizes[0]); s++) {
+    size_t size = benchAllocSizes[s];
+    int count = std::min((int)(BENCH_ALLOC_BUDGET / size), BENCH_MAX_ENTRIES);
+    
+    beginCase("mem_allocate", "slab", count, size);
+    for (int i = 0; i < count; i++) {
+      uint32_t start = ESP.getCycleCount();
+      blocks[i] = memoryManager.allocate(size, "bench");
+      record(ESP.getCycleCount() - start, blocks[i] != nullptr);
+    }
+    endCase();
+    
+    beginCase("mem_deallocate", "slab", count, size);
+    for (int i = 0; i < count; i++) {
+      if (blocks[i] == nullptr) continue;
+      uint32_t start = ESP.getCycleCount();
+      memoryManager.deallocate(blocks[i]);
+      record(ESP.getCycleCount() - start);
+      blocks[i] = nullptr;
+    }
+    endCase();
+    
+    // Every other block freed, then each hole freed and refilled in turn;
+    // the fragmentation reported is that of the churned pool
+    for (int i = 0; i < count; i++) {
+      blocks[i] = memoryManager.allocate(size, "bench");
+    }
+    for (int i = 0; i < count; i += 2) {
+      memoryManager.deallocate(blocks[i]);
+      blocks[i] = nullptr;
+    }
+    beginCase("mem_churn", "slab", count, size);
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+      for (int i = 0; i < count; i += 2) {
+        uint32_t start = ESP.getCycleCount();
+        void* block = memoryManager.allocate(size, "bench");
+        memoryManager.deallocate(block);
+        record(ESP.getCycleCount() - start, block != nullptr);
+      }
+    }
+    endCase();
+    for (int i = 0; i < count; i++) {
+      if (blocks[i] != nullptr) memoryManager.deallocate(blocks[i]);
+      blocks[i] = nullptr;
+    }
+  }
+}
+
+// Loader cases: full downloads into the cache, then 304 revalidations
+void runLoaderCases() {
+  if (strlen(WIFI_SSID) == 0 || (!wifiManager.isConnected() && !wifiManager.connect())) {
+    Serial.println("{\"run\":\"skipped\",\"reason\":\"no wifi\"}");
+    return;
+  }
+  
+  SessionStats before = wifiManager.getSession().getStats();
+  for (size_t r = 0; r < sizeof(benchResources) / sizeof(benchResources[0]); r++) {
+    String resourceId = benchResources[r];
+    String path = "/api/resources/" + resourceId + "/raw";
+    
+    beginCase("load_raw", benchResources[r], 1, 0);
+    for (int i = 0; i < BENCH_LOAD_REPEATS; i++) {
+      resourceCache.remove(resourceId);
+      uint32_t start = ESP.getCycleCount();
+      bool ok = resourceLoader.fetchRaw(path, resourceId, PRIORITY_NORMAL);
+      record(ESP.getCycleCount() - start, ok);
+    }
+    bench.payload = resourceLoader.getLastSize();
+    endCase();
+    
+    beginCase("load_revalidate", benchResources[r], 1, bench.payload);
+    for (int i = 0; i < BENCH_LOAD_REPEATS; i++) {
+      uint32_t start = ESP.getCycleCount();
+      bool ok = resourceLoader.fetchRaw(path, resourceId, PRIORITY_NORMAL);
+      record(ESP.getCycleCount() - start,
+             ok && resourceLoader.getLastHttpCode() == HTTP_CODE_NOT_MODIFIED);
+    }
+    endCase();
+  }
+  
+  // Every load after the first should find the connection still open
+  SessionStats after = wifiManager.getSession().getStats();
+  unsigned long requests = after.requests - before.requests;
+  unsigned long reused = after.reusedConnections - before.reusedConnections;
+  Serial.printf("{\"check\":\"keep_alive\",\"requests\":%lu,\"reused\":%lu,\"reconnects\":%lu,\"ok\":%s}\n",
+                requests, reused, after.reconnects - before.reconnects,
+                reused + 1 >= requests ? "true" : "false");
+}
\ No newline at end of file
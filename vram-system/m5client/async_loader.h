@@ -0,0 +1,491 @@
+/*
+ * Async Loader for VRAM System
+ * Runs resource downloads on a dedicated FreeRTOS task so the main loop
+ * never waits on the network
+ */
+
+#ifndef ASYNC_LOADER_H
+#define ASYNC_LOADER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include "http_session.h"
+#include "memory_manager.h"
+#include "resource_cache.h"
+#include "resource_loader.h"
+#include "resource_manifest.h"
+#include "vram_log.h"
+
+// Worker configuration
+#define ASYNC_QUEUE_LENGTH    8             // Requests waiting for the worker
+#define ASYNC_RESULT_LENGTH   8             // Completions waiting for poll()
+#define ASYNC_TASK_STACK      8192
+#define ASYNC_TASK_PRIORITY   1
+#define ASYNC_TASK_CORE       0             // Arduino loop() runs on core 1
+#define ASYNC_OFFLINE_WAIT    60000         // A demand job waits this long for WiFi to come back (ms)
+
+// Prefetch configuration
+#define ASYNC_PREFETCH_LENGTH     4         // Hinted resources waiting behind demand requests
+#define ASYNC_PREFETCH_POLL       100       // Idle wait before the worker looks at prefetches (ms)
+#define ASYNC_PREFETCH_MAX_USAGE  70        // No prefetching above this heap usage (%)
+#define ASYNC_PREFETCH_MAX_CACHE  75        // ...or above this share of the cache budget (%)
+
+// Job types
+enum AsyncJobType {
+  ASYNC_JOB_FETCH,                          // Download a resource from the /raw endpoint
+  ASYNC_JOB_HEALTH,                         // HEAD /api/health
+  ASYNC_JOB_PREFETCH,                       // Speculative fetch of a hinted resource at PRIORITY_LOW
+  ASYNC_JOB_METRICS,                        // Report the loader's stage histograms
+  ASYNC_JOB_MANIFEST                        // Fetch or revalidate the resource manifest
+};
+
+struct AsyncResult;
+typedef void (*AsyncCallback)(const AsyncResult& result, void* context);
+
+// Queued work item; plain data so it can be copied through a FreeRTOS queue
+struct AsyncRequest {
+  AsyncJobType type;
+  char resourceId[CACHE_ID_LENGTH];
+  int priority;
+  bool compress;
+  AsyncCallback callback;
+  void* context;
+};
+
+// Completion, delivered to the callback from poll()
+struct AsyncResult {
+  AsyncJobType type;
+  char resourceId[CACHE_ID_LENGTH];
+  int httpCode;               // 304 when the cached copy was current
+  size_t size;                // Stored bytes, 0 unless a body was downloaded
+  bool patched;               // Cached copy updated in place from a delta
+  bool success;
+  unsigned long elapsed;      // Time spent on the network (ms)
+  AsyncCallback callback;
+  void* context;
+};
+
+// Async loader statistics
+struct AsyncStats {
+  unsigned long queued;
+  unsigned long completed;
+  unsigned long failed;
+  unsigned long dropped;      // Rejected because the request queue was full
+  unsigned long prefetched;   // Hinted resources downloaded ahead of demand
+  unsigned long patched;      // Cached copies brought up to date from a delta
+  unsigned long declined;     // Not downloaded: the manifest size says the cache would not keep it
+};
+
+// Once begin() has run, the worker task owns the ResourceLoader; other
+// code reaches the network through request() or the locked HttpSession.
+// Callbacks run on the task that calls poll(), never on the worker.
+// Server prefetch hints are queued separately and only run when no
+// demand request is waiting. While the session is offline, demand
+// requests wait for the network and prefetches are skipped. With a
+// manifest, resources it lists are weighed by size before any request.
+class AsyncLoader {
+private:
+  ResourceLoader& loader;
+  ResourceCache& cache;
+  HttpSession& session;
+  ResourceManifest* manifest;
+  QueueHandle_t requests;
+  QueueHandle_t prefetches;
+  QueueHandle_t results;
+  TaskHandle_t worker;
+  volatile bool busy;
+  AsyncStats stats;
+  portMUX_TYPE statsLock;     // Both tasks queue work
+  
+  static void taskEntry(void* param);
+  void run();
+  void process(const AsyncRequest& job, AsyncResult& result);
+  bool enqueue(const AsyncRequest& job);
+  bool hasHeadroom();
+  bool admits(const char* resourceId, int priority, bool speculative);
+  void countDeclined();
+
+public:
+  AsyncLoader(ResourceLoader& resourceLoader, ResourceCache& resourceCache, HttpSession& httpSession);
+  
+  // Creates the queues and starts the worker on ASYNC_TASK_CORE
+  bool begin();
+  bool isRunning() { return worker != nullptr; }
+  
+  // Queue work; returns false if the request was not accepted.
+  // Critical resources jump ahead of anything already queued.
+  bool request(const String& resourceId, int priority, AsyncCallback callback = nullptr,
+               void* context = nullptr, bool compress = false);
+  bool requestHealthCheck(AsyncCallback callback, void* context = nullptr);
+  bool requestMetricsReport(AsyncCallback callback = nullptr, void* context = nullptr);  // Needs loader metrics
+  bool requestManifestRefresh(AsyncCallback callback = nullptr, void* context = nullptr);  // Needs setManifest()
+  
+  // Size-aware admission for uncached resources and prefetches; call before begin()
+  void setManifest(ResourceManifest* resourceManifest) { manifest = resourceManifest; }
+  
+  // Queue hinted resources (comma-separated IDs) that are not cached yet,
+  // as long as memory allows and, by manifest size, they fit within the
+  // prefetch share of the cache. Returns how many were queued.
+  int prefetch(const String& hints);
+  
+  // Deliver finished jobs to their callbacks; call from loop(). Returns the count.
+  int poll();
+  
+  // Status
+  bool isBusy() { return busy; }
+  size_t getPending();
+  AsyncStats getStats();
+  void printStats();
+};
+
+// Implementation
+AsyncLoader::AsyncLoader(ResourceLoader& resourceLoader, ResourceCache& resourceCache, HttpSession& httpSession)
+  : loader(resourceLoader), cache(resourceCache), session(httpSession) {
+  manifest = nullptr;
+  requests = nullptr;
+  prefetches = nullptr;
+  results = nullptr;
+  worker = nullptr;
+  busy = false;
+  memset(&stats, 0, sizeof(stats));
+  statsLock = portMUX_INITIALIZER_UNLOCKED;
+}
+
+bool AsyncLoader::begin() {
+  if (worker != nullptr) return true;
+  
+  requests = xQueueCreate(ASYNC_QUEUE_LENGTH, sizeof(AsyncRequest));
+  prefetches = xQueueCreate(ASYNC_PREFETCH_LENGTH, sizeof(AsyncRequest));
+  results = xQueueCreate(ASYNC_RESULT_LENGTH, sizeof(AsyncResult));
+  if (requests == nullptr || prefetches == nullptr || results == nullptr) {
+    VRAM_LOGE("async", "Cannot create loader queues");
+    return false;
+  }
+  
+  if (xTaskCreatePinnedToCore(taskEntry, "vram_loader", ASYNC_TASK_STACK, this,
+                              ASYNC_TASK_PRIORITY, &worker, ASYNC_TASK_CORE) != pdPASS) {
+    VRAM_LOGE("async", "Cannot start loader task");
+    worker = nullptr;
+    return false;
+  }
+  
+  VRAM_LOGI("async", "Loader task started on core %d", ASYNC_TASK_CORE);
+  return true;
+}
+
+bool AsyncLoader::request(const String& resourceId, int priority, AsyncCallback callback,
+                          void* context, bool compress) {
+  if (resourceId.length() >= CACHE_ID_LENGTH) {
+    VRAM_LOGW("async", "Resource ID too long: %s", resourceId.c_str());
+    return false;
+  }
+  
+  AsyncRequest job;
+  job.type = ASYNC_JOB_FETCH;
+  strcpy(job.resourceId, resourceId.c_str());
+  job.priority = priority;
+  job.compress = compress;
+  job.callback = callback;
+  job.context = context;
+  return enqueue(job);
+}
+
+bool AsyncLoader::requestHealthCheck(AsyncCallback callback, void* context) {
+  AsyncRequest job;
+  job.type = ASYNC_JOB_HEALTH;
+  job.resourceId[0] = '\0';
+  job.priority = PRIORITY_CRITICAL;
+  job.compress = false;
+  job.callback = callback;
+  job.context = context;
+  return enqueue(job);
+}
+
+bool AsyncLoader::requestMetricsReport(AsyncCallback callback, void* context) {
+  if (loader.getMetrics() == nullptr) return false;
+  
+  // Behind any waiting downloads, whose stages it can then include
+  AsyncRequest job;
+  job.type = ASYNC_JOB_METRICS;
+  job.resourceId[0] = '\0';
+  job.priority = PRIORITY_LOW;
+  job.compress = false;
+  job.callback = callback;
+  job.context = context;
+  return enqueue(job);
+}
+
+bool AsyncLoader::requestManifestRefresh(AsyncCallback callback, void* context) {
+  if (manifest == nullptr) return false;
+  
+  AsyncRequest job;
+  job.type = ASYNC_JOB_MANIFEST;
+  job.resourceId[0] = '\0';
+  job.priority = PRIORITY_NORMAL;
+  job.compress = false;
+  job.callback = callback;
+  job.context = context;
+  return enqueue(job);
+}
+
+int AsyncLoader::prefetch(const String& hints) {
+  int queued = 0;
+  int start = 0;
+  
+  while (start < (int)hints.length()) {
+    int end = hints.indexOf(',', start);
+    if (end < 0) end = hints.length();
+    String resourceId = hints.substring(start, end);
+    resourceId.trim();
+    start = end + 1;
+    
+    if (resourceId.length() == 0 || resourceId.length() >= CACHE_ID_LENGTH || cache.contains(resourceId)) {
+      continue;
+    }
+    if (!hasHeadroom()) {
+      break;
+    }
+    if (!admits(resourceId.c_str(), PRIORITY_LOW, true)) {
+      countDeclined();
+      continue;   // A smaller hint may still fit
+    }
+    
+    AsyncRequest job;
+    job.type = ASYNC_JOB_PREFETCH;
+    strcpy(job.resourceId, resourceId.c_str());
+    job.priority = PRIORITY_LOW;
+    job.compress = true;
+    job.callback = nullptr;
+    job.context = nullptr;
+    if (!enqueue(job)) {
+      break;
+    }
+    queued++;
+  }
+  return queued;
+}
+
+bool AsyncLoader::hasHeadroom() {
+  MemoryInfo memInfo = memoryManager.getMemoryInfo();
+  return memInfo.usagePercent < ASYNC_PREFETCH_MAX_USAGE &&
+         cache.getCacheUtilization() * 100 < ASYNC_PREFETCH_MAX_CACHE;
+}
+
+bool AsyncLoader::admits(const char* resourceId, int priority, bool speculative) {
+  ManifestRecord record;
+  if (manifest == nullptr || !manifest->lookup(resourceId, record)) {
+    return true;   // Unknown size; the download decides
+  }
+  
+  // A prefetch may not take the cache past its prefetch share
+  size_t cost = cache.getEntryCost(record.size);
+  if (speculative && (cache.getCacheSize() + cost) * 100 > cache.getMaxCacheSize() * ASYNC_PREFETCH_MAX_CACHE) {
+    VRAM_LOGD("async", "Prefetch of %s declined: %u bytes", resourceId, record.size);
+    return false;
+  }
+  if (!cache.wouldAdmit(resourceId, record.size, priority)) {
+    VRAM_LOGD("async", "%s declined: %u bytes would not be admitted", resourceId, record.size);
+    return false;
+  }
+  return true;
+}
+
+void AsyncLoader::countDeclined() {
+  portENTER_CRITICAL(&statsLock);
+  stats.declined++;
+  portEXIT_CRITICAL(&statsLock);
+}
+
+bool AsyncLoader::enqueue(const AsyncRequest& job) {
+  if (worker == nullptr) {
+    VRAM_LOGW("async", "Loader not started");
+    return false;
+  }
+  
+  // Never wait here: a full queue means the caller should retry later
+  BaseType_t queued;
+  if (job.type == ASYNC_JOB_PREFETCH) {
+    queued = xQueueSend(prefetches, &job, 0);
+  } else if (job.priority == PRIORITY_CRITICAL) {
+    queued = xQueueSendToFront(requests, &job, 0);
+  } else {
+    queued = xQueueSend(requests, &job, 0);
+  }
+  
+  portENTER_CRITICAL(&statsLock);
+  if (queued == pdTRUE) {
+    stats.queued++;
+  } else {
+    stats.dropped++;
+  }
+  portEXIT_CRITICAL(&statsLock);
+  
+  if (queued != pdTRUE) {
+    // Hints are only suggestions, so losing one is not worth a warning
+    if (job.type == ASYNC_JOB_PREFETCH) {
+      VRAM_LOGD("async", "Prefetch queue full, %s skipped", job.resourceId);
+    } else {
+      VRAM_LOGW("async", "Request queue full, %s dropped", job.resourceId);
+    }
+    return false;
+  }
+  return true;
+}
+
+int AsyncLoader::poll() {
+  if (results == nullptr) return 0;
+  
+  int delivered = 0;
+  AsyncResult result;
+  while (xQueueReceive(results, &result, 0) == pdTRUE) {
+    portENTER_CRITICAL(&statsLock);
+    if (result.success) {
+      stats.completed++;
+    } else {
+      stats.failed++;
+    }
+    if (result.type == ASYNC_JOB_PREFETCH && result.size > 0) {
+      stats.prefetched++;
+    }
+    if (result.patched) {
+      stats.patched++;
+    }
+    portEXIT_CRITICAL(&statsLock);
+    
+    if (result.callback != nullptr) {
+      result.callback(result, result.context);
+    }
+    delivered++;
+  }
+  return delivered;
+}
+
+size_t AsyncLoader::getPending() {
+  if (requests == nullptr) return 0;
+  return uxQueueMessagesWaiting(requests) + uxQueueMessagesWaiting(prefetches) + (busy ? 1 : 0);
+}
+
+AsyncStats AsyncLoader::getStats() {
+  portENTER_CRITICAL(&statsLock);
+  AsyncStats snapshot = stats;
+  portEXIT_CRITICAL(&statsLock);
+  return snapshot;
+}
+
+void AsyncLoader::taskEntry(void* param) {
+  static_cast<AsyncLoader*>(param)->run();
+}
+
+void AsyncLoader::run() {
+  AsyncRequest job;
+  AsyncResult result;
+  
+  for (;;) {
+    // Demand requests always go first; prefetches only fill idle time
+    bool received = xQueueReceive(requests, &job, 0) == pdTRUE ||
+                    xQueueReceive(prefetches, &job, 0) == pdTRUE ||
+                    xQueueReceive(requests, &job, pdMS_TO_TICKS(ASYNC_PREFETCH_POLL)) == pdTRUE;
+    if (!received) continue;
+    
+    busy = true;
+    process(job, result);
+    busy = false;
+    
+    // Waits for poll() rather than losing a completion
+    xQueueSend(results, &result, portMAX_DELAY);
+  }
+}
+
+void AsyncLoader::process(const AsyncRequest& job, AsyncResult& result) {
+  result.type = job.type;
+  strcpy(result.resourceId, job.resourceId);
+  result.size = 0;
+  result.patched = false;
+  result.callback = job.callback;
+  result.context = job.context;
+  
+  unsigned long startTime = millis();
+  
+  if (job.type == ASYNC_JOB_HEALTH) {
+    result.httpCode = session.head("/api/health");
+    session.end();
+    result.success = (result.httpCode == HTTP_CODE_OK);
+  } else if (job.type == ASYNC_JOB_METRICS) {
+    // Fails at once while offline; the histograms then go out with the next report
+    result.success = loader.getMetrics()->report(session, cache);
+    result.httpCode = loader.getMetrics()->getStats().lastHttpCode;
+  } else if (job.type == ASYNC_JOB_MANIFEST) {
+    result.success = manifest->fetch(session);
+    result.httpCode = manifest->getStats().lastHttpCode;
+  } else if (job.type == ASYNC_JOB_PREFETCH &&
+             (cache.contains(job.resourceId) || !hasHeadroom() || !session.isOnline() ||
+              !admits(job.resourceId, PRIORITY_LOW, true))) {
+    // Loaded on demand meanwhile, memory or the cache got tight while it waited, or the link is down
+    result.httpCode = 0;
+    result.success = true;
+  } else if (job.type == ASYNC_JOB_FETCH && cache.getPriority(job.resourceId) == 0 &&
+             !admits(job.resourceId, job.priority, false)) {
+    // The download would only be thrown away at reserve()
+    countDeclined();
+    result.httpCode = 0;
+    result.success = false;
+  } else {
+    // Held here while WiFi reconnects; later requests stay queued behind it
+    if (!session.isOnline()) {
+      VRAM_LOGD("async", "Offline, %s waits for the network", job.resourceId);
+      session.waitOnline(pdMS_TO_TICKS(ASYNC_OFFLINE_WAIT));
+    }
+    
+    // A cached copy is revalidated through the delta endpoint, which patches it
+    // in place if it changed; the whole resource is only fetched without one
+    String path = "/api/resources/" + String(job.resourceId);
+    result.success = (job.type == ASYNC_JOB_FETCH && cache.getVersion(job.resourceId) > 0 &&
+                      loader.fetchDelta(path + "/delta", job.resourceId, job.priority));
+    
+    if (!result.success) {
+      path += "/raw";
+      if (job.type == ASYNC_JOB_PREFETCH) {
+        path += "?compress=true&prefetch=true";   // Not learned from, no further hints
+      } else if (job.compress) {
+        path += "?compress=true";
+      }
+      
+      // Streams into a cache reservation; the cache publishes it under its own lock
+      result.success = loader.fetchRaw(path, job.resourceId, job.priority);
+    }
+    result.httpCode = loader.getLastHttpCode();
+    result.patched = loader.wasPatched();
+    if (result.success && result.httpCode == HTTP_CODE_OK) {
+      result.size = loader.getLastSize();
+      if (job.type == ASYNC_JOB_PREFETCH) {
+        cache.setSpeculative(job.resourceId);
+      }
+    }
+    
+    if (result.success && job.type == ASYNC_JOB_FETCH) {
+      prefetch(loader.getLastHints());
+    }
+  }
+  
+  result.elapsed = millis() - startTime;
+  VRAM_LOGD("async", "Job %s done: %d in %lums", job.resourceId, result.httpCode, result.elapsed);
+}
+
+void AsyncLoader::printStats() {
+  AsyncStats snapshot = getStats();
+  Serial.println("\n=== Async Loader Statistics ===");
+  Serial.printf("Worker: %s\n", isRunning() ? "running" : "stopped");
+  Serial.printf("Queued: %lu\n", snapshot.queued);
+  Serial.printf("Completed: %lu\n", snapshot.completed);
+  Serial.printf("Failed: %lu\n", snapshot.failed);
+  Serial.printf("Dropped: %lu\n", snapshot.dropped);
+  Serial.printf("Prefetched: %lu\n", snapshot.prefetched);
+  Serial.printf("Patched: %lu\n", snapshot.patched);
+  Serial.printf("Declined: %lu\n", snapshot.declined);
+  Serial.printf("Pending: %d\n", getPending());
+  Serial.println("===============================\n");
+}
+
+#endif // ASYNC_LOADER_H
\ No newline at end of file
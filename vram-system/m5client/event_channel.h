@@ -0,0 +1,384 @@
+/*
+ * Event Channel for VRAM System
+ * One long-lived Server-Sent Events stream carrying liveness heartbeats
+ * and resource invalidations, in place of periodic health polling
+ */
+
+#ifndef EVENT_CHANNEL_H
+#define EVENT_CHANNEL_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include "http_session.h"
+#include "resource_cache.h"
+#include "vram_log.h"
+
+// Channel configuration
+#define EVENTS_PATH             "/api/events"
+#define EVENTS_LIVENESS_TIMEOUT 45000         // Silence that counts as a lost server; it beats every 15s (ms)
+#define EVENTS_CONNECT_TIMEOUT  5000
+#define EVENTS_RETRY_MIN        1000          // Reconnect backoff, doubling with jitter...
+#define EVENTS_RETRY_MAX        30000         // ...up to 30s between attempts
+#define EVENTS_READ_POLL        50            // Idle wait between stream reads (ms)
+#define EVENTS_LINE_LENGTH      128           // Longer event lines are cut
+#define EVENTS_NAME_LENGTH      16
+#define EVENTS_ID_LENGTH        32
+#define EVENTS_QUEUE_LENGTH     16            // Events waiting for poll()
+#define EVENTS_TASK_STACK       4096
+#define EVENTS_TASK_PRIORITY    1
+#define EVENTS_TASK_CORE        0             // Arduino loop() runs on core 1
+
+// Event types
+enum ChannelEventType {
+  CHANNEL_CONNECTED,                          // Stream open, the server is reachable
+  CHANNEL_LOST,                               // Stream closed or silent for too long
+  CHANNEL_INVALIDATE,                         // A resource changed, or was deleted (version 0)
+  CHANNEL_RESET                               // Events may have been missed; revalidate what is cached
+};
+
+// Delivered to the callback from poll()
+struct ChannelEvent {
+  ChannelEventType type;
+  char resourceId[CACHE_ID_LENGTH];
+  int version;
+  char etag[CACHE_ETAG_LENGTH];               // New content hash prefix, empty on deletion
+};
+
+typedef void (*ChannelCallback)(const ChannelEvent& event, void* context);
+
+// Channel statistics
+struct ChannelStats {
+  unsigned long connects;
+  unsigned long failures;                     // Attempts that did not open a stream
+  unsigned long heartbeats;
+  unsigned long invalidations;
+  unsigned long resets;
+  unsigned long dropped;                      // Lost to a full queue, each covered by a reset
+};
+
+// The stream has its own connection, apart from the shared HttpSession,
+// and is read on its own task: a response that never ends would hold the
+// session lock for good. Invalidations only say what changed; refreshing
+// is up to the callback, which usually queues an AsyncLoader request.
+// Reconnects send Last-Event-ID, so the server replays what was missed
+// or answers with a reset when it cannot.
+class EventChannel {
+private:
+  HttpSession& session;       // Base URL and link state
+  WiFiClient client;
+  HTTPClient http;
+  QueueHandle_t events;
+  TaskHandle_t worker;
+  ChannelCallback callback;
+  void* context;
+  std::atomic<bool> connected;
+  std::atomic<unsigned long> lastActivity;
+  ChannelStats stats;
+  portMUX_TYPE statsLock;     // Counted on the worker, read from loop()
+  
+  // Stream state, worker only
+  char line[EVENTS_LINE_LENGTH];
+  size_t lineLength;
+  char eventName[EVENTS_NAME_LENGTH];
+  char eventData[EVENTS_LINE_LENGTH];
+  char eventId[EVENTS_ID_LENGTH];
+  char lastEventId[EVENTS_ID_LENGTH];
+  bool overflowed;            // An event was dropped; a reset is owed
+  
+  static void taskEntry(void* param);
+  void run();
+  bool open();
+  void read();
+  void consume(char c);
+  void processLine();
+  void dispatch();
+  void post(ChannelEventType type, const char* resourceId = "", int version = 0, const char* hash = "");
+  void count(unsigned long& counter);
+
+public:
+  EventChannel(HttpSession& httpSession);
+  
+  // Creates the queue and starts the reader on EVENTS_TASK_CORE
+  bool begin(ChannelCallback eventCallback, void* callbackContext = nullptr);
+  bool isRunning() { return worker != nullptr; }
+  
+  // Stream open and heard from within EVENTS_LIVENESS_TIMEOUT
+  bool isAlive();
+  
+  // Deliver received events to the callback; call from loop(). Returns the count.
+  int poll();
+  
+  // Statistics
+  ChannelStats getStats();
+  void printStats();
+};
+
+// Implementation
+EventChannel::EventChannel(HttpSession& httpSession) : session(httpSession) {
+  events = nullptr;
+  worker = nullptr;
+  callback = nullptr;
+  context = nullptr;
+  connected = false;
+  lastActivity = 0;
+  memset(&stats, 0, sizeof(stats));
+  statsLock = portMUX_INITIALIZER_UNLOCKED;
+  lineLength = 0;
+  eventName[0] = '\0';
+  eventData[0] = '\0';
+  eventId[0] = '\0';
+  lastEventId[0] = '\0';
+  overflowed = false;
+}
+
+bool EventChannel::begin(ChannelCallback eventCallback, void* callbackContext) {
+  if (worker != nullptr) return true;
+  
+  callback = eventCallback;
+  context = callbackContext;
+  events = xQueueCreate(EVENTS_QUEUE_LENGTH, sizeof(ChannelEvent));
+  if (events == nullptr) {
+    VRAM_LOGE("events", "Cannot create event queue");
+    return false;
+  }
+  
+  if (xTaskCreatePinnedToCore(taskEntry, "vram_events", EVENTS_TASK_STACK, this,
+                              EVENTS_TASK_PRIORITY, &worker, EVENTS_TASK_CORE) != pdPASS) {
+    VRAM_LOGE("events", "Cannot start event task");
+    worker = nullptr;
+    return false;
+  }
+  
+  VRAM_LOGI("events", "Event task started on core %d", EVENTS_TASK_CORE);
+  return true;
+}
+
+bool EventChannel::isAlive() {
+  return connected && millis() - lastActivity < EVENTS_LIVENESS_TIMEOUT;
+}
+
+void EventChannel::taskEntry(void* param) {
+  static_cast<EventChannel*>(param)->run();
+}
+
+void EventChannel::run() {
+  unsigned long backoff = EVENTS_RETRY_MIN;
+  
+  for (;;) {
+    // No point dialing out while WiFi is down
+    if (!session.isOnline()) {
+      session.waitOnline(portMAX_DELAY);
+    }
+    
+    if (open()) {
+      backoff = EVENTS_RETRY_MIN;
+      read();
+      http.end();
+      connected = false;
+      post(CHANNEL_LOST);
+      VRAM_LOGW("events", "Event stream lost");
+    } else {
+      count(stats.failures);
+    }
+    
+    // Equal jitter, so devices do not all reconnect in step after a server restart
+    vTaskDelay(pdMS_TO_TICKS(backoff / 2 + random(backoff / 2 + 1)));
+    backoff = backoff * 2 < EVENTS_RETRY_MAX ? backoff * 2 : EVENTS_RETRY_MAX;
+  }
+}
+
+bool EventChannel::open() {
+  // HTTP/1.0 gets a plain body up to the close, with no chunked framing to strip
+  http.setReuse(false);
+  http.useHTTP10(true);
+  http.setConnectTimeout(EVENTS_CONNECT_TIMEOUT);
+  http.setTimeout(EVENTS_CONNECT_TIMEOUT);
+  if (!http.begin(client, session.getBaseURL() + EVENTS_PATH)) {
+    return false;
+  }
+  http.addHeader("Accept", "text/event-stream");
+  if (lastEventId[0] != '\0') {
+    http.addHeader("Last-Event-ID", lastEventId);
+  }
+  
+  int code = http.GET();
+  if (code != HTTP_CODE_OK) {
+    VRAM_LOGD("events", "Event stream not opened: %d", code);
+    http.end();
+    return false;
+  }
+  
+  lineLength = 0;
+  eventName[0] = '\0';
+  eventData[0] = '\0';
+  eventId[0] = '\0';
+  lastActivity = millis();
+  connected = true;
+  count(stats.connects);
+  post(CHANNEL_CONNECTED);
+  VRAM_LOGI("events", "Event stream open");
+  return true;
+}
+
+void EventChannel::read() {
+  WiFiClient* stream = http.getStreamPtr();
+  uint8_t chunk[64];
+  
+  for (;;) {
+    size_t available = stream->available();
+    if (available == 0) {
+      if (!http.connected()) return;
+      if (millis() - lastActivity > EVENTS_LIVENESS_TIMEOUT) {
+        VRAM_LOGW("events", "No heartbeat for %d ms", EVENTS_LIVENESS_TIMEOUT);
+        return;
+      }
+      vTaskDelay(pdMS_TO_TICKS(EVENTS_READ_POLL));
+      continue;
+    }
+    
+    size_t received = stream->readBytes(chunk, available < sizeof(chunk) ? available : sizeof(chunk));
+    lastActivity = millis();
+    for (size_t i = 0; i < received; i++) {
+      consume((char)chunk[i]);
+    }
+  }
+}
+
+void EventChannel::consume(char c) {
+  if (c == '\r') return;
+  if (c == '\n') {
+    line[lineLength] = '\0';
+    processLine();
+    lineLength = 0;
+    return;
+  }
+  if (lineLength < sizeof(line) - 1) {
+    line[lineLength++] = c;
+  }
+}
+
+void EventChannel::processLine() {
+  // A blank line ends the event; lines starting with ':' are comments
+  if (line[0] == '\0') {
+    dispatch();
+    return;
+  }
+  if (line[0] == ':') return;
+  
+  char* value = strchr(line, ':');
+  if (value == nullptr) {
+    value = line + lineLength;   // Field with an empty value
+  } else {
+    *value++ = '\0';
+    if (*value == ' ') value++;
+  }
+  
+  if (strcmp(line, "event") == 0) {
+    strncpy(eventName, value, sizeof(eventName) - 1);
+    eventName[sizeof(eventName) - 1] = '\0';
+  } else if (strcmp(line, "data") == 0) {
+    strncpy(eventData, value, sizeof(eventData) - 1);
+    eventData[sizeof(eventData) - 1] = '\0';
+  } else if (strcmp(line, "id") == 0) {
+    strncpy(eventId, value, sizeof(eventId) - 1);
+    eventId[sizeof(eventId) - 1] = '\0';
+  }
+}
+
+void EventChannel::dispatch() {
+  if (eventId[0] != '\0') {
+    strcpy(lastEventId, eventId);
+  }
+  
+  if (strcmp(eventName, "heartbeat") == 0) {
+    count(stats.heartbeats);
+  } else if (strcmp(eventName, "invalidate") == 0) {
+    // "<resource_id> <version> <hash>", version 0 and hash "-" once deleted
+    char resourceId[CACHE_ID_LENGTH];
+    char hash[72];
+    int version;
+    if (sscanf(eventData, "%31s %d %71s", resourceId, &version, hash) == 3) {
+      count(stats.invalidations);
+      post(CHANNEL_INVALIDATE, resourceId, version, strcmp(hash, "-") != 0 ? hash : "");
+    } else {
+      VRAM_LOGW("events", "Malformed invalidation: %s", eventData);
+    }
+  } else if (strcmp(eventName, "reset") == 0) {
+    count(stats.resets);
+    post(CHANNEL_RESET);
+  }
+  
+  eventName[0] = '\0';
+  eventData[0] = '\0';
+  eventId[0] = '\0';
+}
+
+void EventChannel::post(ChannelEventType type, const char* resourceId, int version, const char* hash) {
+  ChannelEvent event;
+  memset(&event, 0, sizeof(event));
+  
+  // A dropped invalidation would leave a stale entry behind, so the next event owes a reset
+  if (overflowed) {
+    event.type = CHANNEL_RESET;
+    if (xQueueSend(events, &event, 0) != pdTRUE) {
+      count(stats.dropped);
+      return;
+    }
+    overflowed = false;
+    if (type == CHANNEL_RESET) return;
+  }
+  
+  event.type = type;
+  strncpy(event.resourceId, resourceId, CACHE_ID_LENGTH - 1);
+  event.version = version;
+  strncpy(event.etag, hash, CACHE_ETAG_LENGTH - 1);
+  if (xQueueSend(events, &event, 0) != pdTRUE) {
+    overflowed = true;
+    count(stats.dropped);
+  }
+}
+
+void EventChannel::count(unsigned long& counter) {
+  portENTER_CRITICAL(&statsLock);
+  counter++;
+  portEXIT_CRITICAL(&statsLock);
+}
+
+int EventChannel::poll() {
+  if (events == nullptr) return 0;
+  
+  int delivered = 0;
+  ChannelEvent event;
+  while (xQueueReceive(events, &event, 0) == pdTRUE) {
+    if (callback != nullptr) {
+      callback(event, context);
+    }
+    delivered++;
+  }
+  return delivered;
+}
+
+ChannelStats EventChannel::getStats() {
+  portENTER_CRITICAL(&statsLock);
+  ChannelStats snapshot = stats;
+  portEXIT_CRITICAL(&statsLock);
+  return snapshot;
+}
+
+void EventChannel::printStats() {
+  ChannelStats snapshot = getStats();
+  Serial.println("\n=== Event Channel Statistics ===");
+  Serial.printf("Stream: %s\n", isAlive() ? "alive" : (isRunning() ? "reconnecting" : "stopped"));
+  Serial.printf("Connects: %lu, Failures: %lu\n", snapshot.connects, snapshot.failures);
+  Serial.printf("Heartbeats: %lu\n", snapshot.heartbeats);
+  Serial.printf("Invalidations: %lu\n", snapshot.invalidations);
+  Serial.printf("Resets: %lu, Dropped: %lu\n", snapshot.resets, snapshot.dropped);
+  Serial.println("================================\n");
+}
+
+#endif // EVENT_CHANNEL_H
\ No newline at end of file
@@ -0,0 +1,120 @@
+/*
+ * Eviction Policy for VRAM System
+ * Frequency estimates that decide which cached resources are worth keeping
+ */
+
+#ifndef EVICTION_POLICY_H
+#define EVICTION_POLICY_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// Count-min sketch configuration (width must stay a power of two)
+#define SKETCH_DEPTH          4             // Independent counter rows
+#define SKETCH_WIDTH          256           // 4-bit counters per row
+#define SKETCH_MAX_COUNT      15
+#define SKETCH_SAMPLE_SIZE    (SKETCH_WIDTH * 10)  // Accesses between agings
+
+// The cache keeps priority tiers itself; within a tier it asks the policy
+// how often a key has been requested. Frequencies are compared, never
+// interpreted, so 0 for everything degrades to plain LRU.
+class EvictionPolicy {
+public:
+  virtual ~EvictionPolicy() {}
+  
+  // Called for every request of a key, hits and misses alike; may run on any task
+  virtual void recordAccess(uint32_t keyHash) = 0;
+  virtual uint8_t frequency(uint32_t keyHash) = 0;
+  virtual void reset() = 0;
+  virtual const char* name() = 0;
+};
+
+// Recency only: every entry looks equally popular
+class LruPolicy : public EvictionPolicy {
+public:
+  void recordAccess(uint32_t keyHash) override {}
+  uint8_t frequency(uint32_t keyHash) override { return 0; }
+  void reset() override {}
+  const char* name() override { return "LRU"; }
+};
+
+// TinyLFU: an approximate request count per key that survives eviction,
+// so a one-off scan cannot displace resources that are used repeatedly.
+// Counters are halved every SKETCH_SAMPLE_SIZE accesses to follow changes.
+class TinyLfuPolicy : public EvictionPolicy {
+private:
+  // Eight 4-bit counters per word, updated lock-free
+  std::atomic<uint32_t> counters[SKETCH_DEPTH * SKETCH_WIDTH / 8];
+  std::atomic<uint32_t> samples;
+  
+  static uint32_t counterIndex(uint32_t keyHash, int row);
+  void age();
+
+public:
+  TinyLfuPolicy();
+  
+  void recordAccess(uint32_t keyHash) override;
+  uint8_t frequency(uint32_t keyHash) override;
+  void reset() override;
+  const char* name() override { return "TinyLFU"; }
+};
+
+// Implementation
+TinyLfuPolicy::TinyLfuPolicy() {
+  reset();
+}
+
+uint32_t TinyLfuPolicy::counterIndex(uint32_t keyHash, int row) {
+  // One multiply-xorshift per row gives independent-enough positions
+  static const uint32_t seeds[SKETCH_DEPTH] = {0x9E3779B1u, 0x85EBCA77u, 0xC2B2AE3Du, 0x27D4EB2Fu};
+  uint32_t h = keyHash * seeds[row];
+  h ^= h >> 15;
+  return row * SKETCH_WIDTH + (h & (SKETCH_WIDTH - 1));
+}
+
+void TinyLfuPolicy::recordAccess(uint32_t keyHash) {
+  for (int row = 0; row < SKETCH_DEPTH; row++) {
+    uint32_t index = counterIndex(keyHash, row);
+    std::atomic<uint32_t>& word = counters[index / 8];
+    uint32_t shift = (index % 8) * 4;
+    
+    uint32_t current = word.load(std::memory_order_relaxed);
+    while (((current >> shift) & 0xF) < SKETCH_MAX_COUNT &&
+           !word.compare_exchange_weak(current, current + (1u << shift), std::memory_order_relaxed)) {
+    }
+  }
+  
+  if (samples.fetch_add(1, std::memory_order_relaxed) + 1 >= SKETCH_SAMPLE_SIZE) {
+    age();
+  }
+}
+
+uint8_t TinyLfuPolicy::frequency(uint32_t keyHash) {
+  uint8_t estimate = SKETCH_MAX_COUNT;
+  for (int row = 0; row < SKETCH_DEPTH; row++) {
+    uint32_t index = counterIndex(keyHash, row);
+    uint8_t count = (counters[index / 8].load(std::memory_order_relaxed) >> ((index % 8) * 4)) & 0xF;
+    if (count < estimate) estimate = count;
+  }
+  return estimate;
+}
+
+void TinyLfuPolicy::age() {
+  samples.store(0, std::memory_order_relaxed);
+  
+  // Halve every counter: shift the word, then drop the bit each counter took from its neighbour
+  for (size_t i = 0; i < SKETCH_DEPTH * SKETCH_WIDTH / 8; i++) {
+    uint32_t current = counters[i].load(std::memory_order_relaxed);
+    while (!counters[i].compare_exchange_weak(current, (current >> 1) & 0x77777777u, std::memory_order_relaxed)) {
+    }
+  }
+}
+
+void TinyLfuPolicy::reset() {
+  for (size_t i = 0; i < SKETCH_DEPTH * SKETCH_WIDTH / 8; i++) {
+    counters[i].store(0, std::memory_order_relaxed);
+  }
+  samples.store(0, std::memory_order_relaxed);
+}
+
+#endif // EVICTION_POLICY_H
\ No newline at end of file
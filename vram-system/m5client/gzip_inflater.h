@@ -0,0 +1,241 @@
+/*
+ * Gzip Inflater for VRAM System
+ * Incremental gzip / raw deflate decoding on top of the ROM miniz inflater
+ */
+
+#ifndef GZIP_INFLATER_H
+#define GZIP_INFLATER_H
+
+#include <Arduino.h>
+#include "rom/miniz.h"
+#include "rom/crc.h"
+#include "memory_manager.h"
+#include "vram_log.h"
+
+// Input formats
+#define INFLATE_FORMAT_GZIP     0       // RFC 1952 member: header, deflate, CRC32 + size
+#define INFLATE_FORMAT_DEFLATE  1       // Bare RFC 1951 stream
+
+// Gzip header flags
+#define GZIP_FLAG_HCRC          0x02
+#define GZIP_FLAG_EXTRA         0x04
+#define GZIP_FLAG_NAME          0x08
+#define GZIP_FLAG_COMMENT       0x10
+
+// Inflater states
+enum InflateState {
+  INFLATE_HEADER,
+  INFLATE_EXTRA_LENGTH,
+  INFLATE_EXTRA,
+  INFLATE_NAME,
+  INFLATE_COMMENT,
+  INFLATE_HEADER_CRC,
+  INFLATE_BODY,
+  INFLATE_TRAILER,
+  INFLATE_DONE,
+  INFLATE_ERROR
+};
+
+// Streams one compressed member into a caller-owned output buffer. The
+// output buffer doubles as the inflate dictionary, so no separate 32KB
+// window is needed: memory is the decompressor state plus the output.
+class GzipInflater {
+private:
+  tinfl_decompressor* decompressor;
+  uint8_t* output;
+  size_t capacity;
+  size_t outputLength;
+  int format;
+  InflateState state;
+  
+  // Header and trailer parsing
+  uint8_t headerFlags;
+  uint8_t fieldBytes[10];
+  uint8_t fieldLength;
+  uint16_t extraRemaining;
+  
+  size_t feedHeader(const uint8_t* data, size_t length);
+  size_t feedBody(const uint8_t* data, size_t length);
+  size_t feedTrailer(const uint8_t* data, size_t length);
+
+public:
+  GzipInflater();
+  ~GzipInflater();
+  
+  // Decompressor state is borrowed from the VRAM pool between begin() and end()
+  bool begin(uint8_t* outputBuffer, size_t outputCapacity, int inputFormat = INFLATE_FORMAT_GZIP);
+  bool feed(const uint8_t* data, size_t length);
+  void end();
+  
+  bool isDone() { return state == INFLATE_DONE; }
+  bool hasFailed() { return state == INFLATE_ERROR; }
+  size_t getOutputLength() { return outputLength; }
+};
+
+// Implementation
+GzipInflater::GzipInflater() {
+  decompressor = nullptr;
+  output = nullptr;
+  capacity = 0;
+  outputLength = 0;
+  format = INFLATE_FORMAT_GZIP;
+  state = INFLATE_ERROR;
+  headerFlags = 0;
+  fieldLength = 0;
+  extraRemaining = 0;
+}
+
+GzipInflater::~GzipInflater() {
+  end();
+}
+
+bool GzipInflater::begin(uint8_t* outputBuffer, size_t outputCapacity, int inputFormat) {
+  end();
+  
+  decompressor = (tinfl_decompressor*)VRAM_MALLOC(sizeof(tinfl_decompressor), "inflate");
+  if (decompressor == nullptr) {
+    VRAM_LOGW("inflate", "Cannot allocate decompressor (%d bytes)", sizeof(tinfl_decompressor));
+    state = INFLATE_ERROR;
+    return false;
+  }
+  tinfl_init(decompressor);
+  
+  output = outputBuffer;
+  capacity = outputCapacity;
+  outputLength = 0;
+  format = inputFormat;
+  headerFlags = 0;
+  fieldLength = 0;
+  extraRemaining = 0;
+  state = (format == INFLATE_FORMAT_DEFLATE) ? INFLATE_BODY : INFLATE_HEADER;
+  return true;
+}
+
+void GzipInflater::end() {
+  if (decompressor != nullptr) {
+    VRAM_FREE(decompressor);
+    decompressor = nullptr;
+  }
+}
+
+bool GzipInflater::feed(const uint8_t* data, size_t length) {
+  while (length > 0 && state != INFLATE_DONE && state != INFLATE_ERROR) {
+    size_t used;
+    if (state == INFLATE_BODY) {
+      used = feedBody(data, length);
+    } else if (state == INFLATE_TRAILER) {
+      used = feedTrailer(data, length);
+    } else {
+      used = feedHeader(data, length);
+    }
+    data += used;
+    length -= used;
+  }
+  return state != INFLATE_ERROR;
+}
+
+size_t GzipInflater::feedHeader(const uint8_t* data, size_t length) {
+  uint8_t value = data[0];
+  
+  switch (state) {
+    case INFLATE_HEADER:
+      // Fixed part: magic, method, flags, mtime, xfl, os
+      fieldBytes[fieldLength++] = value;
+      if (fieldLength < 10) break;
+      if (fieldBytes[0] != 0x1f || fieldBytes[1] != 0x8b || fieldBytes[2] != 8) {
+        VRAM_LOGW("inflate", "Not a gzip deflate stream");
+        state = INFLATE_ERROR;
+        break;
+      }
+      headerFlags = fieldBytes[3];
+      fieldLength = 0;
+      state = INFLATE_EXTRA_LENGTH;
+      if (!(headerFlags & GZIP_FLAG_EXTRA)) state = INFLATE_NAME;
+      break;
+    
+    case INFLATE_EXTRA_LENGTH:
+      fieldBytes[fieldLength++] = value;
+      if (fieldLength < 2) break;
+      extraRemaining = fieldBytes[0] | (fieldBytes[1] << 8);
+      fieldLength = 0;
+      state = extraRemaining > 0 ? INFLATE_EXTRA : INFLATE_NAME;
+      break;
+    
+    case INFLATE_EXTRA: {
+      size_t skip = length < extraRemaining ? length : extraRemaining;
+      extraRemaining -= skip;
+      if (extraRemaining == 0) state = INFLATE_NAME;
+      return skip;
+    }
+    
+    case INFLATE_NAME:
+    case INFLATE_COMMENT: {
+      uint8_t flag = (state == INFLATE_NAME) ? GZIP_FLAG_NAME : GZIP_FLAG_COMMENT;
+      if ((headerFlags & flag) && value != 0) break;  // Skip the zero-terminated field
+      if (headerFlags & flag) {
+        state = (state == INFLATE_NAME) ? INFLATE_COMMENT : INFLATE_HEADER_CRC;
+        break;
+      }
+      // Field absent: move on without consuming this byte
+      state = (state == INFLATE_NAME) ? INFLATE_COMMENT : INFLATE_HEADER_CRC;
+      return 0;
+    }
+    
+    case INFLATE_HEADER_CRC:
+      if (!(headerFlags & GZIP_FLAG_HCRC)) {
+        state = INFLATE_BODY;
+        return 0;
+      }
+      if (++fieldLength < 2) break;
+      fieldLength = 0;
+      state = INFLATE_BODY;
+      break;
+    
+    default:
+      break;
+  }
+  return 1;
+}
+
+size_t GzipInflater::feedBody(const uint8_t* data, size_t length) {
+  size_t inBytes = length;
+  size_t outBytes = capacity - outputLength;
+  
+  tinfl_status status = tinfl_decompress(decompressor, data, &inBytes, output, output + outputLength, &outBytes,
+                                         TINFL_FLAG_HAS_MORE_INPUT | TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+  outputLength += outBytes;
+  
+  if (status == TINFL_STATUS_DONE) {
+    fieldLength = 0;
+    state = (format == INFLATE_FORMAT_GZIP) ? INFLATE_TRAILER : INFLATE_DONE;
+  } else if (status == TINFL_STATUS_HAS_MORE_OUTPUT) {
+    VRAM_LOGW("inflate", "Inflated data exceeds %d bytes", capacity);
+    state = INFLATE_ERROR;
+  } else if (status < 0) {
+    VRAM_LOGW("inflate", "Corrupt deflate stream (status %d)", status);
+    state = INFLATE_ERROR;
+  }
+  return inBytes;
+}
+
+size_t GzipInflater::feedTrailer(const uint8_t* data, size_t length) {
+  size_t take = 8 - fieldLength;
+  if (take > length) take = length;
+  memcpy(fieldBytes + fieldLength, data, take);
+  fieldLength += take;
+  
+  if (fieldLength == 8) {
+    uint32_t expectedCrc = fieldBytes[0] | (fieldBytes[1] << 8) | (fieldBytes[2] << 16) | ((uint32_t)fieldBytes[3] << 24);
+    uint32_t expectedSize = fieldBytes[4] | (fieldBytes[5] << 8) | (fieldBytes[6] << 16) | ((uint32_t)fieldBytes[7] << 24);
+    
+    if (expectedSize != (uint32_t)outputLength || crc32_le(0, output, outputLength) != expectedCrc) {
+      VRAM_LOGW("inflate", "Gzip trailer mismatch (%d bytes inflated)", outputLength);
+      state = INFLATE_ERROR;
+    } else {
+      state = INFLATE_DONE;
+    }
+  }
+  return take;
+}
+
+#endif // GZIP_INFLATER_H
\ No newline at end of file
@@ -0,0 +1,398 @@
+/*
+ * HTTP Session for VRAM System
+ * One persistent keep-alive connection to the VRAM server, shared by
+ * every request the client makes
+ */
+
+#ifndef HTTP_SESSION_H
+#define HTTP_SESSION_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/event_groups.h>
+#include "vram_log.h"
+
+// Session configuration
+#define HTTP_SESSION_TIMEOUT  5000        // Default response timeout (ms)
+#define HTTP_SESSION_RETRIES  1           // Fresh-connection retries after a stale socket
+#define HTTP_SESSION_HEADERS  2           // Extra request headers per request
+#define HTTP_SESSION_COLLECT  8           // Response headers collected per request
+#define HTTP_SESSION_CHUNK_LINE 32        // Longest chunk size line kept, extensions included
+#define HTTP_SESSION_ONLINE   (1 << 0)    // Link event bit: network is up
+
+// Session statistics
+struct SessionStats {
+  unsigned long requests;
+  unsigned long reusedConnections;
+  unsigned long reconnects;
+  unsigned long failures;
+};
+
+// Requests are issued one at a time: a response must be finished with
+// end() (body fully read) or close() (body abandoned) before the next one.
+// The session is locked from a request until its end(), so other tasks
+// wait their turn; end() must come from the task that made the request.
+// Requests are HTTP/1.1, as HTTPClient only keeps a connection open after
+// an HTTP/1.1 status line; bodies are read through the session, which
+// strips chunked framing.
+class HttpSession {
+private:
+  WiFiClient client;
+  HTTPClient http;
+  String baseURL;
+  String host;                    // Parsed from baseURL for connecting
+  uint16_t port;
+  bool pending;
+  uint32_t lastConnectTime;
+  uint32_t lastResponseTime;
+  SessionStats stats;
+  String extraHeaderNames[HTTP_SESSION_HEADERS];
+  String extraHeaderValues[HTTP_SESSION_HEADERS];
+  uint8_t extraHeaderCount;
+  bool chunked;                   // Current body uses chunked transfer encoding
+  bool lastChunk;                 // ...and its final chunk has been read
+  size_t chunkLeft;               // Bytes left in the current chunk
+  SemaphoreHandle_t mutex;        // Held while a response is pending
+  EventGroupHandle_t link;        // HTTP_SESSION_ONLINE while the network is up
+
+  int sendRequest(const char* method, const String& path, const String* body, const char* contentType,
+                  uint16_t timeout, const char* headerKeys[], size_t headerCount);
+  bool readChunkLine(char* line, size_t size);
+  bool nextChunk();
+
+public:
+  HttpSession();
+  
+  // Configuration; changing the server drops the open connection
+  void setBaseURL(const String& url);
+  const String& getBaseURL() { return baseURL; }
+  
+  // Requests; path is relative to the base URL. Returns the HTTP code.
+  // Requests must be idempotent, as a stale connection is retried once.
+  int get(const String& path, uint16_t timeout = HTTP_SESSION_TIMEOUT,
+          const char* headerKeys[] = nullptr, size_t headerCount = 0) {
+    return sendRequest("GET", path, nullptr, nullptr, timeout, headerKeys, headerCount);
+  }
+  int head(const String& path, uint16_t timeout = HTTP_SESSION_TIMEOUT) {
+    return sendRequest("HEAD", path, nullptr, nullptr, timeout, nullptr, 0);
+  }
+  int post(const String& path, const String& body, const char* contentType, uint16_t timeout = HTTP_SESSION_TIMEOUT,
+           const char* headerKeys[] = nullptr, size_t headerCount = 0) {
+    return sendRequest("POST", path, &body, contentType, timeout, headerKeys, headerCount);
+  }
+  
+  // Adds a header to the next request only
+  bool addHeader(const String& name, const String& value);
+  
+  // Response access between a request and end()/close()
+  HTTPClient& response() { return http; }
+  
+  // Body of the current response, chunked framing removed. available()
+  // never blocks for body bytes; bodyPending() is false once a chunked body
+  // has ended or the connection has gone.
+  int available();
+  int read();
+  size_t read(uint8_t* buffer, size_t size);
+  bool bodyPending();
+  bool isChunked() { return chunked; }
+  bool bodyComplete() { return chunked && lastChunk; }   // Only known for chunked bodies
+  
+  // Skips the rest of a chunked body, up to limit bytes; true if it ended
+  bool drain(size_t limit);
+  
+  // Finish the current response
+  void end();     // Keeps the connection if the server allows it
+  void close();   // Drops the connection
+  bool isConnected() { return client.connected(); }
+  
+  // Timing of the last request (us): DNS and TCP connect, 0 when the
+  // connection was reused, then sending it until the response headers
+  uint32_t getLastConnectTime() { return lastConnectTime; }
+  uint32_t getLastResponseTime() { return lastResponseTime; }
+  
+  // Network state, reported by WiFiManager; a standalone session is always online.
+  // Requests made while offline fail at once instead of waiting for a socket timeout.
+  void setOnline(bool online);
+  bool isOnline() { return (xEventGroupGetBits(link) & HTTP_SESSION_ONLINE) != 0; }
+  bool waitOnline(TickType_t ticks);
+  
+  // Statistics
+  SessionStats getStats() { return stats; }
+  void printStats();
+};
+
+// Implementation
+HttpSession::HttpSession() {
+  port = 80;
+  pending = false;
+  lastConnectTime = 0;
+  lastResponseTime = 0;
+  extraHeaderCount = 0;
+  chunked = false;
+  lastChunk = false;
+  chunkLeft = 0;
+  memset(&stats, 0, sizeof(stats));
+  mutex = xSemaphoreCreateRecursiveMutex();
+  link = xEventGroupCreate();
+  xEventGroupSetBits(link, HTTP_SESSION_ONLINE);
+}
+
+void HttpSession::setBaseURL(const String& url) {
+  xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+  if (url != baseURL) {
+    close();
+    baseURL = url;
+    
+    // "http://host[:port][/...]"
+    int start = url.indexOf("://");
+    start = (start < 0) ? 0 : start + 3;
+    int end = url.indexOf('/', start);
+    String authority = url.substring(start, end < 0 ? url.length() : end);
+    int colon = authority.lastIndexOf(':');
+    host = (colon < 0) ? authority : authority.substring(0, colon);
+    port = (colon < 0) ? 80 : authority.substring(colon + 1).toInt();
+  }
+  xSemaphoreGiveRecursive(mutex);
+}
+
+bool HttpSession::addHeader(const String& name, const String& value) {
+  if (extraHeaderCount >= HTTP_SESSION_HEADERS) {
+    VRAM_LOGW("http", "Too many request headers, %s dropped", name.c_str());
+    return false;
+  }
+  extraHeaderNames[extraHeaderCount] = name;
+  extraHeaderValues[extraHeaderCount] = value;
+  extraHeaderCount++;
+  return true;
+}
+
+void HttpSession::setOnline(bool online) {
+  if (online) {
+    xEventGroupSetBits(link, HTTP_SESSION_ONLINE);
+  } else {
+    xEventGroupClearBits(link, HTTP_SESSION_ONLINE);
+  }
+}
+
+bool HttpSession::waitOnline(TickType_t ticks) {
+  EventBits_t bits = xEventGroupWaitBits(link, HTTP_SESSION_ONLINE, pdFALSE, pdTRUE, ticks);
+  return (bits & HTTP_SESSION_ONLINE) != 0;
+}
+
+int HttpSession::sendRequest(const char* method, const String& path, const String* body, const char* contentType,
+                             uint16_t timeout, const char* headerKeys[], size_t headerCount) {
+  xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+  if (pending) {
+    end();
+  }
+  stats.requests++;
+  
+  int httpCode = 0;
+  uint8_t extraHeaders = extraHeaderCount;
+  extraHeaderCount = 0;
+  chunked = false;
+  lastChunk = false;
+  chunkLeft = 0;
+  
+  // Transfer-Encoding is always collected, to know how the body is framed
+  const char* collect[HTTP_SESSION_COLLECT] = {"Transfer-Encoding"};
+  size_t collectCount = 1;
+  for (size_t i = 0; i < headerCount && collectCount < HTTP_SESSION_COLLECT; i++) {
+    collect[collectCount++] = headerKeys[i];
+  }
+  
+  if (!isOnline()) {
+    stats.failures++;
+    xSemaphoreGiveRecursive(mutex);
+    return HTTPC_ERROR_NOT_CONNECTED;
+  }
+  
+  for (int attempt = 0; attempt <= HTTP_SESSION_RETRIES; attempt++) {
+    bool reused = client.connected();
+    lastConnectTime = 0;
+    
+    // Connecting here instead of inside HTTPClient, which then reuses the
+    // socket, times DNS and TCP setup apart from the wait for a response
+    if (!reused) {
+      uint32_t connectStart = micros();
+      if (!client.connect(host.c_str(), port)) {
+        httpCode = HTTPC_ERROR_CONNECTION_REFUSED;
+        break;
+      }
+      lastConnectTime = micros() - connectStart;
+    }
+    
+    http.begin(client, baseURL + path);
+    http.setReuse(true);
+    http.setTimeout(timeout);
+    http.collectHeaders(collect, collectCount);
+    for (uint8_t i = 0; i < extraHeaders; i++) {
+      http.addHeader(extraHeaderNames[i], extraHeaderValues[i]);
+    }
+    
+    uint32_t requestStart = micros();
+    if (body != nullptr) {
+      http.addHeader("Content-Type", contentType);
+      httpCode = http.sendRequest(method, (uint8_t*)body->c_str(), body->length());
+    } else {
+      httpCode = http.sendRequest(method);
+    }
+    lastResponseTime = micros() - requestStart;
+    if (httpCode > 0) {
+      if (reused) stats.reusedConnections++;
+      String encoding = http.header("Transfer-Encoding");
+      encoding.toLowerCase();
+      chunked = encoding.indexOf("chunked") >= 0;
+      pending = true;
+      return httpCode;
+    }
+    
+    http.end();
+    client.stop();
+    
+    // Only a reused socket is worth retrying: the server may have closed it while idle
+    if (!reused) break;
+    stats.reconnects++;
+    VRAM_LOGD("http", "Stale connection (%d), reconnecting", httpCode);
+  }
+  
+  stats.failures++;
+  xSemaphoreGiveRecursive(mutex);
+  return httpCode;
+}
+
+bool HttpSession::readChunkLine(char* line, size_t size) {
+  WiFiClient* stream = http.getStreamPtr();
+  size_t length = 0;
+  unsigned long lastData = millis();
+  
+  // Framing lines arrive with the data around them, so waiting here is brief
+  while (true) {
+    if (stream->available() == 0) {
+      if (!http.connected() || millis() - lastData > HTTP_SESSION_TIMEOUT) return false;
+      delay(1);
+      continue;
+    }
+    int c = stream->read();
+    lastData = millis();
+    if (c == '\n') break;
+    if (c != '\r' && length < size - 1) line[length++] = c;
+  }
+  line[length] = '\0';
+  return true;
+}
+
+bool HttpSession::nextChunk() {
+  // "<hex size>[;extensions]", after the line break ending the previous chunk
+  char line[HTTP_SESSION_CHUNK_LINE];
+  do {
+    if (!readChunkLine(line, sizeof(line))) return false;
+  } while (line[0] == '\0');
+  
+  char* end;
+  chunkLeft = strtoul(line, &end, 16);
+  if (end == line) {
+    VRAM_LOGW("http", "Malformed chunk size: %s", line);
+    return false;
+  }
+  
+  // The last chunk is empty; trailer lines follow it up to a blank one
+  if (chunkLeft == 0) {
+    do {
+      if (!readChunkLine(line, sizeof(line))) return false;
+    } while (line[0] != '\0');
+    lastChunk = true;
+    return false;
+  }
+  return true;
+}
+
+int HttpSession::available() {
+  WiFiClient* stream = http.getStreamPtr();
+  if (!chunked) {
+    return stream->available();
+  }
+  if (chunkLeft == 0 && (lastChunk || stream->available() == 0 || !nextChunk())) {
+    return 0;
+  }
+  int ready = stream->available();
+  return (size_t)ready < chunkLeft ? ready : (int)chunkLeft;
+}
+
+int HttpSession::read() {
+  if (chunked && available() == 0) {
+    return -1;
+  }
+  int c = http.getStreamPtr()->read();
+  if (chunked && c >= 0) chunkLeft--;
+  return c;
+}
+
+size_t HttpSession::read(uint8_t* buffer, size_t size) {
+  if (chunked) {
+    if (chunkLeft == 0 && available() == 0) return 0;
+    if (size > chunkLeft) size = chunkLeft;
+  }
+  size_t count = http.getStreamPtr()->readBytes(buffer, size);
+  if (chunked) chunkLeft -= count;
+  return count;
+}
+
+bool HttpSession::bodyPending() {
+  return !(chunked && lastChunk) && http.connected();
+}
+
+bool HttpSession::drain(size_t limit) {
+  uint8_t scratch[64];
+  unsigned long lastData = millis();
+  
+  while (chunked && !lastChunk) {
+    int ready = available();
+    if (ready == 0) {
+      if (lastChunk) break;
+      if (!http.connected() || millis() - lastData > HTTP_SESSION_TIMEOUT) return false;
+      delay(1);
+      continue;
+    }
+    size_t count = read(scratch, (size_t)ready < sizeof(scratch) ? ready : sizeof(scratch));
+    if (count > limit) return false;
+    limit -= count;
+    lastData = millis();
+  }
+  return chunked && lastChunk;
+}
+
+void HttpSession::end() {
+  if (pending) {
+    // An unfinished chunked body would be read as the next response
+    if (chunked && !lastChunk) {
+      client.stop();
+    }
+    http.end();
+    pending = false;
+    xSemaphoreGiveRecursive(mutex);
+  }
+}
+
+void HttpSession::close() {
+  xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+  end();
+  client.stop();
+  xSemaphoreGiveRecursive(mutex);
+}
+
+void HttpSession::printStats() {
+  Serial.println("\n=== HTTP Session Statistics ===");
+  Serial.printf("Server: %s\n", baseURL.c_str());
+  Serial.printf("Requests: %lu\n", stats.requests);
+  Serial.printf("Reused Connections: %lu\n", stats.reusedConnections);
+  Serial.printf("Reconnects: %lu\n", stats.reconnects);
+  Serial.printf("Failures: %lu\n", stats.failures);
+  Serial.printf("Connection: %s\n", isConnected() ? "open" : "closed");
+  Serial.println("===============================\n");
+}
+
+#endif // HTTP_SESSION_H
\ No newline at end of file
@@ -0,0 +1,295 @@
+/*
+ * Load Metrics for VRAM System
+ * Latency histograms for each stage of a resource load, reported to the
+ * server with cache and heap counters
+ */
+
+#ifndef LOAD_METRICS_H
+#define LOAD_METRICS_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "http_session.h"
+#include "memory_manager.h"
+#include "resource_cache.h"
+#include "vram_log.h"
+
+// Histogram configuration; server/latency_histogram.py uses the same buckets
+#define LATENCY_SUB_BITS      2             // 4 linear steps per power of two: at most 25% wide
+#define LATENCY_SUB_BUCKETS   (1 << LATENCY_SUB_BITS)
+#define LATENCY_BUCKETS       100           // Up to 2^26us (67s); longer times land in the last
+#define LATENCY_COUNT_MAX     0xFFFF        // Bucket counts saturate
+
+// Report configuration
+#define METRICS_REPORT_INTERVAL 60000       // Histograms are sent and cleared this often (ms)
+#define METRICS_REPORT_PATH     "/api/metrics"
+#define METRICS_REPORT_TIMEOUT  3000
+
+// Stages of a load, in the order they happen
+enum LoadStage {
+  STAGE_CONNECT,                            // DNS lookup and TCP connect; only for new connections
+  STAGE_FIRST_BYTE,                         // Request sent until response headers are read
+  STAGE_TRANSFER,                           // Reading the body off the socket
+  STAGE_DECODE,                             // Inflating or unescaping the body
+  STAGE_CACHE_INSERT,                       // Reserving, committing and persisting the entry
+  STAGE_COUNT
+};
+
+// Report statistics
+struct MetricsStats {
+  unsigned long reportsSent;
+  unsigned long reportsFailed;
+  int lastHttpCode;
+};
+
+// Log-linear buckets in microseconds, in the manner of HDR histograms:
+// exact below 4us, then four buckets per power of two, so any percentile
+// is within 25% of the true value at a fixed 200 bytes.
+class LatencyHistogram {
+private:
+  uint16_t counts[LATENCY_BUCKETS];
+  uint32_t total;
+  uint64_t sum;
+  uint32_t maxValue;
+
+public:
+  LatencyHistogram() { reset(); }
+  
+  static int bucketFor(uint32_t micros);
+  static uint32_t bucketUpper(int bucket);   // Largest value the bucket holds
+  
+  void record(uint32_t micros);
+  void merge(const LatencyHistogram& other);
+  void reset();
+  
+  uint32_t getCount() const { return total; }
+  uint32_t getMax() const { return maxValue; }
+  uint32_t getMean() const { return total > 0 ? (uint32_t)(sum / total) : 0; }
+  uint32_t percentile(float fraction) const;  // 0.99 for p99; an upper bound
+  
+  // {"n":..,"sum":..,"max":..,"b":[bucket,count,...]} listing used buckets only
+  void appendJson(String& out) const;
+};
+
+// Stages are recorded by whichever task runs the loader and reported from
+// another, so the histograms are only touched inside a critical section.
+// A report takes the histograms and starts new ones; if it fails, they are
+// merged back and go out with the next one, so no sample is lost.
+class LoadMetrics {
+private:
+  LatencyHistogram stages[STAGE_COUNT];
+  LatencyHistogram sending[STAGE_COUNT];    // Taken out for the report in flight
+  unsigned long intervalStart;
+  MetricsStats stats;
+  portMUX_TYPE lock;
+  
+  String buildReport(ResourceCache& cache, unsigned long interval);
+
+public:
+  LoadMetrics();
+  
+  static const char* stageName(int stage);
+  
+  void record(LoadStage stage, uint32_t micros);
+  LatencyHistogram getStage(LoadStage stage);  // Since the last report
+  
+  // POST the histograms since the last report, with cache and heap counters.
+  // Blocks on the network; the async loader runs it on its task.
+  bool report(HttpSession& session, ResourceCache& cache);
+  
+  // Statistics
+  MetricsStats getStats() { return stats; }
+  void printStats();
+};
+
+// Implementation
+int LatencyHistogram::bucketFor(uint32_t micros) {
+  if (micros < LATENCY_SUB_BUCKETS) return micros;
+  int shift = (31 - __builtin_clz(micros)) - LATENCY_SUB_BITS;
+  int bucket = (shift + 1) * LATENCY_SUB_BUCKETS + (int)(micros >> shift) - LATENCY_SUB_BUCKETS;
+  return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+uint32_t LatencyHistogram::bucketUpper(int bucket) {
+  if (bucket < LATENCY_SUB_BUCKETS) return bucket;
+  int shift = bucket / LATENCY_SUB_BUCKETS - 1;
+  uint32_t top = LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS;
+  return ((top + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint32_t micros) {
+  uint16_t& count = counts[bucketFor(micros)];
+  if (count < LATENCY_COUNT_MAX) count++;
+  total++;
+  sum += micros;
+  if (micros > maxValue) maxValue = micros;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    uint32_t count = (uint32_t)counts[i] + other.counts[i];
+    counts[i] = count < LATENCY_COUNT_MAX ? count : LATENCY_COUNT_MAX;
+  }
+  total += other.total;
+  sum += other.sum;
+  if (other.maxValue > maxValue) maxValue = other.maxValue;
+}
+
+void LatencyHistogram::reset() {
+  memset(counts, 0, sizeof(counts));
+  total = 0;
+  sum = 0;
+  maxValue = 0;
+}
+
+uint32_t LatencyHistogram::percentile(float fraction) const {
+  if (total == 0) return 0;
+  
+  // Bucket counts saturate, so rank against what they add up to
+  uint32_t counted = 0;
+  for (int i = 0; i < LATENCY_BUCKETS; i++) counted += counts[i];
+  uint32_t rank = (uint32_t)(fraction * counted + 0.5f);
+  if (rank < 1) rank = 1;
+  
+  uint32_t seen = 0;
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    seen += counts[i];
+    if (seen >= rank) {
+      uint32_t upper = bucketUpper(i);
+      return upper < maxValue ? upper : maxValue;
+    }
+  }
+  return maxValue;
+}
+
+void LatencyHistogram::appendJson(String& out) const {
+  char field[72];   // The header at its widest: 32-bit counts and a 64-bit sum take 65 bytes
+  snprintf(field, sizeof(field), "{\"n\":%u,\"sum\":%llu,\"max\":%u,\"b\":[",
+           total, (unsigned long long)sum, maxValue);
+  out += field;
+  
+  bool first = true;
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    if (counts[i] == 0) continue;
+    snprintf(field, sizeof(field), first ? "%d,%u" : ",%d,%u", i, counts[i]);
+    out += field;
+    first = false;
+  }
+  out += "]}";
+}
+
+LoadMetrics::LoadMetrics() {
+  intervalStart = 0;
+  memset(&stats, 0, sizeof(stats));
+  lock = portMUX_INITIALIZER_UNLOCKED;
+}
+
+const char* LoadMetrics::stageName(int stage) {
+  switch (stage) {
+    case STAGE_CONNECT: return "connect";
+    case STAGE_FIRST_BYTE: return "first_byte";
+    case STAGE_TRANSFER: return "transfer";
+    case STAGE_DECODE: return "decode";
+    case STAGE_CACHE_INSERT: return "cache_insert";
+    default: return "unknown";
+  }
+}
+
+void LoadMetrics::record(LoadStage stage, uint32_t micros) {
+  portENTER_CRITICAL(&lock);
+  stages[stage].record(micros);
+  portEXIT_CRITICAL(&lock);
+}
+
+LatencyHistogram LoadMetrics::getStage(LoadStage stage) {
+  portENTER_CRITICAL(&lock);
+  LatencyHistogram snapshot = stages[stage];
+  portEXIT_CRITICAL(&lock);
+  return snapshot;
+}
+
+String LoadMetrics::buildReport(ResourceCache& cache, unsigned long interval) {
+  MemoryInfo info = memoryManager.getMemoryInfo();
+  String body;
+  body.reserve(memoryManager.isProfiling() ? 2048 : 512);
+  
+  char field[160];
+  snprintf(field, sizeof(field), "{\"device\":\"%s\",\"uptime\":%lu,\"interval\":%lu,\"stages\":{",
+           WiFi.macAddress().c_str(), millis(), interval);
+  body += field;
+  
+  bool first = true;
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    if (sending[i].getCount() == 0) continue;
+    if (!first) body += ",";
+    body += "\"";
+    body += stageName(i);
+    body += "\":";
+    sending[i].appendJson(body);
+    first = false;
+  }
+  
+  snprintf(field, sizeof(field), "},\"cache\":{\"hits\":%d,\"misses\":%d,\"evictions\":%d,\"entries\":%d,\"bytes\":%u}",
+           cache.getCacheHits(), cache.getCacheMisses(), cache.getEvictions(),
+           cache.getResourceCount(), cache.getCacheSize());
+  body += field;
+  snprintf(field, sizeof(field), ",\"memory\":{\"free_heap\":%u,\"min_free_heap\":%u,\"largest_block\":%u,"
+           "\"peak_tracked\":%u,\"fragmentation\":%d}",
+           info.freeHeap, info.minFreeHeap, info.largestFreeBlock,
+           memoryManager.getPeakUsage(), info.fragmentation);
+  body += field;
+  
+  if (memoryManager.isProfiling()) {
+    body += ",\"heap\":";
+    memoryManager.appendProfileJson(body);
+  }
+  body += "}";
+  return body;
+}
+
+bool LoadMetrics::report(HttpSession& session, ResourceCache& cache) {
+  portENTER_CRITICAL(&lock);
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    sending[i] = stages[i];
+    stages[i].reset();
+  }
+  portEXIT_CRITICAL(&lock);
+  
+  unsigned long now = millis();
+  String body = buildReport(cache, now - intervalStart);
+  stats.lastHttpCode = session.post(METRICS_REPORT_PATH, body, "application/json", METRICS_REPORT_TIMEOUT);
+  if (stats.lastHttpCode > 0) {
+    session.response().getString();   // Read the reply so the connection stays usable
+  }
+  session.end();
+  
+  if (stats.lastHttpCode != HTTP_CODE_OK) {
+    VRAM_LOGW("metrics", "Metrics report failed: %d", stats.lastHttpCode);
+    portENTER_CRITICAL(&lock);
+    for (int i = 0; i < STAGE_COUNT; i++) {
+      stages[i].merge(sending[i]);
+    }
+    portEXIT_CRITICAL(&lock);
+    stats.reportsFailed++;
+    return false;
+  }
+  
+  VRAM_LOGD("metrics", "Metrics reported (%d bytes)", body.length());
+  intervalStart = now;
+  stats.reportsSent++;
+  return true;
+}
+
+void LoadMetrics::printStats() {
+  Serial.println("\n=== Load Stage Latency ===");
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    LatencyHistogram stage = getStage((LoadStage)i);
+    Serial.printf("%-12s n=%u p50=%uus p99=%uus max=%uus\n", stageName(i), stage.getCount(),
+                  stage.percentile(0.50f), stage.percentile(0.99f), stage.getMax());
+  }
+  Serial.printf("Reports Sent: %lu, Failed: %lu (last HTTP %d)\n",
+                stats.reportsSent, stats.reportsFailed, stats.lastHttpCode);
+  Serial.println("==========================\n");
+}
+
+#endif // LOAD_METRICS_H
\ No newline at end of file
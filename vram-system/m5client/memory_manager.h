@@ -7,6 +7,51 @@
 #define MEMORY_MANAGER_H
 
 #include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "vram_log.h"
+
+// Slab pool configuration
+#define VRAM_POOL_SIZE        (96 * 1024)  // Region reserved at begin()
+#define VRAM_POOL_MIN_SIZE    (16 * 1024)  // Smallest region worth reserving
+#define SLAB_BLOCK_OVERHEAD   (sizeof(MemoryBlock) + 8)             // Tracking header, plus room for a NUL
+#define SLAB_PAGE_SIZE        (4096 + 16 * SLAB_BLOCK_OVERHEAD)  // 4608 on ESP32; only the 32, 64 and 256 classes fill it exactly
+#define SLAB_MAX_PAGES        (VRAM_POOL_SIZE / SLAB_PAGE_SIZE)
+#define SLAB_MIN_CLASS_SHIFT  5            // Smallest size class holds 32 bytes
+#define SLAB_CLASS_COUNT      7            // 32..2048; larger requests take whole pages
+#define SLAB_NONE             0xFFFF
+
+// Slab page states
+#define SLAB_PAGE_FREE        0
+#define SLAB_PAGE_SMALL       1            // Carved into blocks of one size class
+#define SLAB_PAGE_RUN         2            // First page of a multi-page allocation
+#define SLAB_PAGE_RUN_TAIL    3            // Continuation of a run
+
+// Allocation tracking configuration
+#define MAX_IDENTIFIERS       32           // Interned identifier table size
+#define IDENTIFIER_LENGTH     24
+#define BLOCK_MAGIC           0x564D424Bu  // Marks a live tracked block
+
+// Allocation profiler configuration
+#define PROFILER_SAMPLE_BYTES     8192     // Mean bytes allocated between sampled blocks
+#define PROFILER_MAX_SITES        48       // Call site table size; slot 0 takes the overflow
+#define PROFILER_SITE_NONE        0xFFFF   // Block was not sampled
+#define PROFILER_LIFETIME_BUCKETS 8        // <10ms, <100ms, <1s, <10s, <1min, <10min, <1h, longer
+#define PROFILER_REPORT_SITES     16       // Sites exported, most live bytes first
+
+// Scoped hold on a recursive FreeRTOS mutex. VRAM state is shared between
+// the loop task and the async loader task, so public entry points take one.
+class VramLock {
+private:
+  SemaphoreHandle_t mutex;
+
+public:
+  explicit VramLock(SemaphoreHandle_t handle) : mutex(handle) { xSemaphoreTakeRecursive(mutex, portMAX_DELAY); }
+  ~VramLock() { xSemaphoreGiveRecursive(mutex); }
+  
+  VramLock(const VramLock&) = delete;
+  VramLock& operator=(const VramLock&) = delete;
+};
 
 // Memory information structure
 struct MemoryInfo {
@@ -14,52 +59,208 @@ struct MemoryInfo {
   size_t freeHeap;
   size_t usedHeap;
   size_t largestFreeBlock;
+  size_t minFreeHeap;         // Lowest system free heap since boot; the reserved pool counts as used
   int usagePercent;
   int fragmentation;
+  size_t poolSize;
+  size_t poolFree;
 };
 
-// Memory allocation tracking
+// Memory allocation tracking header, placed directly in front of every
+// tracked allocation so free/realloc find it in constant time
 struct MemoryBlock {
-  void* ptr;
-  size_t size;
+  uint32_t magic;
+  uint32_t size;
   unsigned long allocTime;
-  String identifier;
+  uint16_t identifier;   // Index into the interned identifier table
+  uint16_t site;         // Call site slot if sampled by the profiler
+  MemoryBlock* prev;
   MemoryBlock* next;
 };
 
+// Per-page bookkeeping for the slab pool
+struct SlabPage {
+  uint8_t state;
+  uint8_t sizeClass;
+  uint16_t inUse;        // Blocks in use, or run length for SLAB_PAGE_RUN
+  uint16_t freeList;     // First free block index within a small page
+  uint16_t prevPartial;
+  uint16_t nextPartial;
+};
+
+// Size-class pool carved out of a single region reserved at startup.
+// Small requests share pages of equal-sized blocks; anything larger than
+// the biggest class takes a contiguous run of pages. Freed memory goes
+// back to its page instead of the global heap. Classes and pages are
+// sized for a power-of-two payload behind its tracking header, so a 1KB
+// resource takes 1KB of a page rather than the 2KB class above it.
+class SlabAllocator {
+private:
+  uint8_t* region;
+  uint16_t pageCount;
+  SlabPage pages[SLAB_MAX_PAGES];
+  uint16_t partialHead[SLAB_CLASS_COUNT];
+  size_t usedBytes;
+  
+  static int classFor(size_t size);
+  static size_t classSize(int sizeClass) { return ((size_t)1 << (sizeClass + SLAB_MIN_CLASS_SHIFT)) + SLAB_BLOCK_OVERHEAD; }
+  uint8_t* pageAddress(uint16_t page) { return region + (size_t)page * SLAB_PAGE_SIZE; }
+  int findFreeRun(uint16_t count);
+  void formatPage(uint16_t page, int sizeClass);
+  void linkPartial(uint16_t page);
+  void unlinkPartial(uint16_t page);
+  void* allocateSmall(int sizeClass);
+  void* takeBlock(uint16_t page);
+  void* allocateRun(size_t size);
+
+public:
+  SlabAllocator();
+  ~SlabAllocator();
+  
+  bool begin(size_t size);
+  void* allocate(size_t size);
+  void* allocateCompacting(const void* ptr, size_t size);
+  void release(void* ptr);
+  void trim(void* ptr, size_t newSize);
+  bool owns(const void* ptr) const;
+  size_t usableSize(const void* ptr) const;
+  
+  // Statistics
+  bool isReady() const { return region != nullptr; }
+  size_t getCapacity() const { return (size_t)pageCount * SLAB_PAGE_SIZE; }
+  size_t getUsed() const { return usedBytes; }
+  size_t getFree() const { return getCapacity() - usedBytes; }
+  size_t getLargestFreeRun();
+  int getFreePages();
+  int getFragmentation();        // Share of free bytes outside the largest free run (%)
+  void printReport();
+};
+
+// Per-identifier accounting, one row per interned name
+struct IdentifierStats {
+  char name[IDENTIFIER_LENGTH];
+  uint32_t hash;
+  size_t liveBytes;
+  uint32_t liveBlocks;
+  size_t heapBytes;                  // Live bytes that did not fit the slab pool
+  size_t peakBytes;                  // Since the profiler was enabled
+  unsigned long totalAllocations;
+  unsigned long profiledAllocations; // Since the profiler was enabled
+  uint32_t lifetimes[PROFILER_LIFETIME_BUCKETS];  // Sampled blocks by age at free
+};
+
+// Where sampled blocks were allocated. Each sample stands for the bytes
+// allocated since the one before it, so the estimates converge on the
+// site's true totals without every block being looked at.
+struct AllocationSite {
+  const char* file;                  // __FILE__ of the VRAM_MALLOC; nullptr for slot 0
+  uint16_t line;
+  uint16_t identifier;               // Of the first sample
+  size_t liveEstimate;               // Bytes
+  uint64_t allocatedEstimate;        // Bytes, since the profiler was enabled
+  uint32_t liveSamples;
+  uint32_t samples;                  // Since the profiler was enabled
+};
+
+// Called when a tracked allocation fails, with the manager unlocked so it
+// may free memory; returns true if the allocation is worth retrying
+typedef bool (*MemoryPressureHandler)(size_t size, void* context);
+
 class MemoryManager {
 private:
+  SlabAllocator pool;
   MemoryBlock* allocatedBlocks;
+  IdentifierStats identifiers[MAX_IDENTIFIERS];
+  uint16_t identifierCount;
   size_t totalAllocated;
   size_t peakUsage;
   unsigned long allocationCount;
   unsigned long freeCount;
+  unsigned long failedAllocations;
+  unsigned long relocations;
+  MemoryPressureHandler pressureHandler;
+  void* pressureContext;
+  SemaphoreHandle_t mutex;     // Guards the pool and the tracking tables
+  
+  // Sampling profiler
+  AllocationSite sites[PROFILER_MAX_SITES];
+  uint16_t siteCount;
+  bool profiling;
+  size_t sampleBytes;
+  long bytesUntilSample;
+  uint32_t sampleSeed;
+  unsigned long profileStart;
   
   // Memory optimization settings
   static const size_t MIN_FREE_HEAP = 32768;  // 32KB minimum free
   static const int CRITICAL_USAGE_THRESHOLD = 90;
   static const int WARNING_USAGE_THRESHOLD = 75;
   
-  void addBlock(void* ptr, size_t size, const String& identifier);
-  void removeBlock(void* ptr);
-  MemoryBlock* findBlock(void* ptr);
+  void linkBlock(MemoryBlock* block);
+  void unlinkBlock(MemoryBlock* block);
+  MemoryBlock* headerFor(void* ptr);
+  uint16_t internIdentifier(const char* identifier);
+  void* allocateTracked(size_t size, const char* identifier, const char* file, int line);
   
+  uint16_t internSite(const char* file, int line, uint16_t identifier);
+  void sampleBlock(MemoryBlock* block, const char* file, int line);
+  void releaseSample(MemoryBlock* block);
+  void nextSampleDistance();
+  size_t sampleWeight(size_t size) { return size > sampleBytes ? size : sampleBytes; }
+  static const char* siteFileName(const char* file);
+  
+  // Raw storage: slab pool first, global heap as fallback
+  void* rawAllocate(size_t size);
+  void* rawReallocate(void* ptr, size_t oldSize, size_t newSize);
+  void rawFree(void* ptr);
+
 public:
   MemoryManager();
   ~MemoryManager();
   
   // Initialization
-  void begin();
+  void begin(size_t poolSize = VRAM_POOL_SIZE);
   
   // Memory allocation with tracking
-  void* allocate(size_t size, const String& identifier = "");
-  void* reallocate(void* ptr, size_t newSize, const String& identifier = "");
+  void* allocate(size_t size, const char* identifier = "", const char* file = nullptr, int line = 0);
+  void* allocate(size_t size, const String& identifier, const char* file = nullptr, int line = 0) {
+    return allocate(size, identifier.c_str(), file, line);
+  }
+  void* reallocate(void* ptr, size_t newSize, const char* identifier = "");
+  void* reallocate(void* ptr, size_t newSize, const String& identifier) { return reallocate(ptr, newSize, identifier.c_str()); }
   void deallocate(void* ptr);
   
+  // Moves a block to where it leaves the pool less fragmented and returns
+  // the new address, or nullptr if it stays. Only for owners that can
+  // update every reference to the block, like the cache's node table.
+  void* relocate(void* ptr);
+  
+  // Gets one chance to free memory whenever allocate() fails
+  void setPressureHandler(MemoryPressureHandler handler, void* context = nullptr);
+  
+  // Per-identifier accounting
+  uint16_t getIdentifierCount() { return identifierCount; }
+  const IdentifierStats& getIdentifierStats(uint16_t id) { return identifiers[id]; }
+  
+  // Allocation profiler: peak and allocation counts per identifier, plus
+  // call sites and lifetimes of about one block per sampleBytes allocated,
+  // which keeps it cheap enough to leave enabled. Enabling again restarts
+  // the counts; live estimates carry over.
+  void enableProfiler(size_t sampleBytes = PROFILER_SAMPLE_BYTES);
+  void disableProfiler();
+  bool isProfiling() { return profiling; }
+  uint16_t getSiteCount() { return siteCount; }
+  AllocationSite getSite(uint16_t site);
+  
+  // {"sample_bytes":..,"elapsed":..,"identifiers":[..],"sites":[..]}
+  void appendProfileJson(String& out);
+  void printProfile();
+  
   // Memory information
   MemoryInfo getMemoryInfo();
   size_t getTotalAllocated() { return totalAllocated; }
   size_t getPeakUsage() { return peakUsage; }
+  SlabAllocator& getPool() { return pool; }
   
   // Memory optimization
   bool isMemoryLow();
@@ -79,17 +280,352 @@ public:
 extern MemoryManager memoryManager;
 
 // Memory allocation macros with tracking
-#define VRAM_MALLOC(size, id) memoryManager.allocate(size, id)
+#define VRAM_MALLOC(size, id) memoryManager.allocate(size, id, __FILE__, __LINE__)
 #define VRAM_REALLOC(ptr, size, id) memoryManager.reallocate(ptr, size, id)
 #define VRAM_FREE(ptr) memoryManager.deallocate(ptr)
+#define VRAM_RELOCATE(ptr) memoryManager.relocate(ptr)
 
 // Implementation
+SlabAllocator::SlabAllocator() {
+  region = nullptr;
+  pageCount = 0;
+  usedBytes = 0;
+  for (int i = 0; i < SLAB_CLASS_COUNT; i++) {
+    partialHead[i] = SLAB_NONE;
+  }
+}
+
+SlabAllocator::~SlabAllocator() {
+  if (region != nullptr) {
+    free(region);
+  }
+}
+
+bool SlabAllocator::begin(size_t size) {
+  if (region != nullptr) return true;
+  
+  // Halve the request until the heap can satisfy it in one piece
+  size_t pagesWanted = size / SLAB_PAGE_SIZE;
+  if (pagesWanted > SLAB_MAX_PAGES) {
+    pagesWanted = SLAB_MAX_PAGES;
+  }
+  
+  while (pagesWanted * SLAB_PAGE_SIZE >= VRAM_POOL_MIN_SIZE) {
+    region = (uint8_t*)malloc(pagesWanted * SLAB_PAGE_SIZE);
+    if (region != nullptr) break;
+    pagesWanted /= 2;
+  }
+  
+  if (region == nullptr) {
+    return false;
+  }
+  
+  pageCount = pagesWanted;
+  for (uint16_t i = 0; i < SLAB_MAX_PAGES; i++) {
+    pages[i].state = SLAB_PAGE_FREE;
+    pages[i].sizeClass = 0;
+    pages[i].inUse = 0;
+    pages[i].freeList = SLAB_NONE;
+    pages[i].prevPartial = SLAB_NONE;
+    pages[i].nextPartial = SLAB_NONE;
+  }
+  return true;
+}
+
+int SlabAllocator::classFor(size_t size) {
+  for (int c = 0; c < SLAB_CLASS_COUNT; c++) {
+    if (size <= classSize(c)) return c;
+  }
+  return -1;
+}
+
+void* SlabAllocator::allocate(size_t size) {
+  if (region == nullptr || size == 0) return nullptr;
+  
+  int sizeClass = classFor(size);
+  if (sizeClass >= 0) {
+    return allocateSmall(sizeClass);
+  }
+  return allocateRun(size);
+}
+
+int SlabAllocator::findFreeRun(uint16_t count) {
+  // First fit from the bottom keeps long runs available at the top
+  uint16_t runStart = 0;
+  uint16_t runLength = 0;
+  for (uint16_t i = 0; i < pageCount; i++) {
+    if (pages[i].state == SLAB_PAGE_FREE) {
+      if (runLength == 0) runStart = i;
+      if (++runLength == count) return runStart;
+    } else {
+      runLength = 0;
+    }
+  }
+  return -1;
+}
+
+void SlabAllocator::formatPage(uint16_t page, int sizeClass) {
+  uint16_t blocks = SLAB_PAGE_SIZE / classSize(sizeClass);
+  uint8_t* base = pageAddress(page);
+  
+  // Free blocks store the index of the next free block in their first bytes
+  for (uint16_t i = 0; i < blocks; i++) {
+    *(uint16_t*)(base + i * classSize(sizeClass)) = (i + 1 < blocks) ? i + 1 : SLAB_NONE;
+  }
+  
+  pages[page].state = SLAB_PAGE_SMALL;
+  pages[page].sizeClass = sizeClass;
+  pages[page].inUse = 0;
+  pages[page].freeList = 0;
+}
+
+void SlabAllocator::linkPartial(uint16_t page) {
+  int sizeClass = pages[page].sizeClass;
+  pages[page].prevPartial = SLAB_NONE;
+  pages[page].nextPartial = partialHead[sizeClass];
+  if (partialHead[sizeClass] != SLAB_NONE) {
+    pages[partialHead[sizeClass]].prevPartial = page;
+  }
+  partialHead[sizeClass] = page;
+}
+
+void SlabAllocator::unlinkPartial(uint16_t page) {
+  SlabPage& p = pages[page];
+  if (p.prevPartial != SLAB_NONE) {
+    pages[p.prevPartial].nextPartial = p.nextPartial;
+  } else {
+    partialHead[p.sizeClass] = p.nextPartial;
+  }
+  if (p.nextPartial != SLAB_NONE) {
+    pages[p.nextPartial].prevPartial = p.prevPartial;
+  }
+  p.prevPartial = SLAB_NONE;
+  p.nextPartial = SLAB_NONE;
+}
+
+void* SlabAllocator::allocateSmall(int sizeClass) {
+  uint16_t page = partialHead[sizeClass];
+  if (page == SLAB_NONE) {
+    int freePage = findFreeRun(1);
+    if (freePage < 0) return nullptr;
+    page = freePage;
+    formatPage(page, sizeClass);
+    linkPartial(page);
+  }
+  return takeBlock(page);
+}
+  
+void* SlabAllocator::takeBlock(uint16_t page) {
+  SlabPage& p = pages[page];
+  int sizeClass = p.sizeClass;
+  uint8_t* block = pageAddress(page) + p.freeList * classSize(sizeClass);
+  p.freeList = *(uint16_t*)block;
+  p.inUse++;
+  
+  if (p.freeList == SLAB_NONE) {
+    unlinkPartial(page);
+  }
+  
+  usedBytes += classSize(sizeClass);
+  return block;
+}
+
+void* SlabAllocator::allocateRun(size_t size) {
+  uint16_t count = (size + SLAB_PAGE_SIZE - 1) / SLAB_PAGE_SIZE;
+  int start = findFreeRun(count);
+  if (start < 0) return nullptr;
+  
+  pages[start].state = SLAB_PAGE_RUN;
+  pages[start].inUse = count;
+  for (uint16_t i = 1; i < count; i++) {
+    pages[start + i].state = SLAB_PAGE_RUN_TAIL;
+  }
+  
+  usedBytes += (size_t)count * SLAB_PAGE_SIZE;
+  return pageAddress(start);
+}
+
+void* SlabAllocator::allocateCompacting(const void* ptr, size_t size) {
+  if (region == nullptr || size == 0) return nullptr;
+  
+  // Heap blocks are always better off in the pool
+  int sizeClass = classFor(size);
+  if (!owns(ptr)) {
+    return allocate(size);
+  }
+  
+  uint16_t page = ((const uint8_t*)ptr - region) / SLAB_PAGE_SIZE;
+  const SlabPage& p = pages[page];
+  
+  // Shrunk by realloc into a bigger slot than it needs
+  bool misplaced = (sizeClass >= 0) ? (p.state != SLAB_PAGE_SMALL || p.sizeClass != sizeClass)
+                                    : (p.state != SLAB_PAGE_RUN);
+  if (misplaced) {
+    return allocate(size);
+  }
+  
+  if (sizeClass < 0) {
+    // Runs slide down, so the free pages gather above them
+    uint16_t count = (size + SLAB_PAGE_SIZE - 1) / SLAB_PAGE_SIZE;
+    int start = findFreeRun(count);
+    if (start < 0 || start > page) return nullptr;
+    return allocateRun(size);
+  }
+  
+  // Small blocks gather in the fullest page of their class, so sparse pages empty out
+  uint16_t best = SLAB_NONE;
+  for (uint16_t candidate = partialHead[sizeClass]; candidate != SLAB_NONE;
+       candidate = pages[candidate].nextPartial) {
+    const SlabPage& c = pages[candidate];
+    bool fuller = c.inUse > p.inUse || (c.inUse == p.inUse && candidate < page);
+    if (candidate != page && fuller && (best == SLAB_NONE || c.inUse > pages[best].inUse)) {
+      best = candidate;
+    }
+  }
+  return best != SLAB_NONE ? takeBlock(best) : nullptr;
+}
+
+void SlabAllocator::release(void* ptr) {
+  if (!owns(ptr)) return;
+  
+  size_t offset = (uint8_t*)ptr - region;
+  uint16_t page = offset / SLAB_PAGE_SIZE;
+  SlabPage& p = pages[page];
+  
+  if (p.state == SLAB_PAGE_SMALL) {
+    size_t blockSize = classSize(p.sizeClass);
+    uint16_t block = (offset % SLAB_PAGE_SIZE) / blockSize;
+    bool wasFull = (p.freeList == SLAB_NONE);
+    
+    *(uint16_t*)(pageAddress(page) + block * blockSize) = p.freeList;
+    p.freeList = block;
+    p.inUse--;
+    usedBytes -= blockSize;
+    
+    if (p.inUse == 0) {
+      // Empty pages go back to the page pool for any size class
+      if (!wasFull) unlinkPartial(page);
+      p.state = SLAB_PAGE_FREE;
+      p.freeList = SLAB_NONE;
+    } else if (wasFull) {
+      linkPartial(page);
+    }
+  } else if (p.state == SLAB_PAGE_RUN && offset % SLAB_PAGE_SIZE == 0) {
+    uint16_t count = p.inUse;
+    for (uint16_t i = 0; i < count; i++) {
+      pages[page + i].state = SLAB_PAGE_FREE;
+      pages[page + i].inUse = 0;
+    }
+    usedBytes -= (size_t)count * SLAB_PAGE_SIZE;
+  } else {
+    VRAM_LOGE("mem", "SlabAllocator: invalid release at %p", ptr);
+  }
+}
+
+void SlabAllocator::trim(void* ptr, size_t newSize) {
+  if (!owns(ptr) || newSize == 0) return;
+  
+  size_t offset = (uint8_t*)ptr - region;
+  uint16_t page = offset / SLAB_PAGE_SIZE;
+  SlabPage& p = pages[page];
+  if (p.state != SLAB_PAGE_RUN || offset % SLAB_PAGE_SIZE != 0) return;
+  
+  // Hand the unused tail pages of a run back to the pool
+  uint16_t keep = (newSize + SLAB_PAGE_SIZE - 1) / SLAB_PAGE_SIZE;
+  if (keep >= p.inUse) return;
+  for (uint16_t i = keep; i < p.inUse; i++) {
+    pages[page + i].state = SLAB_PAGE_FREE;
+    pages[page + i].inUse = 0;
+  }
+  usedBytes -= (size_t)(p.inUse - keep) * SLAB_PAGE_SIZE;
+  p.inUse = keep;
+}
+
+bool SlabAllocator::owns(const void* ptr) const {
+  return region != nullptr && (const uint8_t*)ptr >= region &&
+         (const uint8_t*)ptr < region + (size_t)pageCount * SLAB_PAGE_SIZE;
+}
+
+size_t SlabAllocator::usableSize(const void* ptr) const {
+  if (!owns(ptr)) return 0;
+  
+  const SlabPage& p = pages[((const uint8_t*)ptr - region) / SLAB_PAGE_SIZE];
+  if (p.state == SLAB_PAGE_SMALL) return classSize(p.sizeClass);
+  if (p.state == SLAB_PAGE_RUN) return (size_t)p.inUse * SLAB_PAGE_SIZE;
+  return 0;
+}
+
+size_t SlabAllocator::getLargestFreeRun() {
+  uint16_t best = 0;
+  uint16_t runLength = 0;
+  for (uint16_t i = 0; i < pageCount; i++) {
+    runLength = (pages[i].state == SLAB_PAGE_FREE) ? runLength + 1 : 0;
+    if (runLength > best) best = runLength;
+  }
+  return (size_t)best * SLAB_PAGE_SIZE;
+}
+
+int SlabAllocator::getFragmentation() {
+  size_t freeBytes = getFree();
+  if (region == nullptr || freeBytes == 0) return 0;
+  return 100 - (int)(getLargestFreeRun() * 100 / freeBytes);
+}
+
+int SlabAllocator::getFreePages() {
+  int freePages = 0;
+  for (uint16_t i = 0; i < pageCount; i++) {
+    if (pages[i].state == SLAB_PAGE_FREE) freePages++;
+  }
+  return freePages;
+}
+
+void SlabAllocator::printReport() {
+  Serial.println("\n=== Slab Pool ===");
+  if (region == nullptr) {
+    Serial.println("Pool not reserved");
+    return;
+  }
+  
+  Serial.printf("Capacity: %d bytes (%d pages)\n", getCapacity(), pageCount);
+  Serial.printf("In Use: %d bytes\n", usedBytes);
+  Serial.printf("Free Pages: %d, Largest Run: %d bytes\n", getFreePages(), getLargestFreeRun());
+  
+  for (int c = 0; c < SLAB_CLASS_COUNT; c++) {
+    int classPages = 0;
+    int blocks = 0;
+    for (uint16_t i = 0; i < pageCount; i++) {
+      if (pages[i].state == SLAB_PAGE_SMALL && pages[i].sizeClass == c) {
+        classPages++;
+        blocks += pages[i].inUse;
+      }
+    }
+    if (classPages > 0) {
+      Serial.printf("Class %d B: %d blocks on %d pages\n", classSize(c), blocks, classPages);
+    }
+  }
+}
+
 MemoryManager::MemoryManager() {
   allocatedBlocks = nullptr;
+  memset(identifiers, 0, sizeof(identifiers));
+  strcpy(identifiers[0].name, "(other)");  // Unnamed and overflow allocations
+  identifierCount = 1;
+  memset(sites, 0, sizeof(sites));
+  siteCount = 1;                           // Slot 0 collects unknown and overflow sites
+  profiling = false;
+  sampleBytes = PROFILER_SAMPLE_BYTES;
+  bytesUntilSample = 0;
+  sampleSeed = 0;
+  profileStart = 0;
   totalAllocated = 0;
   peakUsage = 0;
   allocationCount = 0;
   freeCount = 0;
+  failedAllocations = 0;
+  relocations = 0;
+  pressureHandler = nullptr;
+  pressureContext = nullptr;
+  mutex = xSemaphoreCreateRecursiveMutex();
 }
 
 MemoryManager::~MemoryManager() {
@@ -97,146 +633,512 @@ MemoryManager::~MemoryManager() {
   MemoryBlock* current = allocatedBlocks;
   while (current != nullptr) {
     MemoryBlock* next = current->next;
-    free(current->ptr);
-    delete current;
+    current->magic = 0;
+    rawFree(current);
     current = next;
   }
 }
 
-void MemoryManager::begin() {
-  Serial.println("MemoryManager: Initializing...");
+void MemoryManager::begin(size_t poolSize) {
+  VramLock guard(mutex);
+  VRAM_LOGI("mem", "MemoryManager: Initializing...");
+  
+  if (pool.begin(poolSize)) {
+    VRAM_LOGI("mem", "Slab pool reserved: %d bytes", pool.getCapacity());
+  } else {
+    VRAM_LOGW("mem", "Slab pool unavailable, using global heap");
+  }
   
   MemoryInfo info = getMemoryInfo();
-  Serial.printf("Initial heap: %d bytes free, %d bytes total\n", 
-                info.freeHeap, info.totalHeap);
+  VRAM_LOGI("mem", "Initial heap: %d bytes free, %d bytes total", 
+                   info.freeHeap, info.totalHeap);
   
   if (info.freeHeap < MIN_FREE_HEAP) {
-    Serial.println("WARNING: Low initial memory!");
+    VRAM_LOGW("mem", "Low initial memory!");
   }
 }
 
-void* MemoryManager::allocate(size_t size, const String& identifier) {
-  // Check if allocation would cause memory issues
-  MemoryInfo info = getMemoryInfo();
-  if (info.freeHeap < size + MIN_FREE_HEAP) {
-    Serial.printf("Allocation failed: insufficient memory (requested: %d, available: %d)\n", 
-                  size, info.freeHeap);
+void* MemoryManager::rawAllocate(size_t size) {
+  void* ptr = pool.allocate(size);
+  if (ptr != nullptr) {
+    return ptr;
+  }
+  
+  // Pool exhausted or request too large: check if allocation would cause memory issues
+  size_t heapFree = ESP.getFreeHeap();
+  if (heapFree < size + MIN_FREE_HEAP) {
+    VRAM_LOGW("mem", "Allocation failed: insufficient memory (requested: %d, available: %d)", 
+                     size, heapFree);
     return nullptr;
   }
   
-  void* ptr = malloc(size);
+  ptr = malloc(size);
+  if (ptr == nullptr) {
+    VRAM_LOGE("mem", "malloc failed for %d bytes", size);
+  }
+  return ptr;
+}
+
+void* MemoryManager::rawReallocate(void* ptr, size_t oldSize, size_t newSize) {
+  if (!pool.owns(ptr)) {
+    return realloc(ptr, newSize);
+  }
+  
+  // Pool blocks grow in place while they fit their size class;
+  // shrinking a page run releases its unused tail
+  if (newSize <= pool.usableSize(ptr)) {
+    pool.trim(ptr, newSize);
+    return ptr;
+  }
+  
+  void* newPtr = rawAllocate(newSize);
+  if (newPtr != nullptr) {
+    memcpy(newPtr, ptr, oldSize < newSize ? oldSize : newSize);
+    pool.release(ptr);
+  }
+  return newPtr;
+}
+
+void MemoryManager::rawFree(void* ptr) {
+  if (pool.owns(ptr)) {
+    pool.release(ptr);
+  } else {
+    free(ptr);
+  }
+}
+
+void MemoryManager::setPressureHandler(MemoryPressureHandler handler, void* context) {
+  VramLock guard(mutex);
+  pressureHandler = handler;
+  pressureContext = context;
+}
+
+void* MemoryManager::allocate(size_t size, const char* identifier, const char* file, int line) {
+  void* ptr = allocateTracked(size, identifier, file, line);
   if (ptr != nullptr) {
-    addBlock(ptr, size, identifier);
-    allocationCount++;
-    
-    // Update peak usage
-    if (totalAllocated > peakUsage) {
-      peakUsage = totalAllocated;
+    return ptr;
+  }
+  
+  // Unlocked: the handler evicts through the cache, which takes its own lock first
+  if (pressureHandler != nullptr && pressureHandler(size, pressureContext)) {
+    ptr = allocateTracked(size, identifier, file, line);
+  }
+  return ptr;
+}
+
+void* MemoryManager::allocateTracked(size_t size, const char* identifier, const char* file, int line) {
+  VramLock guard(mutex);
+  MemoryBlock* block = (MemoryBlock*)rawAllocate(sizeof(MemoryBlock) + size);
+  if (block == nullptr) {
+    failedAllocations++;
+    return nullptr;
+  }
+  
+  block->magic = BLOCK_MAGIC;
+  block->size = size;
+  block->allocTime = millis();
+  block->identifier = internIdentifier(identifier);
+  block->site = PROFILER_SITE_NONE;
+  identifiers[block->identifier].totalAllocations++;
+  linkBlock(block);
+  allocationCount++;
+  
+  if (profiling) {
+    identifiers[block->identifier].profiledAllocations++;
+    bytesUntilSample -= (long)size;
+    if (bytesUntilSample <= 0) {
+      sampleBlock(block, file, line);
+      nextSampleDistance();
     }
-    
-    Serial.printf("Allocated %d bytes for '%s' at %p\n", 
-                  size, identifier.c_str(), ptr);
-  } else {
-    Serial.printf("malloc failed for %d bytes\n", size);
   }
   
+  // Update peak usage
+  if (totalAllocated > peakUsage) {
+    peakUsage = totalAllocated;
+  }
+  
+  void* ptr = block + 1;
+  VRAM_LOGD("mem", "Allocated %d bytes for '%s' at %p", 
+                   size, identifiers[block->identifier].name, ptr);
   return ptr;
 }
 
-void* MemoryManager::reallocate(void* ptr, size_t newSize, const String& identifier) {
+void* MemoryManager::reallocate(void* ptr, size_t newSize, const char* identifier) {
   if (ptr == nullptr) {
     return allocate(newSize, identifier);
   }
   
-  MemoryBlock* block = findBlock(ptr);
+  VramLock guard(mutex);
+  MemoryBlock* block = headerFor(ptr);
   if (block == nullptr) {
-    Serial.println("realloc: pointer not found in tracking");
+    VRAM_LOGW("mem", "realloc: pointer not found in tracking");
     return nullptr;
   }
   
   size_t oldSize = block->size;
-  void* newPtr = realloc(ptr, newSize);
+  unlinkBlock(block);
   
-  if (newPtr != nullptr) {
-    // Update tracking
-    removeBlock(ptr);
-    addBlock(newPtr, newSize, identifier);
-    
-    Serial.printf("Reallocated from %d to %d bytes for '%s'\n", 
-                  oldSize, newSize, identifier.c_str());
+  MemoryBlock* moved = (MemoryBlock*)rawReallocate(block, sizeof(MemoryBlock) + oldSize,
+                                                   sizeof(MemoryBlock) + newSize);
+  if (moved == nullptr) {
+    // Original block is untouched on failure
+    linkBlock(block);
+    return nullptr;
   }
   
-  return newPtr;
+  // Update tracking; a sampled block stays with its site at its new weight
+  moved->size = newSize;
+  if (moved->site != PROFILER_SITE_NONE) {
+    AllocationSite& site = sites[moved->site];
+    site.liveEstimate = site.liveEstimate - sampleWeight(oldSize) + sampleWeight(newSize);
+  }
+  if (identifier != nullptr && identifier[0] != '\0') {
+    moved->identifier = internIdentifier(identifier);
+  }
+  linkBlock(moved);
+  
+  if (totalAllocated > peakUsage) {
+    peakUsage = totalAllocated;
+  }
+  
+  VRAM_LOGD("mem", "Reallocated from %d to %d bytes for '%s'", 
+                   oldSize, newSize, identifiers[moved->identifier].name);
+  return moved + 1;
+}
+
+void* MemoryManager::relocate(void* ptr) {
+  if (ptr == nullptr) return nullptr;
+  
+  VramLock guard(mutex);
+  MemoryBlock* block = headerFor(ptr);
+  if (block == nullptr) {
+    return nullptr;
+  }
+  
+  size_t total = sizeof(MemoryBlock) + block->size;
+  MemoryBlock* moved = (MemoryBlock*)pool.allocateCompacting(block, total);
+  if (moved == nullptr) {
+    return nullptr;
+  }
+  
+  // The header moves with the data and is relinked at its new address
+  unlinkBlock(block);
+  memcpy(moved, block, total);
+  block->magic = 0;
+  rawFree(block);
+  linkBlock(moved);
+  relocations++;
+  return moved + 1;
 }
 
 void MemoryManager::deallocate(void* ptr) {
   if (ptr == nullptr) return;
   
-  MemoryBlock* block = findBlock(ptr);
+  VramLock guard(mutex);
+  MemoryBlock* block = headerFor(ptr);
   if (block != nullptr) {
-    Serial.printf("Freed %d bytes for '%s'\n", 
-                  block->size, block->identifier.c_str());
-    removeBlock(ptr);
+    VRAM_LOGD("mem", "Freed %d bytes for '%s'", 
+                     block->size, identifiers[block->identifier].name);
+    unlinkBlock(block);
+    if (block->site != PROFILER_SITE_NONE) {
+      releaseSample(block);
+    }
+    block->magic = 0;
     freeCount++;
+    rawFree(block);
   } else {
-    Serial.println("Free: pointer not found in tracking");
+    VRAM_LOGW("mem", "Free: pointer not found in tracking");
+    rawFree(ptr);
   }
-  
-  free(ptr);
 }
 
-void MemoryManager::addBlock(void* ptr, size_t size, const String& identifier) {
-  MemoryBlock* block = new MemoryBlock();
-  block->ptr = ptr;
-  block->size = size;
-  block->allocTime = millis();
-  block->identifier = identifier;
+MemoryBlock* MemoryManager::headerFor(void* ptr) {
+  MemoryBlock* block = (MemoryBlock*)ptr - 1;
+  return block->magic == BLOCK_MAGIC ? block : nullptr;
+}
+
+void MemoryManager::linkBlock(MemoryBlock* block) {
+  block->prev = nullptr;
   block->next = allocatedBlocks;
-  
+  if (allocatedBlocks != nullptr) {
+    allocatedBlocks->prev = block;
+  }
   allocatedBlocks = block;
-  totalAllocated += size;
+  
+  IdentifierStats& stats = identifiers[block->identifier];
+  stats.liveBytes += block->size;
+  stats.liveBlocks++;
+  if (!pool.owns(block)) {
+    stats.heapBytes += block->size;
+  }
+  if (stats.liveBytes > stats.peakBytes) {
+    stats.peakBytes = stats.liveBytes;
+  }
+  totalAllocated += block->size;
 }
 
-void MemoryManager::removeBlock(void* ptr) {
-  MemoryBlock* current = allocatedBlocks;
-  MemoryBlock* previous = nullptr;
+void MemoryManager::unlinkBlock(MemoryBlock* block) {
+  if (block->prev != nullptr) {
+    block->prev->next = block->next;
+  } else {
+    allocatedBlocks = block->next;
+  }
+  if (block->next != nullptr) {
+    block->next->prev = block->prev;
+  }
   
-  while (current != nullptr) {
-    if (current->ptr == ptr) {
-      if (previous != nullptr) {
-        previous->next = current->next;
-      } else {
-        allocatedBlocks = current->next;
-      }
-      
-      totalAllocated -= current->size;
-      delete current;
-      return;
+  IdentifierStats& stats = identifiers[block->identifier];
+  stats.liveBytes -= block->size;
+  stats.liveBlocks--;
+  if (!pool.owns(block)) {
+    stats.heapBytes -= block->size;
+  }
+  totalAllocated -= block->size;
+}
+
+uint16_t MemoryManager::internIdentifier(const char* identifier) {
+  if (identifier == nullptr || identifier[0] == '\0') {
+    return 0;
+  }
+  
+  // 32-bit FNV-1a; names are only compared once the hash matches
+  uint32_t hash = 2166136261u;
+  for (const char* c = identifier; *c; c++) {
+    hash ^= (uint8_t)*c;
+    hash *= 16777619u;
+  }
+  
+  for (uint16_t i = 1; i < identifierCount; i++) {
+    if (identifiers[i].hash == hash &&
+        strncmp(identifiers[i].name, identifier, IDENTIFIER_LENGTH - 1) == 0) {
+      return i;
+    }
+  }
+  
+  if (identifierCount >= MAX_IDENTIFIERS) {
+    return 0;
+  }
+  
+  IdentifierStats& stats = identifiers[identifierCount];
+  strncpy(stats.name, identifier, IDENTIFIER_LENGTH - 1);
+  stats.name[IDENTIFIER_LENGTH - 1] = '\0';
+  stats.hash = hash;
+  return identifierCount++;
+}
+
+uint16_t MemoryManager::internSite(const char* file, int line, uint16_t identifier) {
+  if (file == nullptr) {
+    return 0;
+  }
+  
+  for (uint16_t i = 1; i < siteCount; i++) {
+    if (sites[i].line == line && (sites[i].file == file || strcmp(sites[i].file, file) == 0)) {
+      return i;
     }
+  }
+  
+  if (siteCount >= PROFILER_MAX_SITES) {
+    return 0;
+  }
+  
+  AllocationSite& site = sites[siteCount];
+  site.file = file;
+  site.line = line;
+  site.identifier = identifier;
+  return siteCount++;
+}
+
+void MemoryManager::sampleBlock(MemoryBlock* block, const char* file, int line) {
+  block->site = internSite(file, line, block->identifier);
+  AllocationSite& site = sites[block->site];
+  size_t weight = sampleWeight(block->size);
+  site.liveEstimate += weight;
+  site.allocatedEstimate += weight;
+  site.liveSamples++;
+  site.samples++;
+}
+
+void MemoryManager::releaseSample(MemoryBlock* block) {
+  static const unsigned long lifetimeBounds[PROFILER_LIFETIME_BUCKETS - 1] = {
+    10, 100, 1000, 10000, 60000, 600000, 3600000
+  };
+  
+  AllocationSite& site = sites[block->site];
+  site.liveEstimate -= sampleWeight(block->size);
+  site.liveSamples--;
+  
+  unsigned long age = millis() - block->allocTime;
+  int bucket = 0;
+  while (bucket < PROFILER_LIFETIME_BUCKETS - 1 && age >= lifetimeBounds[bucket]) {
+    bucket++;
+  }
+  identifiers[block->identifier].lifetimes[bucket]++;
+}
+
+void MemoryManager::nextSampleDistance() {
+  // Uniform over [sampleBytes/2, 3*sampleBytes/2): the mean stays sampleBytes,
+  // but allocations repeating in a fixed pattern are not sampled in lockstep
+  sampleSeed ^= sampleSeed << 13;
+  sampleSeed ^= sampleSeed >> 17;
+  sampleSeed ^= sampleSeed << 5;
+  long distance = (long)(sampleBytes / 2 + sampleSeed % sampleBytes);
+  
+  // The overshoot counts towards the next sample, or small blocks would be
+  // under-sampled; a block bigger than the distance already weighs its size
+  bytesUntilSample += distance;
+  if (bytesUntilSample <= 0) {
+    bytesUntilSample = distance;
+  }
+}
+
+void MemoryManager::enableProfiler(size_t sampleBytes) {
+  VramLock guard(mutex);
+  this->sampleBytes = sampleBytes > 0 ? sampleBytes : 1;
+  
+  for (uint16_t i = 0; i < identifierCount; i++) {
+    identifiers[i].peakBytes = identifiers[i].liveBytes;
+    identifiers[i].profiledAllocations = 0;
+    memset(identifiers[i].lifetimes, 0, sizeof(identifiers[i].lifetimes));
+  }
+  
+  // Blocks sampled before keep their sites, reweighed at the new rate
+  for (uint16_t i = 0; i < siteCount; i++) {
+    sites[i].liveEstimate = 0;
+    sites[i].allocatedEstimate = 0;
+    sites[i].liveSamples = 0;
+    sites[i].samples = 0;
+  }
+  for (MemoryBlock* block = allocatedBlocks; block != nullptr; block = block->next) {
+    if (block->site == PROFILER_SITE_NONE) continue;
+    sites[block->site].liveEstimate += sampleWeight(block->size);
+    sites[block->site].liveSamples++;
+  }
+  
+  while (sampleSeed == 0) {
+    sampleSeed = esp_random();
+  }
+  bytesUntilSample = 0;
+  nextSampleDistance();
+  profileStart = millis();
+  profiling = true;
+  VRAM_LOGI("mem", "Allocation profiler on, sampling every %d bytes", this->sampleBytes);
+}
+
+void MemoryManager::disableProfiler() {
+  VramLock guard(mutex);
+  profiling = false;
+  VRAM_LOGI("mem", "Allocation profiler off");
+}
+
+AllocationSite MemoryManager::getSite(uint16_t site) {
+  VramLock guard(mutex);
+  return sites[site];
+}
+
+const char* MemoryManager::siteFileName(const char* file) {
+  if (file == nullptr) return "(unknown)";
+  const char* name = strrchr(file, '/');
+  const char* windowsName = strrchr(file, '\\');
+  if (windowsName > name) name = windowsName;
+  return name != nullptr ? name + 1 : file;
+}
+
+void MemoryManager::appendProfileJson(String& out) {
+  VramLock guard(mutex);
+  char field[160];
+  snprintf(field, sizeof(field), "{\"sample_bytes\":%u,\"elapsed\":%lu,\"identifiers\":[",
+           sampleBytes, millis() - profileStart);
+  out += field;
+  
+  bool first = true;
+  for (uint16_t i = 0; i < identifierCount; i++) {
+    const IdentifierStats& stats = identifiers[i];
+    if (stats.liveBlocks == 0 && stats.profiledAllocations == 0) continue;
+    snprintf(field, sizeof(field), "%s{\"name\":\"%s\",\"live\":%u,\"blocks\":%u,\"heap\":%u,"
+             "\"peak\":%u,\"allocs\":%lu,\"lifetimes\":[",
+             first ? "" : ",", stats.name, stats.liveBytes, stats.liveBlocks, stats.heapBytes,
+             stats.peakBytes, stats.profiledAllocations);
+    out += field;
+    for (int b = 0; b < PROFILER_LIFETIME_BUCKETS; b++) {
+      snprintf(field, sizeof(field), b == 0 ? "%u" : ",%u", stats.lifetimes[b]);
+      out += field;
+    }
+    out += "]}";
+    first = false;
+  }
+  out += "],\"sites\":[";
+  
+  // Largest live estimates first; the rest are left out
+  bool reported[PROFILER_MAX_SITES] = {false};
+  for (int n = 0; n < PROFILER_REPORT_SITES; n++) {
+    int best = -1;
+    for (uint16_t i = 0; i < siteCount; i++) {
+      if (reported[i] || (sites[i].samples == 0 && sites[i].liveSamples == 0)) continue;
+      if (best < 0 || sites[i].liveEstimate > sites[best].liveEstimate) best = i;
+    }
+    if (best < 0) break;
+    reported[best] = true;
     
-    previous = current;
-    current = current->next;
+    const AllocationSite& site = sites[best];
+    snprintf(field, sizeof(field), "%s{\"file\":\"%s\",\"line\":%u,\"id\":\"%s\",\"live\":%u,"
+             "\"live_samples\":%u,\"allocated\":%llu,\"samples\":%u}",
+             n == 0 ? "" : ",", siteFileName(site.file), site.line, identifiers[site.identifier].name,
+             site.liveEstimate, site.liveSamples, (unsigned long long)site.allocatedEstimate, site.samples);
+    out += field;
   }
+  out += "]}";
 }
 
-MemoryBlock* MemoryManager::findBlock(void* ptr) {
-  MemoryBlock* current = allocatedBlocks;
-  while (current != nullptr) {
-    if (current->ptr == ptr) {
-      return current;
+void MemoryManager::printProfile() {
+  static const char* lifetimeNames[PROFILER_LIFETIME_BUCKETS] = {
+    "<10ms", "<100ms", "<1s", "<10s", "<1min", "<10min", "<1h", ">=1h"
+  };
+  
+  VramLock guard(mutex);
+  unsigned long elapsed = millis() - profileStart;
+  Serial.println("\n=== Allocation Profile ===");
+  Serial.printf("Sampling every %d bytes for %lus%s\n", sampleBytes, elapsed / 1000,
+                profiling ? "" : " (stopped)");
+  
+  for (uint16_t i = 0; i < identifierCount; i++) {
+    const IdentifierStats& stats = identifiers[i];
+    if (stats.liveBlocks == 0 && stats.profiledAllocations == 0) continue;
+    Serial.printf("%s: %d live (%d outside pool), peak %d, %.2f allocs/s\n", stats.name,
+                  stats.liveBytes, stats.heapBytes, stats.peakBytes,
+                  elapsed > 0 ? stats.profiledAllocations * 1000.0f / elapsed : 0.0f);
+    Serial.print("  lifetimes:");
+    for (int b = 0; b < PROFILER_LIFETIME_BUCKETS; b++) {
+      Serial.printf(" %s %u", lifetimeNames[b], stats.lifetimes[b]);
     }
-    current = current->next;
+    Serial.println();
   }
-  return nullptr;
+  
+  Serial.println("Sites (estimated):");
+  for (uint16_t i = 0; i < siteCount; i++) {
+    const AllocationSite& site = sites[i];
+    if (site.samples == 0 && site.liveSamples == 0) continue;
+    Serial.printf("%s:%u (%s): ~%d live bytes, ~%llu allocated, %u samples\n",
+                  siteFileName(site.file), site.line, identifiers[site.identifier].name,
+                  site.liveEstimate, (unsigned long long)site.allocatedEstimate, site.samples);
+  }
+  Serial.println("==========================");
 }
 
 MemoryInfo MemoryManager::getMemoryInfo() {
+  VramLock guard(mutex);
   MemoryInfo info;
   
-  info.freeHeap = ESP.getFreeHeap();
+  // Unused pool space is reserved for VRAM allocations, so count it as free
+  info.poolSize = pool.getCapacity();
+  info.poolFree = pool.getFree();
+  info.freeHeap = ESP.getFreeHeap() + info.poolFree;
   info.totalHeap = ESP.getHeapSize();
   info.usedHeap = info.totalHeap - info.freeHeap;
+  info.minFreeHeap = ESP.getMinFreeHeap();
   info.largestFreeBlock = ESP.getMaxAllocHeap();
+  if (pool.getLargestFreeRun() > info.largestFreeBlock) {
+    info.largestFreeBlock = pool.getLargestFreeRun();
+  }
   info.usagePercent = (info.usedHeap * 100) / info.totalHeap;
   
   // Calculate fragmentation
@@ -261,7 +1163,7 @@ bool MemoryManager::isMemoryCritical() {
 }
 
 void MemoryManager::forceGarbageCollection() {
-  Serial.println("Forcing garbage collection...");
+  VRAM_LOGI("mem", "Forcing garbage collection...");
   
   // On ESP32, we can't force GC directly, but we can encourage it
   // by temporarily allocating and freeing small blocks
@@ -273,7 +1175,7 @@ void MemoryManager::forceGarbageCollection() {
     delay(1);
   }
   
-  Serial.println("Garbage collection attempt completed");
+  VRAM_LOGI("mem", "Garbage collection attempt completed");
 }
 
 size_t MemoryManager::getFragmentation() {
@@ -282,6 +1184,7 @@ size_t MemoryManager::getFragmentation() {
 }
 
 void MemoryManager::printMemoryReport() {
+  VramLock guard(mutex);
   MemoryInfo info = getMemoryInfo();
   
   Serial.println("\n=== Memory Report ===");
@@ -289,11 +1192,24 @@ void MemoryManager::printMemoryReport() {
   Serial.printf("Free Heap: %d bytes\n", info.freeHeap);
   Serial.printf("Used Heap: %d bytes (%d%%)\n", info.usedHeap, info.usagePercent);
   Serial.printf("Largest Free Block: %d bytes\n", info.largestFreeBlock);
+  Serial.printf("Min Free Heap: %d bytes\n", info.minFreeHeap);
   Serial.printf("Fragmentation: %d%%\n", info.fragmentation);
   Serial.printf("Tracked Allocations: %d bytes\n", totalAllocated);
   Serial.printf("Peak Usage: %d bytes\n", peakUsage);
   Serial.printf("Allocation Count: %lu\n", allocationCount);
   Serial.printf("Free Count: %lu\n", freeCount);
+  Serial.printf("Failed Allocations: %lu\n", failedAllocations);
+  Serial.printf("Relocations: %lu\n", relocations);
+  
+  pool.printReport();
+  
+  Serial.println("\n=== Allocations by Identifier ===");
+  for (uint16_t i = 0; i < identifierCount; i++) {
+    if (identifiers[i].liveBlocks == 0 && identifiers[i].totalAllocations == 0) continue;
+    Serial.printf("%s: %d bytes in %lu blocks (%lu allocations)\n",
+                  identifiers[i].name, identifiers[i].liveBytes,
+                  (unsigned long)identifiers[i].liveBlocks, identifiers[i].totalAllocations);
+  }
   
   Serial.println("\n=== Tracked Blocks ===");
   MemoryBlock* current = allocatedBlocks;
@@ -301,22 +1217,29 @@ void MemoryManager::printMemoryReport() {
   while (current != nullptr) {
     blockCount++;
     Serial.printf("Block %d: %d bytes, '%s', age: %lums\n", 
-                  blockCount, current->size, current->identifier.c_str(),
+                  blockCount, current->size, identifiers[current->identifier].name,
                   millis() - current->allocTime);
     current = current->next;
   }
   Serial.println("=====================\n");
+  
+  if (profiling) {
+    printProfile();
+  }
 }
 
 void MemoryManager::resetStatistics() {
+  VramLock guard(mutex);
   allocationCount = 0;
   freeCount = 0;
+  failedAllocations = 0;
+  relocations = 0;
   peakUsage = totalAllocated;
-  Serial.println("Memory statistics reset");
+  VRAM_LOGI("mem", "Memory statistics reset");
 }
 
 void MemoryManager::emergencyCleanup() {
-  Serial.println("EMERGENCY: Critical memory condition!");
+  VRAM_LOGE("mem", "EMERGENCY: Critical memory condition!");
   
   // Force garbage collection
   forceGarbageCollection();
@@ -326,8 +1249,8 @@ void MemoryManager::emergencyCleanup() {
   
   // If still critical, we might need to restart
   if (isMemoryCritical()) {
-    Serial.println("CRITICAL: Memory still low after cleanup!");
-    Serial.println("System may need restart...");
+    VRAM_LOGE("mem", "CRITICAL: Memory still low after cleanup!");
+    VRAM_LOGE("mem", "System may need restart...");
   }
 }
 
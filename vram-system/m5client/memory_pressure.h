@@ -0,0 +1,217 @@
+/*
+ * Memory Pressure Controller for VRAM System
+ * Evicts cached resources only as far as memory usage requires
+ */
+
+#ifndef MEMORY_PRESSURE_H
+#define MEMORY_PRESSURE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "memory_manager.h"
+#include "resource_cache.h"
+#include "vram_log.h"
+
+// Pressure configuration
+#define PRESSURE_HIGH_WATERMARK   90            // Usage (%) that starts eviction
+#define PRESSURE_LOW_WATERMARK    80            // Usage (%) where eviction stops
+#define PRESSURE_STEP_BYTES       (8 * 1024)    // Evicted per step before usage is measured again
+#define PRESSURE_MAX_STEPS        32            // Bound on one relief run
+
+// Pressure statistics
+struct PressureStats {
+  unsigned long checks;
+  unsigned long reliefRuns;
+  unsigned long allocationFailures;   // Failed allocations handed to the controller
+  unsigned long evictedResources;
+  unsigned long compactions;
+  int lastUsagePercent;
+};
+
+// Between the watermarks nothing happens, so a short spike costs a few
+// evictions instead of the whole cache. Above the high watermark,
+// entries are evicted a step at a time, cheapest first, and usage is
+// measured again after each step: cache bytes and heap bytes do not
+// map one to one once the slab pool and PSRAM demotion are involved.
+// A failed MemoryManager allocation is handled at once, on the task
+// that made it, rather than at the next poll. Free space that is only
+// fragmented is recovered by compacting the cache, which costs no
+// refetches, before anything is evicted for it.
+class MemoryPressure {
+private:
+  MemoryManager& memory;
+  ResourceCache& cache;
+  int highWatermark;
+  int lowWatermark;
+  std::atomic<bool> relieving;        // One relief run at a time across tasks
+  
+  // Statistics; allocation failures arrive from any task
+  std::atomic<unsigned long> checks;
+  std::atomic<unsigned long> reliefRuns;
+  std::atomic<unsigned long> allocationFailures;
+  std::atomic<unsigned long> evictedResources;
+  std::atomic<unsigned long> compactions;
+  std::atomic<int> lastUsagePercent;
+  
+  size_t bytesOverLowWatermark();
+  bool compactFor(size_t size);
+  static bool onAllocationFailure(size_t size, void* context);
+
+public:
+  MemoryPressure(MemoryManager& memoryManager, ResourceCache& resourceCache);
+  
+  // Registers for allocation failures; call after memoryManager.begin()
+  void begin();
+  bool setWatermarks(int low, int high);
+  int getLowWatermark() { return lowWatermark; }
+  int getHighWatermark() { return highWatermark; }
+  
+  // Periodic check; compacts a fragmented pool and relieves pressure
+  // only above the high watermark. Returns the number of resources evicted.
+  int update();
+  
+  // Evicts until usage is back under the low watermark
+  int relieve();
+  
+  // Statistics
+  PressureStats getStats();
+  void printStats();
+};
+
+// Implementation
+MemoryPressure::MemoryPressure(MemoryManager& memoryManager, ResourceCache& resourceCache)
+  : memory(memoryManager), cache(resourceCache) {
+  highWatermark = PRESSURE_HIGH_WATERMARK;
+  lowWatermark = PRESSURE_LOW_WATERMARK;
+  relieving = false;
+  checks = 0;
+  reliefRuns = 0;
+  allocationFailures = 0;
+  evictedResources = 0;
+  compactions = 0;
+  lastUsagePercent = 0;
+}
+
+void MemoryPressure::begin() {
+  memory.setPressureHandler(onAllocationFailure, this);
+  VRAM_LOGI("pressure", "Memory pressure watermarks: %d%% / %d%%", lowWatermark, highWatermark);
+}
+
+bool MemoryPressure::setWatermarks(int low, int high) {
+  if (low <= 0 || high > 100 || low >= high) {
+    VRAM_LOGW("pressure", "Invalid watermarks %d%% / %d%%", low, high);
+    return false;
+  }
+  lowWatermark = low;
+  highWatermark = high;
+  return true;
+}
+
+size_t MemoryPressure::bytesOverLowWatermark() {
+  MemoryInfo info = memory.getMemoryInfo();
+  lastUsagePercent = info.usagePercent;
+  
+  size_t lowBytes = (info.totalHeap / 100) * lowWatermark;
+  return info.usedHeap > lowBytes ? info.usedHeap - lowBytes : 0;
+}
+
+int MemoryPressure::update() {
+  checks++;
+  if (cache.isFragmented()) {
+    compactFor(0);
+  }
+  
+  MemoryInfo info = memory.getMemoryInfo();
+  lastUsagePercent = info.usagePercent;
+  
+  if (info.usagePercent < highWatermark) {
+    return 0;
+  }
+  return relieve();
+}
+
+int MemoryPressure::relieve() {
+  bool expected = false;
+  if (!relieving.compare_exchange_strong(expected, true)) {
+    return 0;   // Another task is already on it
+  }
+  
+  int evicted = 0;
+  size_t excess = bytesOverLowWatermark();
+  int startUsage = lastUsagePercent.load();
+  
+  for (int step = 0; step < PRESSURE_MAX_STEPS && excess > 0; step++) {
+    int freed = cache.freeMemory(excess < PRESSURE_STEP_BYTES ? excess : PRESSURE_STEP_BYTES);
+    if (freed == 0) {
+      break;    // Nothing evictable left
+    }
+    evicted += freed;
+    excess = bytesOverLowWatermark();
+  }
+  
+  if (evicted > 0) {
+    reliefRuns++;
+    evictedResources += evicted;
+    VRAM_LOGI("pressure", "Memory %d%% -> %d%%, evicted %d resources",
+              startUsage, lastUsagePercent.load(), evicted);
+  }
+  
+  relieving = false;
+  return evicted;
+}
+
+bool MemoryPressure::compactFor(size_t size) {
+  SlabAllocator& pool = memory.getPool();
+  if (pool.getFree() < size) {
+    return false;
+  }
+  if (cache.compact() > 0) {
+    compactions++;
+  }
+  
+  // Tracked blocks carry a header in front of the data
+  return pool.getLargestFreeRun() >= size + sizeof(MemoryBlock);
+}
+
+bool MemoryPressure::onAllocationFailure(size_t size, void* context) {
+  MemoryPressure* self = static_cast<MemoryPressure*>(context);
+  self->allocationFailures++;
+  
+  // Enough free space, just not in one piece: moving payloads beats evicting them
+  if (self->cache.isFragmented() && self->compactFor(size)) {
+    VRAM_LOGD("pressure", "Allocation of %d bytes failed, pool compacted", size);
+    return true;
+  }
+  
+  // Room for this allocation first, then back under the low watermark
+  int freed = self->cache.freeMemory(size);
+  freed += self->relieve();
+  
+  VRAM_LOGD("pressure", "Allocation of %d bytes failed, evicted %d resources", size, freed);
+  return freed > 0;
+}
+
+PressureStats MemoryPressure::getStats() {
+  PressureStats snapshot;
+  snapshot.checks = checks.load();
+  snapshot.reliefRuns = reliefRuns.load();
+  snapshot.allocationFailures = allocationFailures.load();
+  snapshot.evictedResources = evictedResources.load();
+  snapshot.compactions = compactions.load();
+  snapshot.lastUsagePercent = lastUsagePercent.load();
+  return snapshot;
+}
+
+void MemoryPressure::printStats() {
+  PressureStats snapshot = getStats();
+  Serial.println("\n=== Memory Pressure ===");
+  Serial.printf("Watermarks: %d%% / %d%%\n", lowWatermark, highWatermark);
+  Serial.printf("Last Usage: %d%%\n", snapshot.lastUsagePercent);
+  Serial.printf("Checks: %lu, Relief Runs: %lu\n", snapshot.checks, snapshot.reliefRuns);
+  Serial.printf("Allocation Failures: %lu\n", snapshot.allocationFailures);
+  Serial.printf("Evicted Resources: %lu\n", snapshot.evictedResources);
+  Serial.printf("Compactions: %lu\n", snapshot.compactions);
+  Serial.println("=======================\n");
+}
+
+#endif // MEMORY_PRESSURE_H
\ No newline at end of file
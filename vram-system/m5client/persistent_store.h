@@ -0,0 +1,467 @@
+/*
+ * Persistent Store for VRAM System
+ * Append-only LittleFS log that keeps important resources across restarts
+ */
+
+#ifndef PERSISTENT_STORE_H
+#define PERSISTENT_STORE_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <atomic>
+#include "rom/crc.h"
+#include "vram_log.h"
+
+// Store configuration
+#define PERSIST_LOG_PATH        "/vram_cache.log"
+#define PERSIST_TMP_PATH        "/vram_cache.tmp"
+#define PERSIST_MAX_BYTES       (256 * 1024)   // Log size limit on flash
+#define PERSIST_MAX_ENTRIES     64
+#define PERSIST_ID_LENGTH       32             // Must match CACHE_ID_LENGTH
+#define PERSIST_ETAG_LENGTH     17             // Must match CACHE_ETAG_LENGTH
+#define PERSIST_RECORD_MAGIC    0x56524543u    // "VREC"
+#define PERSIST_TOMBSTONE       0xFFFFFFFFu    // Record length that marks an erase
+#define PERSIST_COPY_CHUNK      512
+
+// On-flash record header, followed by the ID and then the payload.
+// The CRC covers both, so a write cut short by a reset is detected.
+struct PersistRecordHeader {
+  uint32_t magic;
+  uint32_t length;           // Payload bytes, or PERSIST_TOMBSTONE
+  int32_t version;
+  uint32_t crc;
+  uint8_t priority;
+  uint8_t idLength;
+  char etag[PERSIST_ETAG_LENGTH - 1];   // Not NUL-terminated on flash
+};
+
+// Where the latest live copy of a resource sits in the log
+struct PersistEntry {
+  char resourceId[PERSIST_ID_LENGTH];
+  uint32_t hash;
+  uint32_t offset;           // Payload position in the log
+  uint32_t length;
+  uint32_t crc;
+  int version;
+  char etag[PERSIST_ETAG_LENGTH];
+  uint8_t priority;
+};
+
+// Writes only ever append; the newest record for an ID wins and a
+// tombstone hides older ones. begin() rebuilds the index from the log,
+// payloads are read back lazily on demand. When the log outgrows its
+// limit, or half of it is dead, live records are copied to a fresh file.
+// Not thread-safe: ResourceCache calls it under its lock.
+class PersistentStore {
+private:
+  PersistEntry entries[PERSIST_MAX_ENTRIES];
+  std::atomic<uint16_t> entryCount;   // Read without the lock to skip empty-store lookups
+  bool mounted;
+  size_t logSize;
+  size_t liveBytes;
+  
+  // Statistics
+  int loads;
+  int writes;
+  int compactions;
+  
+  static size_t recordSize(size_t idLength, size_t length) { return sizeof(PersistRecordHeader) + idLength + length; }
+  static uint32_t recordCrc(const char* resourceId, const uint8_t* data, size_t length);
+  bool scan();
+  bool compact();
+  void recover();
+  File openForAppend();
+  bool append(File& log, const PersistRecordHeader& header, const char* resourceId, const uint8_t* data);
+  void forget(PersistEntry* entry);
+  PersistEntry* claim(const char* resourceId, uint32_t hash);
+
+public:
+  PersistentStore();
+  
+  // Mounts LittleFS and indexes the log; false leaves persistence off
+  bool begin();
+  bool isEnabled() { return mounted; }
+  
+  // Appends a copy unless the newest record already holds exactly this
+  bool write(const char* resourceId, uint32_t hash, const char* data, size_t length,
+             int priority, int version, const char* etag);
+  bool erase(const char* resourceId, uint32_t hash);
+  
+  PersistEntry* find(const char* resourceId, uint32_t hash);
+  
+  // Reads a payload into buffer (length + 1 bytes, NUL-terminated) and checks its CRC
+  bool read(const PersistEntry* entry, char* buffer);
+  
+  // Information
+  int getEntryCount() { return entryCount.load(std::memory_order_relaxed); }
+  size_t getLogSize() { return logSize; }
+  void printStats();
+};
+
+// Implementation
+PersistentStore::PersistentStore() {
+  entryCount = 0;
+  mounted = false;
+  logSize = 0;
+  liveBytes = 0;
+  loads = 0;
+  writes = 0;
+  compactions = 0;
+}
+
+bool PersistentStore::begin() {
+  if (mounted) return true;
+  
+  // Format on first use; a board without a data partition just runs without persistence
+  if (!LittleFS.begin(true)) {
+    VRAM_LOGW("flash", "LittleFS mount failed, persistence disabled");
+    return false;
+  }
+  mounted = true;
+  
+  if (!scan()) {
+    VRAM_LOGW("flash", "Persistent log damaged, keeping %d intact records", getEntryCount());
+    compact();
+  } else if (logSize > 2 * liveBytes + PERSIST_MAX_BYTES / 4) {
+    compact();
+  }
+  
+  VRAM_LOGI("flash", "Persistent store: %d resources, %d bytes of log", getEntryCount(), logSize);
+  return true;
+}
+
+uint32_t PersistentStore::recordCrc(const char* resourceId, const uint8_t* data, size_t length) {
+  uint32_t crc = crc32_le(0, (const uint8_t*)resourceId, strlen(resourceId));
+  return crc32_le(crc, data, length);
+}
+
+bool PersistentStore::scan() {
+  entryCount = 0;
+  logSize = 0;
+  liveBytes = 0;
+  
+  File log = LittleFS.open(PERSIST_LOG_PATH, "r");
+  if (!log) {
+    return true;  // Nothing persisted yet
+  }
+  
+  size_t fileSize = log.size();
+  size_t position = 0;
+  bool intact = true;
+  uint8_t chunk[PERSIST_COPY_CHUNK];
+  
+  while (position < fileSize) {
+    PersistRecordHeader header;
+    char id[PERSIST_ID_LENGTH];
+    if (fileSize - position < sizeof(header) ||
+        log.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+        header.magic != PERSIST_RECORD_MAGIC || header.idLength == 0 || header.idLength >= PERSIST_ID_LENGTH ||
+        log.read((uint8_t*)id, header.idLength) != header.idLength) {
+      intact = false;
+      break;
+    }
+    id[header.idLength] = '\0';
+    
+    // Only a whole record with a matching CRC counts
+    size_t length = (header.length == PERSIST_TOMBSTONE) ? 0 : header.length;
+    size_t payloadOffset = position + sizeof(header) + header.idLength;
+    if (payloadOffset + length > fileSize) {
+      intact = false;
+      break;
+    }
+    uint32_t crc = crc32_le(0, (const uint8_t*)id, header.idLength);
+    for (size_t done = 0; done < length; ) {
+      size_t part = length - done < sizeof(chunk) ? length - done : sizeof(chunk);
+      if (log.read(chunk, part) != part) break;
+      crc = crc32_le(crc, chunk, part);
+      done += part;
+    }
+    if (header.length != PERSIST_TOMBSTONE && crc != header.crc) {
+      intact = false;
+      break;
+    }
+    
+    uint32_t hash = 2166136261u;   // FNV-1a, as ResourceCache::hashKey()
+    for (uint8_t i = 0; i < header.idLength; i++) {
+      hash = (hash ^ (uint8_t)id[i]) * 16777619u;
+    }
+    
+    PersistEntry* entry = find(id, hash);
+    if (header.length == PERSIST_TOMBSTONE) {
+      if (entry != nullptr) forget(entry);
+    } else {
+      if (entry == nullptr) entry = claim(id, hash);
+      else liveBytes -= recordSize(strlen(entry->resourceId), entry->length);
+      if (entry != nullptr) {
+        entry->offset = payloadOffset;
+        entry->length = header.length;
+        entry->crc = header.crc;
+        entry->version = header.version;
+        memcpy(entry->etag, header.etag, PERSIST_ETAG_LENGTH - 1);
+        entry->etag[PERSIST_ETAG_LENGTH - 1] = '\0';
+        entry->priority = header.priority;
+        liveBytes += recordSize(header.idLength, header.length);
+      }
+    }
+    
+    position = payloadOffset + length;
+    logSize = position;
+  }
+  
+  log.close();
+  return intact;
+}
+
+void PersistentStore::recover() {
+  // A partial record would hide everything appended after it on the next boot
+  if (!scan()) {
+    compact();
+  }
+}
+
+File PersistentStore::openForAppend() {
+  // Bytes past the last good record (a failed write) must go before anything is added
+  File log = LittleFS.open(PERSIST_LOG_PATH, "a");
+  if (log && log.size() != logSize) {
+    log.close();
+    if (!compact()) {
+      return File();
+    }
+    log = LittleFS.open(PERSIST_LOG_PATH, "a");
+  }
+  return log;
+}
+
+PersistEntry* PersistentStore::find(const char* resourceId, uint32_t hash) {
+  uint16_t count = entryCount.load(std::memory_order_relaxed);
+  for (uint16_t i = 0; i < count; i++) {
+    if (entries[i].hash == hash && strncmp(entries[i].resourceId, resourceId, PERSIST_ID_LENGTH) == 0) {
+      return &entries[i];
+    }
+  }
+  return nullptr;
+}
+
+PersistEntry* PersistentStore::claim(const char* resourceId, uint32_t hash) {
+  uint16_t count = entryCount.load(std::memory_order_relaxed);
+  if (count >= PERSIST_MAX_ENTRIES) {
+    return nullptr;
+  }
+  PersistEntry* entry = &entries[count];
+  strncpy(entry->resourceId, resourceId, PERSIST_ID_LENGTH - 1);
+  entry->resourceId[PERSIST_ID_LENGTH - 1] = '\0';
+  entry->hash = hash;
+  entryCount = count + 1;
+  return entry;
+}
+
+void PersistentStore::forget(PersistEntry* entry) {
+  // Keep the table dense: the last entry fills the hole
+  liveBytes -= recordSize(strlen(entry->resourceId), entry->length);
+  uint16_t last = entryCount.load(std::memory_order_relaxed) - 1;
+  if (entry != &entries[last]) {
+    *entry = entries[last];
+  }
+  entryCount = last;
+}
+
+bool PersistentStore::append(File& log, const PersistRecordHeader& header, const char* resourceId,
+                             const uint8_t* data) {
+  // Without data only the header and ID are written; compact() streams the payload itself
+  size_t length = (header.length == PERSIST_TOMBSTONE || data == nullptr) ? 0 : header.length;
+  return log.write((const uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+         log.write((const uint8_t*)resourceId, header.idLength) == header.idLength &&
+         (length == 0 || log.write(data, length) == length);
+}
+
+bool PersistentStore::write(const char* resourceId, uint32_t hash, const char* data, size_t length,
+                            int priority, int version, const char* etag) {
+  if (!mounted) {
+    return false;
+  }
+  
+  // Flash wears out: an unchanged resource is not written again
+  uint32_t crc = recordCrc(resourceId, (const uint8_t*)data, length);
+  PersistEntry* entry = find(resourceId, hash);
+  if (entry != nullptr && entry->crc == crc && entry->length == length && entry->version == version &&
+      entry->priority == priority && strncmp(entry->etag, etag, PERSIST_ETAG_LENGTH - 1) == 0) {
+    return true;
+  }
+  if (entry == nullptr && getEntryCount() >= PERSIST_MAX_ENTRIES) {
+    VRAM_LOGW("flash", "Persistent store full (%d entries), %s not saved", PERSIST_MAX_ENTRIES, resourceId);
+    return false;
+  }
+  
+  size_t idLength = strlen(resourceId);
+  size_t needed = recordSize(idLength, length);
+  if (logSize + needed > PERSIST_MAX_BYTES && (!compact() || logSize + needed > PERSIST_MAX_BYTES)) {
+    VRAM_LOGW("flash", "Persistent log full, %s not saved (%d bytes)", resourceId, length);
+    return false;
+  }
+  
+  PersistRecordHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = PERSIST_RECORD_MAGIC;
+  header.length = length;
+  header.version = version;
+  header.crc = crc;
+  header.priority = priority;
+  header.idLength = idLength;
+  strncpy(header.etag, etag, sizeof(header.etag));
+  
+  File log = openForAppend();
+  bool written = log && append(log, header, resourceId, (const uint8_t*)data);
+  if (log) log.close();
+  if (!written) {
+    VRAM_LOGW("flash", "Cannot append %s to the persistent log", resourceId);
+    recover();
+    return false;
+  }
+  
+  // Look it up again: compact() may have updated the entry
+  entry = find(resourceId, hash);
+  if (entry == nullptr) {
+    entry = claim(resourceId, hash);
+  } else {
+    liveBytes -= recordSize(idLength, entry->length);
+  }
+  entry->offset = logSize + sizeof(header) + idLength;
+  entry->length = length;
+  entry->crc = crc;
+  entry->version = version;
+  strncpy(entry->etag, etag, PERSIST_ETAG_LENGTH - 1);
+  entry->etag[PERSIST_ETAG_LENGTH - 1] = '\0';
+  entry->priority = priority;
+  logSize += needed;
+  liveBytes += needed;
+  writes++;
+  
+  VRAM_LOGD("flash", "Persisted %s (%d bytes, version %d)", resourceId, length, version);
+  return true;
+}
+
+bool PersistentStore::erase(const char* resourceId, uint32_t hash) {
+  PersistEntry* entry = find(resourceId, hash);
+  if (!mounted || entry == nullptr) {
+    return false;
+  }
+  
+  PersistRecordHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = PERSIST_RECORD_MAGIC;
+  header.length = PERSIST_TOMBSTONE;
+  header.idLength = strlen(resourceId);
+  
+  // A full log is compacted without the entry instead of growing
+  forget(entry);
+  if (logSize + recordSize(header.idLength, 0) > PERSIST_MAX_BYTES) {
+    return compact();
+  }
+  
+  File log = openForAppend();
+  bool written = log && append(log, header, resourceId, nullptr);
+  if (log) log.close();
+  if (!written) {
+    recover();
+    return false;
+  }
+  logSize += recordSize(header.idLength, 0);
+  return true;
+}
+
+bool PersistentStore::read(const PersistEntry* entry, char* buffer) {
+  File log = LittleFS.open(PERSIST_LOG_PATH, "r");
+  if (!log) {
+    return false;
+  }
+  
+  bool ok = log.seek(entry->offset) && log.read((uint8_t*)buffer, entry->length) == entry->length;
+  log.close();
+  buffer[entry->length] = '\0';
+  
+  if (!ok || recordCrc(entry->resourceId, (const uint8_t*)buffer, entry->length) != entry->crc) {
+    VRAM_LOGW("flash", "Persisted copy of %s is unreadable", entry->resourceId);
+    return false;
+  }
+  loads++;
+  return true;
+}
+
+bool PersistentStore::compact() {
+  File source = LittleFS.open(PERSIST_LOG_PATH, "r");
+  File target = LittleFS.open(PERSIST_TMP_PATH, "w");
+  if (!target) {
+    if (source) source.close();
+    VRAM_LOGW("flash", "Cannot create %s for compaction", PERSIST_TMP_PATH);
+    return false;
+  }
+  
+  // Copy live payloads chunk by chunk. Any record that cannot be copied
+  // abandons the compaction, leaving the old log and every offset as they were
+  uint8_t chunk[PERSIST_COPY_CHUNK];
+  uint32_t offsets[PERSIST_MAX_ENTRIES];   // Positions in the new log, applied once it replaces the old
+  size_t position = 0;
+  uint16_t i = 0;
+  while (i < getEntryCount()) {
+    PersistEntry* entry = &entries[i];
+    PersistRecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = PERSIST_RECORD_MAGIC;
+    header.length = entry->length;
+    header.version = entry->version;
+    header.crc = entry->crc;
+    header.priority = entry->priority;
+    header.idLength = strlen(entry->resourceId);
+    strncpy(header.etag, entry->etag, sizeof(header.etag));
+    
+    bool copied = source && source.seek(entry->offset) && append(target, header, entry->resourceId, nullptr);
+    for (size_t done = 0; copied && done < entry->length; ) {
+      size_t part = entry->length - done < sizeof(chunk) ? entry->length - done : sizeof(chunk);
+      copied = source.read(chunk, part) == part && target.write(chunk, part) == part;
+      done += part;
+    }
+    if (!copied) {
+      target.close();
+      if (source) source.close();
+      LittleFS.remove(PERSIST_TMP_PATH);
+      VRAM_LOGW("flash", "Compaction failed at %s", entry->resourceId);
+      return false;
+    }
+    
+    offsets[i] = position + sizeof(header) + header.idLength;
+    position += recordSize(header.idLength, entry->length);
+    i++;
+  }
+  
+  target.close();
+  if (source) source.close();
+  LittleFS.remove(PERSIST_LOG_PATH);
+  if (!LittleFS.rename(PERSIST_TMP_PATH, PERSIST_LOG_PATH)) {
+    VRAM_LOGE("flash", "Cannot replace the persistent log");
+    entryCount = 0;
+    liveBytes = 0;
+    logSize = 0;
+    return false;
+  }
+  
+  for (uint16_t j = 0; j < getEntryCount(); j++) {
+    entries[j].offset = offsets[j];
+  }
+  logSize = position;
+  liveBytes = position;
+  compactions++;
+  VRAM_LOGI("flash", "Persistent log compacted to %d bytes", logSize);
+  return true;
+}
+
+void PersistentStore::printStats() {
+  if (!mounted) {
+    Serial.println("Flash Store: disabled");
+    return;
+  }
+  Serial.printf("Flash Store: %d entries, %d live / %d log bytes (max %d)\n",
+                getEntryCount(), liveBytes, logSize, PERSIST_MAX_BYTES);
+  Serial.printf("Flash Loads: %d, Writes: %d, Compactions: %d\n", loads, writes, compactions);
+}
+
+#endif // PERSISTENT_STORE_H
\ No newline at end of file
@@ -0,0 +1,336 @@
+/*
+ * PSRAM Tier for VRAM System
+ * Slower second cache level that keeps evicted resources off the network
+ */
+
+#ifndef PSRAM_TIER_H
+#define PSRAM_TIER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <esp_heap_caps.h>
+#include "vram_log.h"
+
+// Tier configuration
+#define PSRAM_TIER_SIZE         (1024 * 1024)  // Budget when that much PSRAM is free
+#define PSRAM_TIER_MIN_SIZE     (64 * 1024)    // Below this the tier stays disabled
+#define PSRAM_TIER_AVERAGE_SIZE 1024           // Sizes the entry table from the budget
+#define PSRAM_TIER_ID_LENGTH    32             // Must match CACHE_ID_LENGTH
+#define PSRAM_TIER_ETAG_LENGTH  17             // Must match CACHE_ETAG_LENGTH
+#define PSRAM_TIER_CAPS         (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#define TIER_NO_ENTRY           0xFFFF
+
+// A resource demoted from the internal-RAM cache, with what revalidation needs
+struct TierEntry {
+  char resourceId[PSRAM_TIER_ID_LENGTH];
+  char* data;                // PSRAM buffer, NUL-terminated; nullptr when the slot is free
+  size_t dataLength;
+  int priority;
+  int version;
+  char etag[PSRAM_TIER_ETAG_LENGTH];
+  uint16_t prev;
+  uint16_t next;
+};
+
+// Demoted resources live here until promoted back or dropped for room.
+// The entry table, key hashes and payloads are all allocated in PSRAM, so
+// the tier costs no internal heap. It is only consulted after an
+// internal-RAM miss, so lookups scan the hash array instead of keeping a
+// second index. Not thread-safe: ResourceCache calls it under its lock.
+class PsramTier {
+private:
+  TierEntry* entries;
+  uint32_t* hashes;
+  uint16_t capacity;
+  uint16_t head;             // Most recently demoted
+  uint16_t tail;
+  std::atomic<uint16_t> entryCount;   // Read without the lock to skip empty-tier lookups
+  size_t usedBytes;
+  size_t budget;
+  
+  // Statistics; lookups are counted without the lock
+  std::atomic<int> hits;
+  std::atomic<int> misses;
+  int demotions;
+  int drops;
+  
+  uint16_t freeSlot();
+  void unlink(uint16_t slot);
+  void discard(uint16_t slot);
+  bool makeRoom(size_t bytes);
+  bool isFull(size_t bytes) { return usedBytes + bytes > budget || entryCount.load(std::memory_order_relaxed) >= capacity; }
+
+public:
+  PsramTier();
+  ~PsramTier();
+  
+  // Claims the entry table; false (tier disabled) without enough PSRAM
+  bool begin(size_t maxBytes = PSRAM_TIER_SIZE);
+  bool isEnabled() { return entries != nullptr; }
+  
+  // Copies a payload in, dropping the oldest lower-priority entries for room
+  bool demote(const char* resourceId, uint32_t hash, const char* data, size_t length,
+              int priority, int version, const char* etag);
+  
+  // Takes ownership of a PSRAM buffer already holding the payload
+  bool adopt(const char* resourceId, uint32_t hash, char* data, size_t length,
+             int priority, int version, const char* etag);
+  
+  // Lookup by key; the entry stays valid until the next tier change
+  TierEntry* find(const char* resourceId, uint32_t hash);
+  
+  // Removes an entry and hands its PSRAM buffer to the caller (free with releaseBuffer)
+  char* detach(TierEntry* entry);
+  static void releaseBuffer(char* data) { heap_caps_free(data); }
+  
+  bool remove(const char* resourceId, uint32_t hash);
+  void clear();
+  
+  // Lookups that ended in a promotion or missed both levels
+  void recordHit() { hits++; }
+  void recordMiss() { misses++; }
+  
+  // Information
+  int getEntryCount() { return entryCount.load(std::memory_order_relaxed); }
+  size_t getUsedBytes() { return usedBytes; }
+  size_t getBudget() { return budget; }
+  int getHits() { return hits.load(); }
+  int getMisses() { return misses.load(); }
+  void resetStats();
+  void printStats();
+};
+
+// Implementation
+PsramTier::PsramTier() {
+  entries = nullptr;
+  hashes = nullptr;
+  capacity = 0;
+  head = TIER_NO_ENTRY;
+  tail = TIER_NO_ENTRY;
+  entryCount = 0;
+  usedBytes = 0;
+  budget = 0;
+  resetStats();
+}
+
+PsramTier::~PsramTier() {
+  clear();
+  if (entries != nullptr) heap_caps_free(entries);
+  if (hashes != nullptr) heap_caps_free(hashes);
+}
+
+bool PsramTier::begin(size_t maxBytes) {
+  if (entries != nullptr) return true;
+  
+  if (!psramFound()) {
+    VRAM_LOGW("psram", "No PSRAM found, evicted resources will be dropped");
+    return false;
+  }
+  
+  // Leave half of what is free for everybody else
+  size_t available = heap_caps_get_free_size(PSRAM_TIER_CAPS) / 2;
+  budget = maxBytes < available ? maxBytes : available;
+  if (budget < PSRAM_TIER_MIN_SIZE) {
+    VRAM_LOGW("psram", "Only %d bytes of PSRAM available, tier disabled", available);
+    budget = 0;
+    return false;
+  }
+  
+  size_t slots = budget / PSRAM_TIER_AVERAGE_SIZE;
+  capacity = slots < TIER_NO_ENTRY ? slots : TIER_NO_ENTRY - 1;
+  entries = (TierEntry*)heap_caps_malloc(capacity * sizeof(TierEntry), PSRAM_TIER_CAPS);
+  hashes = (uint32_t*)heap_caps_malloc(capacity * sizeof(uint32_t), PSRAM_TIER_CAPS);
+  if (entries == nullptr || hashes == nullptr) {
+    VRAM_LOGE("psram", "Cannot allocate tier table (%d entries)", capacity);
+    if (entries != nullptr) heap_caps_free(entries);
+    if (hashes != nullptr) heap_caps_free(hashes);
+    entries = nullptr;
+    hashes = nullptr;
+    capacity = 0;
+    budget = 0;
+    return false;
+  }
+  
+  for (uint16_t i = 0; i < capacity; i++) {
+    entries[i].data = nullptr;
+    hashes[i] = 0;
+  }
+  
+  VRAM_LOGI("psram", "PSRAM tier ready: %d bytes, %d entries", budget, capacity);
+  return true;
+}
+
+TierEntry* PsramTier::find(const char* resourceId, uint32_t hash) {
+  if (entries == nullptr || entryCount.load(std::memory_order_relaxed) == 0) {
+    return nullptr;
+  }
+  
+  for (uint16_t i = 0; i < capacity; i++) {
+    if (hashes[i] == hash && entries[i].data != nullptr &&
+        strncmp(entries[i].resourceId, resourceId, PSRAM_TIER_ID_LENGTH) == 0) {
+      return &entries[i];
+    }
+  }
+  return nullptr;
+}
+
+bool PsramTier::demote(const char* resourceId, uint32_t hash, const char* data, size_t length,
+                       int priority, int version, const char* etag) {
+  if (entries == nullptr || length + 1 > budget) {
+    return false;
+  }
+  
+  // Room first, so the copy does not compete with entries about to be dropped
+  remove(resourceId, hash);
+  if (!makeRoom(length + 1)) {
+    return false;
+  }
+  
+  char* copy = (char*)heap_caps_malloc(length + 1, PSRAM_TIER_CAPS);
+  if (copy == nullptr) {
+    VRAM_LOGW("psram", "PSRAM allocation failed for %s (%d bytes)", resourceId, length);
+    return false;
+  }
+  memcpy(copy, data, length);
+  copy[length] = '\0';
+  
+  if (!adopt(resourceId, hash, copy, length, priority, version, etag)) {
+    heap_caps_free(copy);
+    return false;
+  }
+  demotions++;
+  VRAM_LOGD("psram", "Demoted %s to PSRAM (%d bytes)", resourceId, length);
+  return true;
+}
+
+bool PsramTier::adopt(const char* resourceId, uint32_t hash, char* data, size_t length,
+                      int priority, int version, const char* etag) {
+  if (entries == nullptr || !makeRoom(length + 1)) {
+    return false;
+  }
+  
+  uint16_t slot = freeSlot();
+  if (slot == TIER_NO_ENTRY) {
+    return false;
+  }
+  
+  TierEntry* entry = &entries[slot];
+  strncpy(entry->resourceId, resourceId, PSRAM_TIER_ID_LENGTH - 1);
+  entry->resourceId[PSRAM_TIER_ID_LENGTH - 1] = '\0';
+  entry->data = data;
+  entry->dataLength = length;
+  entry->priority = priority;
+  entry->version = version;
+  strncpy(entry->etag, etag != nullptr ? etag : "", PSRAM_TIER_ETAG_LENGTH - 1);
+  entry->etag[PSRAM_TIER_ETAG_LENGTH - 1] = '\0';
+  hashes[slot] = hash;
+  
+  // Newest at the head
+  entry->prev = TIER_NO_ENTRY;
+  entry->next = head;
+  if (head != TIER_NO_ENTRY) entries[head].prev = slot;
+  head = slot;
+  if (tail == TIER_NO_ENTRY) tail = slot;
+  
+  usedBytes += length + 1;
+  entryCount++;
+  return true;
+}
+
+char* PsramTier::detach(TierEntry* entry) {
+  uint16_t slot = entry - entries;
+  char* data = entry->data;
+  usedBytes -= entry->dataLength + 1;
+  unlink(slot);
+  return data;
+}
+
+bool PsramTier::remove(const char* resourceId, uint32_t hash) {
+  TierEntry* entry = find(resourceId, hash);
+  if (entry == nullptr) {
+    return false;
+  }
+  heap_caps_free(detach(entry));
+  return true;
+}
+
+void PsramTier::clear() {
+  while (tail != TIER_NO_ENTRY) {
+    heap_caps_free(detach(&entries[tail]));
+  }
+}
+
+uint16_t PsramTier::freeSlot() {
+  for (uint16_t i = 0; i < capacity; i++) {
+    if (entries[i].data == nullptr) return i;
+  }
+  return TIER_NO_ENTRY;
+}
+
+void PsramTier::unlink(uint16_t slot) {
+  TierEntry* entry = &entries[slot];
+  if (entry->prev != TIER_NO_ENTRY) {
+    entries[entry->prev].next = entry->next;
+  } else {
+    head = entry->next;
+  }
+  if (entry->next != TIER_NO_ENTRY) {
+    entries[entry->next].prev = entry->prev;
+  } else {
+    tail = entry->prev;
+  }
+  
+  entry->data = nullptr;
+  entry->dataLength = 0;
+  hashes[slot] = 0;
+  entryCount--;
+}
+
+void PsramTier::discard(uint16_t slot) {
+  VRAM_LOGD("psram", "Dropping %s from PSRAM", entries[slot].resourceId);
+  heap_caps_free(detach(&entries[slot]));
+  drops++;
+}
+
+bool PsramTier::makeRoom(size_t bytes) {
+  if (bytes > budget) {
+    return false;
+  }
+  
+  // Lowest priority first (4 is PRIORITY_LOW), oldest first within a priority
+  for (int priority = 4; priority >= 1 && isFull(bytes); priority--) {
+    uint16_t current = tail;
+    while (current != TIER_NO_ENTRY && isFull(bytes)) {
+      uint16_t prev = entries[current].prev;
+      if (entries[current].priority >= priority) {
+        discard(current);
+      }
+      current = prev;
+    }
+  }
+  return !isFull(bytes);
+}
+
+void PsramTier::resetStats() {
+  hits = 0;
+  misses = 0;
+  demotions = 0;
+  drops = 0;
+}
+
+void PsramTier::printStats() {
+  if (entries == nullptr) {
+    Serial.println("PSRAM Tier: disabled");
+    return;
+  }
+  
+  int hitCount = hits.load();
+  int lookups = hitCount + misses.load();
+  Serial.printf("PSRAM Tier: %d entries, %d / %d bytes\n",
+                entryCount.load(), usedBytes, budget);
+  Serial.printf("PSRAM Hits: %d, Misses: %d (%.1f%%)\n",
+                hitCount, misses.load(), lookups > 0 ? (float)hitCount * 100 / lookups : 0.0f);
+  Serial.printf("PSRAM Demotions: %d, Drops: %d\n", demotions, drops);
+}
+
+#endif // PSRAM_TIER_H
\ No newline at end of file
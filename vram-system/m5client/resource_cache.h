@@ -7,8 +7,13 @@
 #define RESOURCE_CACHE_H
 
 #include <Arduino.h>
-#include <map>
+#include <atomic>
 #include <vector>
+#include "memory_manager.h"
+#include "eviction_policy.h"
+#include "psram_tier.h"
+#include "persistent_store.h"
+#include "vram_log.h"
 
 // Priority levels
 #define PRIORITY_CRITICAL   1
@@ -20,44 +25,168 @@
 #define MAX_CACHE_SIZE      (256 * 1024)  // 256KB cache limit
 #define MAX_RESOURCE_SIZE   (64 * 1024)   // 64KB per resource limit
 #define CACHE_ENTRY_OVERHEAD 64           // Estimated overhead per entry
+#define CACHE_ID_LENGTH     32            // Resource IDs are stored inline, NUL included; the server refuses longer
+#define CACHE_ETAG_LENGTH   17            // Content hash prefix kept as the ETag, NUL included
+
+// Index configuration (both must stay powers of two)
+#define CACHE_MAX_ENTRIES   (MAX_CACHE_SIZE / 1024)   // Node table size, ~1KB average resource
+#define CACHE_INDEX_SLOTS   (CACHE_MAX_ENTRIES * 2)   // Keeps the load factor at or below 0.5
+#define CACHE_NO_NODE       0xFFFF
+#define CACHE_READ_RETRIES  4                         // Optimistic lookups before a reader takes the lock
+
+// Eviction configuration
+#define CACHE_TIER_SPECULATIVE  (PRIORITY_LOW + 1)    // Unread prefetches, below every priority
+#define CACHE_HOT_FREQUENCY     4                     // freeMemory() spares entries above this on its first pass
+#define CACHE_ANY_FREQUENCY     0xFF
+
+// Compaction configuration
+#define CACHE_COMPACT_THRESHOLD 30                    // Pool fragmentation (%) worth a compaction pass
+
+// Resources at this priority or more important are kept on flash once persistence is enabled
+#define CACHE_PERSIST_PRIORITY  PRIORITY_IMPORTANT
+
+static_assert(PSRAM_TIER_ID_LENGTH == CACHE_ID_LENGTH && PSRAM_TIER_ETAG_LENGTH == CACHE_ETAG_LENGTH,
+              "PSRAM tier entries must hold cache IDs and ETags");
+static_assert(PERSIST_ID_LENGTH == CACHE_ID_LENGTH && PERSIST_ETAG_LENGTH == CACHE_ETAG_LENGTH,
+              "Persistent entries must hold cache IDs and ETags");
 
 // Cache entry structure
 struct CacheEntry {
-  String resourceId;
-  String data;
+  char resourceId[CACHE_ID_LENGTH];
+  char* data;                // Payload buffer from the VRAM slab pool; moves during compact()
+  size_t dataLength;
+  uint32_t keyHash;
   int priority;
   size_t size;
-  unsigned long accessTime;
+  std::atomic<unsigned long> accessTime;   // Access fields are updated by lock-free readers
   unsigned long createTime;
-  int accessCount;
-  CacheEntry* prev;
-  CacheEntry* next;
+  std::atomic<int> accessCount;
+  std::atomic<bool> referenced;   // CLOCK bit: set on hit, cleared when eviction passes over it
+  std::atomic<bool> speculative;  // Prefetched on a hint and not read since; evicted first
+  int version;               // Server version, 0 when unknown
+  char etag[CACHE_ETAG_LENGTH];  // Server content hash prefix, empty when unknown
+  std::atomic<uint32_t> pinCount;  // Outstanding ResourceViews; pinned entries are never evicted
+  uint16_t prev;
+  uint16_t next;
+};
+
+// Open-addressing index slot: precomputed key hash plus LRU node index
+struct CacheIndexSlot {
+  uint32_t hash;
+  uint16_t node;
+};
+
+// Writable payload buffer handed out by ResourceCache::reserve()
+struct CacheReservation {
+  char* buffer;              // capacity + 1 bytes, room for the terminator
+  size_t capacity;
+  size_t accounted;          // Counted in the cache size until commit/abort
+};
+
+class ResourceCache;
+
+// Borrowed, read-only access to a cached payload without copying it.
+// The entry stays pinned in the cache until the view is released or
+// destroyed. Views must not outlive the cache or a call to clear().
+class ResourceView {
+private:
+  ResourceCache* cache;
+  uint16_t node;
+  const char* payload;
+  size_t payloadLength;
+  
+  ResourceView(ResourceCache* owner, uint16_t pinnedNode, const char* data, size_t length)
+    : cache(owner), node(pinnedNode), payload(data), payloadLength(length) {}
+  
+  friend class ResourceCache;
+
+public:
+  ResourceView() : cache(nullptr), node(0), payload(nullptr), payloadLength(0) {}
+  ResourceView(ResourceView&& other);
+  ResourceView& operator=(ResourceView&& other);
+  ~ResourceView() { release(); }
+  
+  ResourceView(const ResourceView&) = delete;
+  ResourceView& operator=(const ResourceView&) = delete;
+  
+  bool valid() const { return payload != nullptr; }
+  explicit operator bool() const { return valid(); }
+  const char* data() const { return payload; }   // NUL-terminated
+  size_t length() const { return payloadLength; }
+  void release();
 };
 
+// Reads (view, get, contains) do not take the cache lock. Writers hold it
+// and bracket every index or payload change with an odd sequence number,
+// so a reader retries when one overlaps it. Hits set a CLOCK bit instead
+// of reordering the LRU list, which only writers touch.
+// Entries evicted for space are demoted to a PSRAM tier when one is
+// available; a miss in internal RAM takes the lock and promotes them back.
+// With persistence enabled, critical and important entries are also kept
+// on flash, survive restarts and are loaded the same way when missed.
+// Payloads are only reached through their node, and readers pin the node
+// while they hold a view, so compaction can move any unpinned payload.
 class ResourceCache {
 private:
-  // LRU linked list
-  CacheEntry* head;
-  CacheEntry* tail;
+  // LRU list threaded through the node table by index
+  CacheEntry nodes[CACHE_MAX_ENTRIES];
+  uint16_t head;
+  uint16_t tail;
+  uint16_t freeHead;
   
-  // Hash map for O(1) access
-  std::map<String, CacheEntry*> cacheMap;
+  // Linear-probing hash index for O(1) access
+  CacheIndexSlot index[CACHE_INDEX_SLOTS];
   
   // Cache statistics
   size_t totalCacheSize;
   size_t maxCacheSize;
   int totalEntries;
-  int cacheHits;
-  int cacheMisses;
+  std::atomic<int> cacheHits;
+  std::atomic<int> cacheMisses;
   int evictions;
+  int admissionRejects;      // Stores refused because every candidate victim was more popular
+  int compactions;
+  int relocations;
+  TinyLfuPolicy defaultPolicy;
+  EvictionPolicy* policy;
+  PsramTier psram;           // Second level for evicted entries
+  PersistentStore flash;     // Restart-proof copies, see CACHE_PERSIST_PRIORITY
+  SemaphoreHandle_t mutex;   // Held by every writer, see VramLock
+  std::atomic<uint32_t> sequence;  // Odd while a writer changes what readers see
   
   // Internal methods
-  void moveToHead(CacheEntry* entry);
-  void removeEntry(CacheEntry* entry);
-  void addToHead(CacheEntry* entry);
-  CacheEntry* removeTail();
-  bool shouldEvict(CacheEntry* entry, int newPriority);
-  size_t calculateEntrySize(const String& data);
+  void moveToHead(uint16_t node);
+  void removeEntry(uint16_t node);
+  void addToHead(uint16_t node);
+  uint16_t removeTail();
+  int evictTier(int tier, uint8_t keepFrequency, size_t needed, size_t& freed);
+  size_t calculateEntrySize(size_t dataLength);
+  
+  // Index maintenance
+  static uint32_t hashKey(const char* resourceId);
+  int findSlot(const char* resourceId, uint32_t hash);
+  uint16_t findNode(const String& resourceId);
+  void indexInsert(uint32_t hash, uint16_t node);
+  void indexRemoveSlot(int slot);
+  uint16_t allocateNode();
+  void releaseNode(uint16_t node);
+  char* copyPayload(const String& data);
+  bool checkLimits(const String& resourceId, size_t entrySize);
+  bool installPayload(const String& resourceId, char* payload, size_t length, int priority, size_t entrySize);
+  void removeNode(uint16_t node);
+  bool evictNode(uint16_t node);
+  bool secondChance(uint16_t node);
+  uint16_t pinNode(const char* resourceId, uint32_t hash);
+  uint16_t pinPromoted(const char* resourceId, uint32_t hash);
+  uint16_t promote(const char* resourceId, uint32_t hash);
+  uint16_t loadPersisted(const char* resourceId, uint32_t hash);
+  void persist(uint16_t node);
+  void unpin(uint16_t node);
+  void resetTables();
+  void beginWrite() { sequence.fetch_add(1); }
+  void endWrite() { sequence.fetch_add(1, std::memory_order_release); }
+  
+  friend class ResourceView;
   
 public:
   ResourceCache();
@@ -66,18 +195,54 @@ public:
   // Initialization
   void begin();
   void setMaxCacheSize(size_t maxSize);
+  void setEvictionPolicy(EvictionPolicy* newPolicy);  // Call before the cache is shared; nullptr restores TinyLFU
+  bool enablePersistence();  // Mounts LittleFS; persisted resources are available at once
   
   // Cache operations
   bool store(const String& resourceId, const String& data, int priority, size_t dataSize = 0);
+  
+  // Two-phase store: reserve a buffer (evicting up front), fill it, then commit.
+  // Naming the resource lets the admission filter weigh it against victims.
+  bool reserve(size_t capacity, int priority, CacheReservation& reservation, 
+               const char* resourceId = nullptr);
+  bool commit(const String& resourceId, CacheReservation& reservation, size_t length, 
+              int priority, size_t dataSize = 0);
+  void abort(CacheReservation& reservation);
+  
+  // In-place update: takes a cached payload out into a reservation of at least
+  // capacity bytes that still holds its current content (length bytes).
+  // Readers miss the resource until the reservation is committed or aborted.
+  bool checkout(const String& resourceId, size_t capacity, CacheReservation& reservation, 
+                size_t& length);
+  ResourceView view(const char* resourceId);
+  ResourceView view(const String& resourceId) { return view(resourceId.c_str()); }
   String get(const String& resourceId);
   bool contains(const String& resourceId);
   bool remove(const String& resourceId);
-  void clear();
+  
+  // Revalidation: what the server last said about a cached payload
+  void setValidator(const String& resourceId, int version, const char* hash);
+  int getVersion(const String& resourceId);
+  int getPriority(const String& resourceId);  // 0 when not cached at any level
+  String getETag(const String& resourceId);
+  bool touch(const String& resourceId);  // Server confirmed the cached copy is current
+  void setSpeculative(const String& resourceId);  // Stored by a prefetch, not yet wanted
+  void clear();  // Flash copies survive; remove() deletes them
   
   // Memory management
   int freeMemory(size_t targetBytes);
   void optimizeCache();
-  bool makeSpaceFor(size_t requiredSize, int priority);
+  bool makeSpaceFor(size_t requiredSize, int priority, uint32_t candidateHash = 0);
+  
+  // Dry run of reserve() for a resource of known size, e.g. from the manifest:
+  // whether enough could be evicted for it at this priority. Evicts nothing.
+  // Pins and second chances taken meanwhile can still make reserve() fail.
+  bool wouldAdmit(const char* resourceId, size_t dataLength, int priority);
+  size_t getEntryCost(size_t dataLength) { return calculateEntrySize(dataLength) + CACHE_ENTRY_OVERHEAD; }
+  
+  // Moves payloads so free pool pages form one run; returns how many moved
+  int compact();
+  bool isFragmented() { return memoryManager.getPool().getFragmentation() >= CACHE_COMPACT_THRESHOLD; }
   
   // Cache information
   int getResourceCount() { return totalEntries; }
@@ -90,7 +255,10 @@ public:
   void resetStats();
   int getCacheHits() { return cacheHits; }
   int getCacheMisses() { return cacheMisses; }
+  int getEvictions() { return evictions; }
   float getHitRate() { return (float)cacheHits / (cacheHits + cacheMisses); }
+  PsramTier& getPsramTier() { return psram; }
+  PersistentStore& getPersistentStore() { return flash; }
   
   // Cache maintenance
   void cleanupExpired(unsigned long maxAge = 3600000);  // 1 hour default
@@ -100,14 +268,27 @@ public:
 
 // Implementation
 ResourceCache::ResourceCache() {
-  head = nullptr;
-  tail = nullptr;
+  head = CACHE_NO_NODE;
+  tail = CACHE_NO_NODE;
+  freeHead = CACHE_NO_NODE;
   totalCacheSize = 0;
   maxCacheSize = MAX_CACHE_SIZE;
   totalEntries = 0;
   cacheHits = 0;
   cacheMisses = 0;
   evictions = 0;
+  admissionRejects = 0;
+  compactions = 0;
+  relocations = 0;
+  policy = &defaultPolicy;
+  sequence = 0;
+  
+  for (uint16_t i = 0; i < CACHE_MAX_ENTRIES; i++) {
+    nodes[i].data = nullptr;
+    nodes[i].pinCount = 0;   // Only pins change it from here on, see pinNode()
+  }
+  mutex = xSemaphoreCreateRecursiveMutex();
+  resetTables();   // Tables only: the lock is first taken, and PSRAM cleared, by begin()
 }
 
 ResourceCache::~ResourceCache() {
@@ -115,12 +296,15 @@ ResourceCache::~ResourceCache() {
 }
 
 void ResourceCache::begin() {
-  Serial.println("ResourceCache: Initializing...");
+  VramLock guard(mutex);
+  VRAM_LOGI("cache", "ResourceCache: Initializing...");
   clear();
-  Serial.printf("Cache initialized with max size: %d bytes\n", maxCacheSize);
+  psram.begin();
+  VRAM_LOGI("cache", "Cache initialized with max size: %d bytes", maxCacheSize);
 }
 
 void ResourceCache::setMaxCacheSize(size_t maxSize) {
+  VramLock guard(mutex);
   maxCacheSize = maxSize;
   
   // If current cache exceeds new limit, trigger cleanup
@@ -129,167 +313,695 @@ void ResourceCache::setMaxCacheSize(size_t maxSize) {
   }
 }
 
+bool ResourceCache::enablePersistence() {
+  VramLock guard(mutex);
+  return flash.begin();
+}
+
+void ResourceCache::setEvictionPolicy(EvictionPolicy* newPolicy) {
+  VramLock guard(mutex);
+  policy = (newPolicy != nullptr) ? newPolicy : &defaultPolicy;
+  policy->reset();
+  VRAM_LOGI("cache", "Eviction policy: %s", policy->name());
+}
+
 bool ResourceCache::store(const String& resourceId, const String& data, int priority, size_t dataSize) {
+  VramLock guard(mutex);
   // Calculate entry size
-  size_t entrySize = dataSize > 0 ? dataSize : calculateEntrySize(data);
+  size_t entrySize = dataSize > 0 ? dataSize : calculateEntrySize(data.length());
+  if (!checkLimits(resourceId, entrySize)) {
+    return false;
+  }
+  
+  // Make space if necessary
+  uint32_t hash = hashKey(resourceId.c_str());
+  policy->recordAccess(hash);
+  if (findNode(resourceId) == CACHE_NO_NODE &&
+      !makeSpaceFor(entrySize + CACHE_ENTRY_OVERHEAD, priority, hash)) {
+    VRAM_LOGW("cache", "Cannot make space for resource %s (%d bytes)", 
+                       resourceId.c_str(), entrySize);
+    return false;
+  }
+  
+  // Payload goes to the slab pool so eviction returns it there
+  char* payload = copyPayload(data);
+  if (payload == nullptr) {
+    VRAM_LOGW("cache", "Cannot allocate payload for %s", resourceId.c_str());
+    return false;
+  }
+  
+  if (!installPayload(resourceId, payload, data.length(), priority, entrySize)) {
+    return false;
+  }
+  persist(findNode(resourceId));
+  return true;
+}
+
+bool ResourceCache::reserve(size_t capacity, int priority, CacheReservation& reservation, 
+                            const char* resourceId) {
+  VramLock guard(mutex);
+  reservation.buffer = nullptr;
+  reservation.capacity = 0;
+  reservation.accounted = 0;
+  
+  if (capacity > MAX_RESOURCE_SIZE) {
+    VRAM_LOGW("cache", "Reservation too large (%d bytes), max allowed: %d", 
+                       capacity, MAX_RESOURCE_SIZE);
+    return false;
+  }
+  
+  // Evict up front so the download never has to hold a second copy
+  size_t accounted = calculateEntrySize(capacity) + CACHE_ENTRY_OVERHEAD;
+  uint32_t hash = 0;
+  if (resourceId != nullptr) {
+    hash = hashKey(resourceId);
+    policy->recordAccess(hash);
+  }
+  if (!makeSpaceFor(accounted, priority, hash)) {
+    VRAM_LOGW("cache", "Cannot make space for reservation (%d bytes)", capacity);
+    return false;
+  }
   
+  char* buffer = (char*)VRAM_MALLOC(capacity + 1, "cache");
+  if (buffer == nullptr) {
+    VRAM_LOGW("cache", "Cannot allocate reservation (%d bytes)", capacity);
+    return false;
+  }
+  
+  // Counted against the cache budget until committed or aborted
+  totalCacheSize += accounted;
+  reservation.buffer = buffer;
+  reservation.capacity = capacity;
+  reservation.accounted = accounted;
+  return true;
+}
+
+bool ResourceCache::commit(const String& resourceId, CacheReservation& reservation, size_t length, 
+                           int priority, size_t dataSize) {
+  VramLock guard(mutex);
+  if (reservation.buffer == nullptr) {
+    return false;
+  }
+  
+  size_t entrySize = dataSize > 0 ? dataSize : calculateEntrySize(length);
+  if (length > reservation.capacity || !checkLimits(resourceId, entrySize)) {
+    abort(reservation);
+    return false;
+  }
+  
+  char* payload = reservation.buffer;
+  payload[length] = '\0';
+  
+  // Give back what the upper-bound reservation did not use
+  if (length + 1 < reservation.capacity - reservation.capacity / 4) {
+    char* trimmed = (char*)VRAM_REALLOC(payload, length + 1, "cache");
+    if (trimmed != nullptr) {
+      payload = trimmed;
+    }
+  }
+  
+  totalCacheSize -= reservation.accounted;
+  reservation.buffer = nullptr;
+  reservation.capacity = 0;
+  reservation.accounted = 0;
+  
+  return installPayload(resourceId, payload, length, priority, entrySize);
+}
+
+void ResourceCache::abort(CacheReservation& reservation) {
+  VramLock guard(mutex);
+  if (reservation.buffer != nullptr) {
+    VRAM_FREE(reservation.buffer);
+    totalCacheSize -= reservation.accounted;
+  }
+  reservation.buffer = nullptr;
+  reservation.capacity = 0;
+  reservation.accounted = 0;
+}
+
+bool ResourceCache::checkout(const String& resourceId, size_t capacity, CacheReservation& reservation, 
+                             size_t& length) {
+  VramLock guard(mutex);
+  reservation.buffer = nullptr;
+  reservation.capacity = 0;
+  reservation.accounted = 0;
+  length = 0;
+  
+  if (capacity > MAX_RESOURCE_SIZE) {
+    VRAM_LOGW("cache", "Reservation too large (%d bytes), max allowed: %d", 
+                       capacity, MAX_RESOURCE_SIZE);
+    return false;
+  }
+  
+  uint16_t node = findNode(resourceId);
+  if (node == CACHE_NO_NODE) {
+    node = promote(resourceId.c_str(), hashKey(resourceId.c_str()));
+  }
+  if (node == CACHE_NO_NODE) {
+    return false;
+  }
+  
+  // Growth is made room for up front; the pin keeps this entry out of the victims
+  CacheEntry* entry = &nodes[node];
+  if (capacity < entry->dataLength) {
+    capacity = entry->dataLength;
+  }
+  size_t accounted = calculateEntrySize(capacity) + CACHE_ENTRY_OVERHEAD;
+  size_t charged = entry->size + CACHE_ENTRY_OVERHEAD;
+  if (accounted > charged) {
+    entry->pinCount++;
+    bool room = makeSpaceFor(accounted - charged, entry->priority, entry->keyHash);
+    entry->pinCount--;
+    if (!room) {
+      VRAM_LOGW("cache", "Cannot make space to update %s (%d bytes)", resourceId.c_str(), capacity);
+      return false;
+    }
+  }
+  
+  // The pin check must sit inside the write section, see pinNode()
+  beginWrite();
+  char* buffer = nullptr;
+  if (entry->pinCount == 0) {
+    buffer = (char*)VRAM_REALLOC(entry->data, capacity + 1, "cache");
+  }
+  if (buffer != nullptr) {
+    length = entry->dataLength;
+    entry->data = nullptr;   // Now owned by the reservation
+    removeNode(node);
+  }
+  endWrite();
+  
+  if (buffer == nullptr) {
+    VRAM_LOGW("cache", "Resource %s is in use or cannot grow, update rejected", resourceId.c_str());
+    return false;
+  }
+  
+  totalCacheSize += accounted;
+  reservation.buffer = buffer;
+  reservation.capacity = capacity;
+  reservation.accounted = accounted;
+  return true;
+}
+
+bool ResourceCache::checkLimits(const String& resourceId, size_t entrySize) {
   // Check if resource is too large
   if (entrySize > MAX_RESOURCE_SIZE) {
-    Serial.printf("Resource %s too large (%d bytes), max allowed: %d\n", 
-                  resourceId.c_str(), entrySize, MAX_RESOURCE_SIZE);
+    VRAM_LOGW("cache", "Resource %s too large (%d bytes), max allowed: %d", 
+                       resourceId.c_str(), entrySize, MAX_RESOURCE_SIZE);
     return false;
   }
   
+  if (resourceId.length() >= CACHE_ID_LENGTH) {
+    VRAM_LOGW("cache", "Resource ID %s too long, max allowed: %d", 
+                       resourceId.c_str(), CACHE_ID_LENGTH - 1);
+    return false;
+  }
+  
+  return true;
+}
+
+bool ResourceCache::installPayload(const String& resourceId, char* payload, size_t length, 
+                                   int priority, size_t entrySize) {
+  // New content supersedes any demoted copy
+  psram.remove(resourceId.c_str(), hashKey(resourceId.c_str()));
+  
   // Check if resource already exists
-  if (contains(resourceId)) {
-    // Update existing entry
-    CacheEntry* entry = cacheMap[resourceId];
+  uint16_t existing = findNode(resourceId);
+  if (existing != CACHE_NO_NODE) {
+    // Update existing entry; the pin check must sit inside the write section
+    CacheEntry* entry = &nodes[existing];
+    beginWrite();
+    if (entry->pinCount > 0) {
+      endWrite();
+      VRAM_LOGW("cache", "Resource %s is in use, update rejected", resourceId.c_str());
+      VRAM_FREE(payload);
+      return false;
+    }
     totalCacheSize -= entry->size;
     
-    entry->data = data;
+    VRAM_FREE(entry->data);
+    entry->data = payload;
+    entry->dataLength = length;
     entry->size = entrySize;
     entry->priority = priority;
     entry->accessTime = millis();
     entry->accessCount++;
+    entry->version = 0;      // New content, validator unknown until set
+    entry->etag[0] = '\0';
+    entry->speculative = false;
+    endWrite();
     
     totalCacheSize += entrySize;
-    moveToHead(entry);
+    moveToHead(existing);
     
-    Serial.printf("Updated cached resource: %s (%d bytes)\n", 
-                  resourceId.c_str(), entrySize);
+    VRAM_LOGD("cache", "Updated cached resource: %s (%d bytes)", 
+                       resourceId.c_str(), entrySize);
     return true;
   }
   
-  // Make space if necessary
-  if (!makeSpaceFor(entrySize + CACHE_ENTRY_OVERHEAD, priority)) {
-    Serial.printf("Cannot make space for resource %s (%d bytes)\n", 
-                  resourceId.c_str(), entrySize);
+  // Claim a node; a full table is treated like a full cache
+  uint16_t node = allocateNode();
+  if (node == CACHE_NO_NODE) {
+    VRAM_LOGW("cache", "Cache index full (%d entries), cannot store %s",
+                       CACHE_MAX_ENTRIES, resourceId.c_str());
+    VRAM_FREE(payload);
     return false;
   }
   
   // Create new cache entry
-  CacheEntry* entry = new CacheEntry();
-  entry->resourceId = resourceId;
-  entry->data = data;
+  CacheEntry* entry = &nodes[node];
+  strcpy(entry->resourceId, resourceId.c_str());
+  entry->data = payload;
+  entry->dataLength = length;
+  entry->keyHash = hashKey(entry->resourceId);
   entry->priority = priority;
   entry->size = entrySize;
   entry->accessTime = millis();
   entry->createTime = millis();
   entry->accessCount = 1;
-  entry->prev = nullptr;
-  entry->next = nullptr;
+  entry->referenced = false;
+  entry->speculative = false;
+  entry->version = 0;
+  entry->etag[0] = '\0';
   
-  // Add to cache
-  addToHead(entry);
-  cacheMap[resourceId] = entry;
+  // Add to cache; readers can find the entry once the slot is written
+  addToHead(node);
+  beginWrite();
+  indexInsert(entry->keyHash, node);
+  endWrite();
   totalCacheSize += entrySize + CACHE_ENTRY_OVERHEAD;
   totalEntries++;
   
-  Serial.printf("Cached new resource: %s (%d bytes, priority: %d)\n", 
-                resourceId.c_str(), entrySize, priority);
+  VRAM_LOGD("cache", "Cached new resource: %s (%d bytes, priority: %d)", 
+                     resourceId.c_str(), entrySize, priority);
   
   return true;
 }
 
-String ResourceCache::get(const String& resourceId) {
-  auto it = cacheMap.find(resourceId);
-  if (it != cacheMap.end()) {
-    CacheEntry* entry = it->second;
-    
-    // Update access information
-    entry->accessTime = millis();
-    entry->accessCount++;
+ResourceView ResourceCache::view(const char* resourceId) {
+  uint32_t hash = hashKey(resourceId);
+  policy->recordAccess(hash);
+  uint16_t node = pinNode(resourceId, hash);
+  if (node != CACHE_NO_NODE) {
+    cacheHits++;
+  } else {
+    cacheMisses++;
+    node = pinPromoted(resourceId, hash);
+  }
+  if (node == CACHE_NO_NODE) {
+    return ResourceView();
+  }
+  
+  // Update access information; eviction reads the bit instead of list order
+  CacheEntry* entry = &nodes[node];
+  entry->accessTime = millis();
+  entry->accessCount++;
+  entry->referenced = true;
+  if (entry->speculative) {
+    entry->speculative = false;  // The prefetch paid off
+  }
+  return ResourceView(this, node, entry->data, entry->dataLength);
+}
+
+uint16_t ResourceCache::pinPromoted(const char* resourceId, uint32_t hash) {
+  if (psram.getEntryCount() == 0 && flash.getEntryCount() == 0) {
+    if (psram.isEnabled()) psram.recordMiss();
+    return CACHE_NO_NODE;
+  }
+  
+  // Another task may have stored or promoted it since the lock-free miss
+  VramLock guard(mutex);
+  int slot = findSlot(resourceId, hash);
+  uint16_t node = (slot >= 0) ? index[slot].node : promote(resourceId, hash);
+  if (node != CACHE_NO_NODE) {
+    nodes[node].pinCount++;
+  }
+  return node;
+}
+
+uint16_t ResourceCache::promote(const char* resourceId, uint32_t hash) {
+  TierEntry* demoted = psram.find(resourceId, hash);
+  if (demoted == nullptr) {
+    if (psram.isEnabled()) psram.recordMiss();
+    return loadPersisted(resourceId, hash);
+  }
+  
+  // Take it out first: making space may demote others and must not drop this one
+  String id(resourceId);
+  size_t length = demoted->dataLength;
+  int priority = demoted->priority;
+  int version = demoted->version;
+  char etag[CACHE_ETAG_LENGTH];
+  strcpy(etag, demoted->etag);
+  char* stored = psram.detach(demoted);
+  
+  size_t entrySize = calculateEntrySize(length);
+  char* payload = nullptr;
+  if (makeSpaceFor(entrySize + CACHE_ENTRY_OVERHEAD, priority, hash)) {
+    payload = (char*)VRAM_MALLOC(length + 1, "cache");
+  }
+  if (payload == nullptr) {
+    // No room in internal RAM; the copy stays where it was
+    VRAM_LOGD("cache", "Cannot promote %s (%d bytes)", resourceId, length);
+    if (!psram.adopt(resourceId, hash, stored, length, priority, version, etag)) {
+      PsramTier::releaseBuffer(stored);
+    }
+    psram.recordMiss();
+    return CACHE_NO_NODE;
+  }
+  
+  memcpy(payload, stored, length + 1);
+  PsramTier::releaseBuffer(stored);
+  if (!installPayload(id, payload, length, priority, entrySize)) {
+    psram.recordMiss();
+    return CACHE_NO_NODE;
+  }
+  
+  // Keep the validators so the promoted copy can still be revalidated
+  uint16_t node = findNode(id);
+  nodes[node].version = version;
+  strcpy(nodes[node].etag, etag);
+  psram.recordHit();
+  VRAM_LOGD("cache", "Promoted %s from PSRAM (%d bytes)", resourceId, length);
+  return node;
+}
+
+uint16_t ResourceCache::loadPersisted(const char* resourceId, uint32_t hash) {
+  PersistEntry* saved = flash.find(resourceId, hash);
+  if (saved == nullptr) {
+    return CACHE_NO_NODE;
+  }
+  
+  // Copy what is needed first; the store entry may move while space is made
+  String id(resourceId);
+  PersistEntry record = *saved;
+  size_t entrySize = calculateEntrySize(record.length);
+  if (!makeSpaceFor(entrySize + CACHE_ENTRY_OVERHEAD, record.priority, hash)) {
+    VRAM_LOGD("cache", "No room to load %s from flash", resourceId);
+    return CACHE_NO_NODE;
+  }
+  
+  char* payload = (char*)VRAM_MALLOC(record.length + 1, "cache");
+  if (payload == nullptr) {
+    return CACHE_NO_NODE;
+  }
+  if (!flash.read(&record, payload)) {
+    VRAM_FREE(payload);
+    flash.erase(resourceId, hash);
+    return CACHE_NO_NODE;
+  }
+  if (!installPayload(id, payload, record.length, record.priority, entrySize)) {
+    return CACHE_NO_NODE;
+  }
+  
+  // The persisted validators let the server answer 304 for an unchanged copy
+  uint16_t node = findNode(id);
+  nodes[node].version = record.version;
+  strcpy(nodes[node].etag, record.etag);
+  VRAM_LOGD("cache", "Loaded %s from flash (%d bytes)", resourceId, record.length);
+  return node;
+}
+
+void ResourceCache::persist(uint16_t node) {
+  if (node == CACHE_NO_NODE || !flash.isEnabled()) {
+    return;
+  }
+  
+  CacheEntry* entry = &nodes[node];
+  if (entry->priority <= CACHE_PERSIST_PRIORITY) {
+    flash.write(entry->resourceId, entry->keyHash, entry->data, entry->dataLength,
+                entry->priority, entry->version, entry->etag);
+  } else {
+    flash.erase(entry->resourceId, entry->keyHash);
+  }
+}
+
+uint16_t ResourceCache::pinNode(const char* resourceId, uint32_t hash) {
+  for (int attempt = 0; attempt < CACHE_READ_RETRIES; attempt++) {
+    uint32_t start = sequence.load(std::memory_order_acquire);
+    if (start & 1) continue;  // Writer in progress
     
-    // Move to head (most recently used)
-    moveToHead(entry);
+    int slot = findSlot(resourceId, hash);
+    if (slot < 0) {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence.load(std::memory_order_relaxed) == start) return CACHE_NO_NODE;
+      continue;
+    }
     
-    cacheHits++;
-    return entry->data;
+    // Pin first, then confirm no writer ran: a writer that starts later sees the pin
+    uint16_t node = index[slot].node;
+    if (node < CACHE_MAX_ENTRIES) {
+      nodes[node].pinCount++;
+      if (sequence.load() == start) return node;
+      nodes[node].pinCount--;
+    }
   }
   
-  cacheMisses++;
-  return "";
+  // Writers kept getting in the way; wait for them instead
+  VramLock guard(mutex);
+  int slot = findSlot(resourceId, hash);
+  if (slot < 0) return CACHE_NO_NODE;
+  uint16_t node = index[slot].node;
+  nodes[node].pinCount++;
+  return node;
+}
+
+String ResourceCache::get(const String& resourceId) {
+  ResourceView resource = view(resourceId);
+  if (!resource) {
+    return "";
+  }
+  return String(resource.data(), resource.length());
 }
 
 bool ResourceCache::contains(const String& resourceId) {
-  return cacheMap.find(resourceId) != cacheMap.end();
+  uint32_t hash = hashKey(resourceId.c_str());
+  uint16_t node = pinNode(resourceId.c_str(), hash);
+  if (node != CACHE_NO_NODE) {
+    unpin(node);
+    return true;
+  }
+  
+  // A demoted or persisted copy counts: it is served without going to the network
+  if (psram.getEntryCount() == 0 && flash.getEntryCount() == 0) {
+    return false;
+  }
+  VramLock guard(mutex);
+  return psram.find(resourceId.c_str(), hash) != nullptr || flash.find(resourceId.c_str(), hash) != nullptr;
+}
+
+void ResourceCache::setValidator(const String& resourceId, int version, const char* hash) {
+  VramLock guard(mutex);
+  uint16_t node = findNode(resourceId);
+  if (node == CACHE_NO_NODE) {
+    return;
+  }
+  
+  CacheEntry* entry = &nodes[node];
+  entry->version = version;
+  strncpy(entry->etag, hash != nullptr ? hash : "", CACHE_ETAG_LENGTH - 1);
+  entry->etag[CACHE_ETAG_LENGTH - 1] = '\0';
+  
+  // Downloads end here, so this is where fresh content reaches flash
+  persist(node);
+}
+
+int ResourceCache::getVersion(const String& resourceId) {
+  VramLock guard(mutex);
+  uint16_t node = findNode(resourceId);
+  if (node != CACHE_NO_NODE) {
+    return nodes[node].version;
+  }
+  uint32_t hash = hashKey(resourceId.c_str());
+  TierEntry* demoted = psram.find(resourceId.c_str(), hash);
+  if (demoted != nullptr) {
+    return demoted->version;
+  }
+  PersistEntry* saved = flash.find(resourceId.c_str(), hash);
+  return saved != nullptr ? saved->version : 0;
+}
+
+int ResourceCache::getPriority(const String& resourceId) {
+  VramLock guard(mutex);
+  uint16_t node = findNode(resourceId);
+  if (node != CACHE_NO_NODE) {
+    return nodes[node].priority;
+  }
+  uint32_t hash = hashKey(resourceId.c_str());
+  TierEntry* demoted = psram.find(resourceId.c_str(), hash);
+  if (demoted != nullptr) {
+    return demoted->priority;
+  }
+  PersistEntry* saved = flash.find(resourceId.c_str(), hash);
+  return saved != nullptr ? saved->priority : 0;
+}
+
+String ResourceCache::getETag(const String& resourceId) {
+  VramLock guard(mutex);
+  uint16_t node = findNode(resourceId);
+  if (node != CACHE_NO_NODE) {
+    return String(nodes[node].etag);
+  }
+  uint32_t hash = hashKey(resourceId.c_str());
+  TierEntry* demoted = psram.find(resourceId.c_str(), hash);
+  if (demoted != nullptr) {
+    return String(demoted->etag);
+  }
+  PersistEntry* saved = flash.find(resourceId.c_str(), hash);
+  return saved != nullptr ? String(saved->etag) : String();
+}
+
+bool ResourceCache::touch(const String& resourceId) {
+  VramLock guard(mutex);
+  uint16_t node = findNode(resourceId);
+  if (node == CACHE_NO_NODE) {
+    // Revalidated while demoted: the copy is wanted again
+    node = promote(resourceId.c_str(), hashKey(resourceId.c_str()));
+  }
+  if (node == CACHE_NO_NODE) {
+    return false;
+  }
+  
+  // Counts as fresh for expiry, as recent for LRU and as a request for the policy
+  policy->recordAccess(nodes[node].keyHash);
+  nodes[node].accessTime = millis();
+  nodes[node].speculative = false;
+  moveToHead(node);
+  VRAM_LOGD("cache", "Revalidated cached resource: %s", resourceId.c_str());
+  return true;
+}
+
+void ResourceCache::setSpeculative(const String& resourceId) {
+  VramLock guard(mutex);
+  uint16_t node = findNode(resourceId);
+  if (node != CACHE_NO_NODE) {
+    nodes[node].speculative = true;
+  }
 }
 
 bool ResourceCache::remove(const String& resourceId) {
-  auto it = cacheMap.find(resourceId);
-  if (it != cacheMap.end()) {
-    CacheEntry* entry = it->second;
-    
-    totalCacheSize -= (entry->size + CACHE_ENTRY_OVERHEAD);
-    totalEntries--;
-    
-    removeEntry(entry);
-    cacheMap.erase(it);
-    delete entry;
-    
-    Serial.printf("Removed cached resource: %s\n", resourceId.c_str());
+  VramLock guard(mutex);
+  uint32_t hash = hashKey(resourceId.c_str());
+  bool dropped = psram.remove(resourceId.c_str(), hash);
+  dropped = flash.erase(resourceId.c_str(), hash) || dropped;
+  uint16_t node = findNode(resourceId);
+  if (node != CACHE_NO_NODE) {
+    if (!evictNode(node)) {
+      VRAM_LOGW("cache", "Resource %s is in use, not removed", resourceId.c_str());
+      return false;
+    }
+    VRAM_LOGD("cache", "Removed cached resource: %s", resourceId.c_str());
     return true;
   }
   
-  return false;
+  return dropped;
 }
 
 void ResourceCache::clear() {
-  CacheEntry* current = head;
-  while (current != nullptr) {
-    CacheEntry* next = current->next;
-    delete current;
-    current = next;
+  VramLock guard(mutex);
+  beginWrite();
+  resetTables();
+  endWrite();
+  psram.clear();
+  
+  VRAM_LOGD("cache", "Cache cleared");
+}
+
+// Caller holds the lock (or owns the cache outright, as the constructor does)
+void ResourceCache::resetTables() {
+  // Release payloads and rebuild the free list in table order
+  for (uint16_t i = 0; i < CACHE_MAX_ENTRIES; i++) {
+    if (nodes[i].data != nullptr) {
+      VRAM_FREE(nodes[i].data);
+      nodes[i].data = nullptr;
+    }
+    nodes[i].resourceId[0] = '\0';
+    nodes[i].dataLength = 0;
+    nodes[i].referenced = false;
+    nodes[i].speculative = false;
+    nodes[i].prev = CACHE_NO_NODE;
+    nodes[i].next = (i + 1 < CACHE_MAX_ENTRIES) ? i + 1 : CACHE_NO_NODE;
   }
+  freeHead = 0;
   
-  head = nullptr;
-  tail = nullptr;
-  cacheMap.clear();
+  for (uint32_t i = 0; i < CACHE_INDEX_SLOTS; i++) {
+    index[i].hash = 0;
+    index[i].node = CACHE_NO_NODE;
+  }
+  
+  head = CACHE_NO_NODE;
+  tail = CACHE_NO_NODE;
   totalCacheSize = 0;
   totalEntries = 0;
-  
-  Serial.println("Cache cleared");
 }
 
 int ResourceCache::freeMemory(size_t targetBytes) {
+  VramLock guard(mutex);
   int freedResources = 0;
   size_t freedBytes = 0;
   
-  Serial.printf("Attempting to free %d bytes from cache\n", targetBytes);
+  VRAM_LOGD("cache", "Attempting to free %d bytes from cache", targetBytes);
   
-  // Start from least recently used (tail) and work backwards
-  CacheEntry* current = tail;
-  while (current != nullptr && freedBytes < targetBytes) {
-    CacheEntry* prev = current->prev;
+  // Prefetched entries nobody has read yet are the cheapest to lose
+  freedResources += evictTier(CACHE_TIER_SPECULATIVE, CACHE_ANY_FREQUENCY, targetBytes, freedBytes);
     
+  // Then lowest priority first; within a tier, spare frequently requested entries while others remain
+  for (int tier = PRIORITY_LOW; tier >= PRIORITY_CRITICAL && freedBytes < targetBytes; tier--) {
     // Don't remove critical resources unless absolutely necessary
-    if (current->priority == PRIORITY_CRITICAL && freedBytes > targetBytes / 2) {
-      current = prev;
-      continue;
+    size_t limit = (tier == PRIORITY_CRITICAL) ? targetBytes / 2 + 1 : targetBytes;
+    freedResources += evictTier(tier, CACHE_HOT_FREQUENCY, limit, freedBytes);
+    freedResources += evictTier(tier, CACHE_ANY_FREQUENCY, limit, freedBytes);
+  }
+  
+  VRAM_LOGD("cache", "Freed %d resources (%d bytes)", freedResources, freedBytes);
+  return freedResources;
+}
+
+int ResourceCache::compact() {
+  VramLock guard(mutex);
+  int fragmentation = memoryManager.getPool().getFragmentation();
+  
+  // Lowest address first, so each page run slides down into the gap below it
+  uint16_t order[CACHE_MAX_ENTRIES];
+  uint16_t count = 0;
+  for (uint16_t current = head; current != CACHE_NO_NODE; current = nodes[current].next) {
+    uint16_t position = count++;
+    while (position > 0 && nodes[order[position - 1]].data > nodes[current].data) {
+      order[position] = order[position - 1];
+      position--;
     }
+    order[position] = current;
+  }
+  
+  int moved = 0;
+  for (uint16_t i = 0; i < count; i++) {
+    CacheEntry* entry = &nodes[order[i]];
     
-    freedBytes += current->size + CACHE_ENTRY_OVERHEAD;
-    freedResources++;
-    
-    Serial.printf("Evicting resource: %s (%d bytes, priority: %d)\n", 
-                  current->resourceId.c_str(), current->size, current->priority);
-    
-    // Remove the entry
-    String resourceId = current->resourceId;
-    current = prev;
-    remove(resourceId);
-    evictions++;
+    // Like eviction: the pin check and the move share one write section
+    beginWrite();
+    if (entry->pinCount == 0) {
+      char* relocated = (char*)VRAM_RELOCATE(entry->data);
+      if (relocated != nullptr) {
+        entry->data = relocated;
+        moved++;
+      }
+    }
+    endWrite();
   }
   
-  Serial.printf("Freed %d resources (%d bytes)\n", freedResources, freedBytes);
-  return freedResources;
+  compactions++;
+  relocations += moved;
+  VRAM_LOGI("cache", "Compaction moved %d payloads, pool fragmentation %d%% -> %d%%",
+            moved, fragmentation, memoryManager.getPool().getFragmentation());
+  return moved;
 }
 
 void ResourceCache::optimizeCache() {
-  Serial.println("Optimizing cache...");
+  VramLock guard(mutex);
+  VRAM_LOGI("cache", "Optimizing cache...");
   
   if (totalCacheSize <= maxCacheSize) {
-    Serial.println("Cache optimization not needed");
+    VRAM_LOGI("cache", "Cache optimization not needed");
     return;
   }
   
@@ -297,146 +1009,390 @@ void ResourceCache::optimizeCache() {
   freeMemory(targetReduction);
 }
 
-bool ResourceCache::makeSpaceFor(size_t requiredSize, int priority) {
-  if (totalCacheSize + requiredSize <= maxCacheSize) {
+bool ResourceCache::makeSpaceFor(size_t requiredSize, int priority, uint32_t candidateHash) {
+  VramLock guard(mutex);
+  bool needNode = (freeHead == CACHE_NO_NODE);
+  if (!needNode && totalCacheSize + requiredSize <= maxCacheSize) {
     return true;  // Already have space
   }
   
-  size_t spaceNeeded = (totalCacheSize + requiredSize) - maxCacheSize;
-  
-  // Try to free space by removing lower priority items first
-  CacheEntry* current = tail;
+  // Any eviction frees a node, so a full table only needs one
+  size_t spaceNeeded = 1;
+  if (totalCacheSize + requiredSize > maxCacheSize) {
+    spaceNeeded = (totalCacheSize + requiredSize) - maxCacheSize;
+  }
   size_t freedSpace = 0;
   
-  while (current != nullptr && freedSpace < spaceNeeded) {
-    CacheEntry* prev = current->prev;
+  // Unread prefetches give way to anything that is actually wanted
+  if (priority < PRIORITY_LOW) {
+    evictTier(CACHE_TIER_SPECULATIVE, CACHE_ANY_FREQUENCY, spaceNeeded, freedSpace);
+  }
+  
+  // Lower priority tiers always give way
+  for (int tier = PRIORITY_LOW; tier > priority && freedSpace < spaceNeeded; tier--) {
+    evictTier(tier, CACHE_ANY_FREQUENCY, spaceNeeded, freedSpace);
+  }
+  
+  // Within the same tier the newcomer must be at least as popular as its victims,
+  // so a scan of one-off resources cannot flush the working set. An unnamed
+  // candidate counts as requested once.
+  if (freedSpace < spaceNeeded) {
+    uint8_t candidateFrequency = (candidateHash != 0) ? policy->frequency(candidateHash) : 1;
+    evictTier(priority, candidateFrequency, spaceNeeded, freedSpace);
+  }
+  
+  if (freedSpace < spaceNeeded) {
+    admissionRejects++;
+    return false;
+  }
+  return true;
+}
+
+bool ResourceCache::wouldAdmit(const char* resourceId, size_t dataLength, int priority) {
+  VramLock guard(mutex);
+  size_t needed = getEntryCost(dataLength);
+  if (dataLength > MAX_RESOURCE_SIZE || needed > maxCacheSize || strlen(resourceId) >= CACHE_ID_LENGTH) {
+    return false;
+  }
+  if (freeHead != CACHE_NO_NODE && totalCacheSize + needed <= maxCacheSize) {
+    return true;
+  }
+  size_t spaceNeeded = 1;
+  if (totalCacheSize + needed > maxCacheSize) {
+    spaceNeeded = (totalCacheSize + needed) - maxCacheSize;
+  }
+  
+  // Same victims as makeSpaceFor(); reserve() counts the request before asking
+  uint8_t candidateFrequency = policy->frequency(hashKey(resourceId));
+  if (candidateFrequency < SKETCH_MAX_COUNT) candidateFrequency++;
+  
+  size_t evictable = 0;
+  for (uint16_t current = head; current != CACHE_NO_NODE && evictable < spaceNeeded; current = nodes[current].next) {
+    CacheEntry* entry = &nodes[current];
+    if (entry->pinCount > 0) continue;
+    if ((entry->speculative && priority < PRIORITY_LOW) || entry->priority > priority ||
+        (entry->priority == priority && policy->frequency(entry->keyHash) <= candidateFrequency)) {
+      evictable += entry->size + CACHE_ENTRY_OVERHEAD;
+    }
+  }
+  return evictable >= spaceNeeded;
+}
+
+int ResourceCache::evictTier(int tier, uint8_t keepFrequency, size_t needed, size_t& freed) {
+  int evicted = 0;
+  
+  // Start from least recently used (tail) and work backwards
+  uint16_t current = tail;
+  while (current != CACHE_NO_NODE && freed < needed) {
+    CacheEntry* entry = &nodes[current];
+    uint16_t prev = entry->prev;
     
-    // Remove if lower priority or same priority but older
-    if (shouldEvict(current, priority)) {
-      freedSpace += current->size + CACHE_ENTRY_OVERHEAD;
-      String resourceId = current->resourceId;
+    bool inTier = (tier == CACHE_TIER_SPECULATIVE) ? entry->speculative.load() : (entry->priority == tier);
+    if (!inTier || entry->pinCount > 0 ||
+        (keepFrequency != CACHE_ANY_FREQUENCY && policy->frequency(entry->keyHash) > keepFrequency)) {
       current = prev;
-      remove(resourceId);
-      evictions++;
-    } else {
+      continue;
+    }
+    
+    // Recently read entries move to the head and are reconsidered last
+    if (tier != CACHE_TIER_SPECULATIVE && secondChance(current)) {
       current = prev;
+      continue;
     }
+    
+    size_t entryBytes = entry->size + CACHE_ENTRY_OVERHEAD;
+    VRAM_LOGD("cache", "Evicting resource: %s (%d bytes, priority: %d)", 
+                       entry->resourceId, entry->size, entry->priority);
+    
+    // Demote rather than drop; unread prefetches are not worth the copy
+    bool demoted = !entry->speculative &&
+                   psram.demote(entry->resourceId, entry->keyHash, entry->data, entry->dataLength,
+                                entry->priority, entry->version, entry->etag);
+    
+    // Pinned entries are in use and cannot be evicted
+    if (evictNode(current)) {
+      freed += entryBytes;
+      evicted++;
+      evictions++;
+    } else if (demoted) {
+      psram.remove(entry->resourceId, entry->keyHash);
+    }
+    current = prev;
   }
-  
-  return freedSpace >= spaceNeeded;
+  return evicted;
 }
 
-bool ResourceCache::shouldEvict(CacheEntry* entry, int newPriority) {
-  // Always evict lower priority
-  if (entry->priority > newPriority) {
-    return true;
+size_t ResourceCache::calculateEntrySize(size_t dataLength) {
+  return dataLength + sizeof(CacheEntry);
+}
+
+uint32_t ResourceCache::hashKey(const char* resourceId) {
+  // 32-bit FNV-1a
+  uint32_t hash = 2166136261u;
+  const char* key = resourceId;
+  while (*key) {
+    hash ^= (uint8_t)*key++;
+    hash *= 16777619u;
   }
+  return hash;
+}
+
+int ResourceCache::findSlot(const char* resourceId, uint32_t hash) {
+  const uint32_t mask = CACHE_INDEX_SLOTS - 1;
+  uint32_t slot = hash & mask;
   
-  // For same priority, consider age and access frequency
-  if (entry->priority == newPriority) {
-    unsigned long age = millis() - entry->createTime;
-    unsigned long timeSinceAccess = millis() - entry->accessTime;
+  // The load factor is capped at 0.5, so an empty slot always ends the probe.
+  // Lock-free readers may see a slot mid-update: read each node once and bound
+  // the probe and compare; pinNode() discards whatever such a pass returns.
+  for (uint32_t probes = 0; probes < CACHE_INDEX_SLOTS; probes++) {
+    uint16_t node = index[slot].node;
+    if (node == CACHE_NO_NODE) break;
     
-    // Evict if not accessed recently and low access count
-    if (timeSinceAccess > 300000 && entry->accessCount < 3) {  // 5 minutes
-      return true;
+    // Strings are only compared once the full 32-bit hash matches
+    if (node < CACHE_MAX_ENTRIES && index[slot].hash == hash &&
+        strncmp(nodes[node].resourceId, resourceId, CACHE_ID_LENGTH) == 0) {
+      return slot;
     }
+    slot = (slot + 1) & mask;
   }
+  return -1;
+}
+
+uint16_t ResourceCache::findNode(const String& resourceId) {
+  int slot = findSlot(resourceId.c_str(), hashKey(resourceId.c_str()));
+  return slot >= 0 ? index[slot].node : CACHE_NO_NODE;
+}
+
+void ResourceCache::indexInsert(uint32_t hash, uint16_t node) {
+  const uint32_t mask = CACHE_INDEX_SLOTS - 1;
+  uint32_t slot = hash & mask;
+  while (index[slot].node != CACHE_NO_NODE) {
+    slot = (slot + 1) & mask;
+  }
+  index[slot].hash = hash;
+  index[slot].node = node;
+}
+
+void ResourceCache::indexRemoveSlot(int slot) {
+  // Backward-shift deletion keeps probe chains intact without tombstones
+  const uint32_t mask = CACHE_INDEX_SLOTS - 1;
+  uint32_t hole = slot;
+  uint32_t current = (hole + 1) & mask;
   
-  return false;
+  while (index[current].node != CACHE_NO_NODE) {
+    uint32_t home = index[current].hash & mask;
+    if (((current - home) & mask) >= ((current - hole) & mask)) {
+      index[hole] = index[current];
+      hole = current;
+    }
+    current = (current + 1) & mask;
+  }
+  
+  index[hole].hash = 0;
+  index[hole].node = CACHE_NO_NODE;
+}
+
+uint16_t ResourceCache::allocateNode() {
+  uint16_t node = freeHead;
+  if (node != CACHE_NO_NODE) {
+    freeHead = nodes[node].next;
+    nodes[node].prev = CACHE_NO_NODE;
+    nodes[node].next = CACHE_NO_NODE;
+  }
+  return node;
+}
+
+void ResourceCache::releaseNode(uint16_t node) {
+  if (nodes[node].data != nullptr) {
+    VRAM_FREE(nodes[node].data);
+    nodes[node].data = nullptr;
+  }
+  nodes[node].resourceId[0] = '\0';
+  nodes[node].dataLength = 0;
+  nodes[node].prev = CACHE_NO_NODE;
+  nodes[node].next = freeHead;
+  freeHead = node;
+}
+
+char* ResourceCache::copyPayload(const String& data) {
+  char* payload = (char*)VRAM_MALLOC(data.length() + 1, "cache");
+  if (payload != nullptr) {
+    memcpy(payload, data.c_str(), data.length() + 1);
+  }
+  return payload;
+}
+
+bool ResourceCache::evictNode(uint16_t node) {
+  // The pin check must sit inside the write section, see pinNode()
+  beginWrite();
+  bool evictable = (nodes[node].pinCount == 0);
+  if (evictable) {
+    removeNode(node);
+  }
+  endWrite();
+  return evictable;
+}
+
+bool ResourceCache::secondChance(uint16_t node) {
+  if (!nodes[node].referenced) {
+    return false;
+  }
+  nodes[node].referenced = false;
+  moveToHead(node);
+  return true;
 }
 
-size_t ResourceCache::calculateEntrySize(const String& data) {
-  return data.length() + sizeof(CacheEntry);
+void ResourceCache::removeNode(uint16_t node) {
+  // Callers are inside a write section
+  CacheEntry* entry = &nodes[node];
+  
+  int slot = findSlot(entry->resourceId, entry->keyHash);
+  if (slot >= 0) {
+    indexRemoveSlot(slot);
+  }
+  
+  totalCacheSize -= (entry->size + CACHE_ENTRY_OVERHEAD);
+  totalEntries--;
+  
+  removeEntry(node);
+  releaseNode(node);
 }
 
-void ResourceCache::moveToHead(CacheEntry* entry) {
-  if (entry == head) return;
+void ResourceCache::moveToHead(uint16_t node) {
+  if (node == head) return;
   
-  removeEntry(entry);
-  addToHead(entry);
+  removeEntry(node);
+  addToHead(node);
 }
 
-void ResourceCache::removeEntry(CacheEntry* entry) {
-  if (entry->prev) {
-    entry->prev->next = entry->next;
+void ResourceCache::removeEntry(uint16_t node) {
+  CacheEntry* entry = &nodes[node];
+  
+  if (entry->prev != CACHE_NO_NODE) {
+    nodes[entry->prev].next = entry->next;
   } else {
     head = entry->next;
   }
   
-  if (entry->next) {
-    entry->next->prev = entry->prev;
+  if (entry->next != CACHE_NO_NODE) {
+    nodes[entry->next].prev = entry->prev;
   } else {
     tail = entry->prev;
   }
 }
 
-void ResourceCache::addToHead(CacheEntry* entry) {
-  entry->prev = nullptr;
+void ResourceCache::addToHead(uint16_t node) {
+  CacheEntry* entry = &nodes[node];
+  entry->prev = CACHE_NO_NODE;
   entry->next = head;
   
-  if (head) {
-    head->prev = entry;
+  if (head != CACHE_NO_NODE) {
+    nodes[head].prev = node;
   }
-  head = entry;
+  head = node;
   
-  if (!tail) {
-    tail = entry;
+  if (tail == CACHE_NO_NODE) {
+    tail = node;
   }
 }
 
-CacheEntry* ResourceCache::removeTail() {
-  if (!tail) return nullptr;
+void ResourceCache::unpin(uint16_t node) {
+  nodes[node].pinCount--;
+}
+
+ResourceView::ResourceView(ResourceView&& other)
+  : cache(other.cache), node(other.node), payload(other.payload), payloadLength(other.payloadLength) {
+  other.cache = nullptr;
+  other.payload = nullptr;
+  other.payloadLength = 0;
+}
+
+ResourceView& ResourceView::operator=(ResourceView&& other) {
+  if (this != &other) {
+    release();
+    cache = other.cache;
+    node = other.node;
+    payload = other.payload;
+    payloadLength = other.payloadLength;
+    other.cache = nullptr;
+    other.payload = nullptr;
+    other.payloadLength = 0;
+  }
+  return *this;
+}
+
+void ResourceView::release() {
+  if (cache != nullptr) {
+    cache->unpin(node);
+    cache = nullptr;
+  }
+  payload = nullptr;
+  payloadLength = 0;
+}
+
+uint16_t ResourceCache::removeTail() {
+  if (tail == CACHE_NO_NODE) return CACHE_NO_NODE;
   
-  CacheEntry* lastEntry = tail;
+  uint16_t lastEntry = tail;
   removeEntry(lastEntry);
   return lastEntry;
 }
 
 void ResourceCache::printCacheStats() {
+  VramLock guard(mutex);
   Serial.println("\n=== Cache Statistics ===");
-  Serial.printf("Entries: %d\n", totalEntries);
+  Serial.printf("Entries: %d / %d\n", totalEntries, CACHE_MAX_ENTRIES);
   Serial.printf("Cache Size: %d / %d bytes (%.1f%%)\n", 
                 totalCacheSize, maxCacheSize, getCacheUtilization() * 100);
-  Serial.printf("Cache Hits: %d\n", cacheHits);
-  Serial.printf("Cache Misses: %d\n", cacheMisses);
+  Serial.printf("Cache Hits: %d\n", cacheHits.load());
+  Serial.printf("Cache Misses: %d\n", cacheMisses.load());
   Serial.printf("Hit Rate: %.1f%%\n", getHitRate() * 100);
   Serial.printf("Evictions: %d\n", evictions);
+  Serial.printf("Admission Rejects: %d (%s)\n", admissionRejects, policy->name());
+  Serial.printf("Compactions: %d (%d payloads moved)\n", compactions, relocations);
+  psram.printStats();
+  flash.printStats();
   
   Serial.println("\n=== Cached Resources ===");
-  CacheEntry* current = head;
+  uint16_t current = head;
   int index = 0;
-  while (current != nullptr && index < 10) {  // Show first 10
-    unsigned long age = millis() - current->createTime;
-    unsigned long lastAccess = millis() - current->accessTime;
+  while (current != CACHE_NO_NODE && index < 10) {  // Show first 10
+    CacheEntry* entry = &nodes[current];
+    unsigned long age = millis() - entry->createTime;
+    unsigned long lastAccess = millis() - entry->accessTime;
     
     Serial.printf("%d. %s (%d bytes, P%d, age: %lums, last: %lums, hits: %d)\n",
-                  ++index, current->resourceId.c_str(), current->size, 
-                  current->priority, age, lastAccess, current->accessCount);
-    current = current->next;
+                  ++index, entry->resourceId, entry->size,
+                  entry->priority, age, lastAccess, entry->accessCount.load());
+    current = entry->next;
   }
   Serial.println("========================\n");
 }
 
 void ResourceCache::resetStats() {
+  VramLock guard(mutex);
   cacheHits = 0;
   cacheMisses = 0;
   evictions = 0;
-  Serial.println("Cache statistics reset");
+  admissionRejects = 0;
+  compactions = 0;
+  relocations = 0;
+  psram.resetStats();
+  VRAM_LOGI("cache", "Cache statistics reset");
 }
 
 void ResourceCache::cleanupExpired(unsigned long maxAge) {
-  CacheEntry* current = tail;
+  VramLock guard(mutex);
+  uint16_t current = tail;
   int cleaned = 0;
   
-  while (current != nullptr) {
-    CacheEntry* prev = current->prev;
-    unsigned long age = millis() - current->accessTime;
+  while (current != CACHE_NO_NODE) {
+    CacheEntry* entry = &nodes[current];
+    uint16_t prev = entry->prev;
+    unsigned long age = millis() - entry->accessTime;
     
-    // Remove expired non-critical resources
-    if (age > maxAge && current->priority > PRIORITY_CRITICAL) {
-      String resourceId = current->resourceId;
-      remove(resourceId);
+    // Remove expired non-critical resources that are not in use
+    if (age > maxAge && entry->priority > PRIORITY_CRITICAL && evictNode(current)) {
       cleaned++;
     }
     
@@ -444,29 +1400,38 @@ void ResourceCache::cleanupExpired(unsigned long maxAge) {
   }
   
   if (cleaned > 0) {
-    Serial.printf("Cleaned up %d expired resources\n", cleaned);
+    VRAM_LOGI("cache", "Cleaned up %d expired resources", cleaned);
   }
 }
 
 std::vector<String> ResourceCache::getResourcesByPriority(int priority) {
+  VramLock guard(mutex);
   std::vector<String> resources;
   
-  CacheEntry* current = head;
-  while (current != nullptr) {
-    if (current->priority == priority) {
-      resources.push_back(current->resourceId);
+  uint16_t current = head;
+  while (current != CACHE_NO_NODE) {
+    if (nodes[current].priority == priority) {
+      resources.push_back(String(nodes[current].resourceId));
     }
-    current = current->next;
+    current = nodes[current].next;
   }
   
   return resources;
 }
 
 void ResourceCache::updatePriority(const String& resourceId, int newPriority) {
-  auto it = cacheMap.find(resourceId);
-  if (it != cacheMap.end()) {
-    it->second->priority = newPriority;
-    Serial.printf("Updated priority for %s to %d\n", resourceId.c_str(), newPriority);
+  VramLock guard(mutex);
+  uint16_t node = findNode(resourceId);
+  if (node != CACHE_NO_NODE) {
+    nodes[node].priority = newPriority;
+    VRAM_LOGD("cache", "Updated priority for %s to %d", resourceId.c_str(), newPriority);
+    persist(node);
+    return;
+  }
+  
+  TierEntry* demoted = psram.find(resourceId.c_str(), hashKey(resourceId.c_str()));
+  if (demoted != nullptr) {
+    demoted->priority = newPriority;
   }
 }
 
@@ -0,0 +1,995 @@
+/*
+ * Resource Loader for VRAM System
+ * Streams resource downloads straight into a cache reservation, decoding
+ * the JSON envelope on the fly instead of buffering the whole response
+ */
+
+#ifndef RESOURCE_LOADER_H
+#define RESOURCE_LOADER_H
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <mbedtls/sha256.h>
+#include "http_session.h"
+#include "resource_cache.h"
+#include "gzip_inflater.h"
+#include "load_metrics.h"
+#include "vram_log.h"
+
+// Loader configuration
+#define LOADER_CHUNK_SIZE     512         // Bytes read from the socket per pass
+#define LOADER_READ_TIMEOUT   10000       // Max silence while streaming (ms)
+#define LOADER_KEY_LENGTH     16          // Longest envelope key we need to match
+#define LOADER_DRAIN_LIMIT    2048        // Unread bytes worth skipping to keep the connection
+#define LOADER_FRAME_LINE     160         // Longest batch frame header line
+
+// Body encodings, besides the INFLATE_FORMAT_* ones
+#define LOADER_FORMAT_NONE        -1
+#define LOADER_FORMAT_UNSUPPORTED -2
+
+// Envelope parser states
+enum LoaderState {
+  LOADER_EXPECT_OBJECT,
+  LOADER_EXPECT_KEY,
+  LOADER_IN_KEY,
+  LOADER_EXPECT_COLON,
+  LOADER_EXPECT_VALUE,
+  LOADER_IN_DATA,
+  LOADER_IN_RAW,
+  LOADER_IN_INFLATE,
+  LOADER_SKIP_STRING,
+  LOADER_SKIP_NESTED,
+  LOADER_SKIP_LITERAL,
+  LOADER_DONE,
+  LOADER_FAILED
+};
+
+// One resource of a batch request
+struct BatchItem {
+  String resourceId;
+  int priority;
+  int version;               // Out: server version
+  int status;                // Out: 200 stored, 304 cached copy current, 404 unknown, 0 not stored
+};
+
+class ResourceLoader {
+private:
+  ResourceCache& cache;
+  HttpSession& session;
+  CacheReservation reservation;
+  GzipInflater inflater;
+  LoadMetrics* metrics;
+  int priority;
+  
+  // Parser state
+  LoaderState state;
+  char key[LOADER_KEY_LENGTH];
+  uint8_t keyLength;
+  bool escaped;
+  bool inNestedString;
+  int nestedDepth;
+  bool compressed;
+  uint8_t unicodeDigits;       // Remaining hex digits of a \uXXXX escape
+  uint32_t unicodeValue;
+  uint32_t highSurrogate;
+  
+  // Transfer state
+  int contentLength;
+  size_t consumed;
+  size_t written;
+  
+  // Stage timing of the current transfer (us)
+  uint32_t bodyStart;
+  uint32_t decodeTime;
+  uint32_t insertTime;
+  bool decoded;
+  
+  // Last transfer results
+  int lastHttpCode;
+  size_t lastSize;
+  bool lastCompressed;
+  bool lastPatched;
+  int lastVersion;
+  String lastHash;
+  String lastHints;
+  
+  void resetParser();
+  void beginStages();
+  void endStages();
+  bool reserveEntry(size_t size, const char* resourceId);
+  bool commitEntry(const String& resourceId, size_t length);
+  void validateEntry(const String& resourceId, int version, const char* hash);
+  void pump(const String& resourceId, size_t bodyEnd);
+  void finish();
+  bool revalidated(HTTPClient& http, const String& resourceId, int resourcePriority);
+  bool receive(uint8_t* target, size_t bytes);
+  bool skip(size_t bytes) { return receive(nullptr, bytes); }
+  bool readLine(char* line, size_t size);
+  bool applyHunks(const String& resourceId, size_t& length);
+  static bool matchesHash(const char* data, size_t length, const String& hash);
+  bool beginBody(const String& resourceId, size_t resourceSize, int format);
+  bool commitBody(const String& resourceId, size_t resourceSize, int format);
+  size_t responseEnd() { return contentLength < 0 ? SIZE_MAX : (size_t)contentLength; }
+  bool framed() { return contentLength >= 0 || session.isChunked(); }   // Body end is known before the close
+  bool waitBody();
+  static int compressionFormat(const char* name);
+  void consume(char c);
+  void consumeData(char c);
+  void beginPayload();
+  void emit(uint8_t value);
+  void emitCodepoint(uint32_t codepoint);
+  bool keyIs(const char* name) { return strcmp(key, name) == 0; }
+  static int hexValue(char c);
+  static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+public:
+  ResourceLoader(ResourceCache& targetCache, HttpSession& httpSession);
+  
+  // Record the time each load spends in every stage; nullptr stops recording
+  void setMetrics(LoadMetrics* loadMetrics) { metrics = loadMetrics; }
+  LoadMetrics* getMetrics() { return metrics; }
+  
+  // Download path and store its "data" field in the cache as resourceId
+  bool fetch(const String& path, const String& resourceId, int resourcePriority);
+  
+  // Download an octet-stream body from the /raw endpoint as resourceId
+  bool fetchRaw(const String& path, const String& resourceId, int resourcePriority);
+  
+  // Download several resources in one framed response from the batch endpoint.
+  // Returns how many items are now cached and current (status 200 or 304).
+  int fetchBatch(const String& path, BatchItem* items, size_t count, bool compress = false);
+  
+  // Bring a cached resource up to date from the delta endpoint, patching its
+  // buffer in place. False when nothing was patched (not cached, base version
+  // no longer kept by the server, ...); fetchRaw() then gets the whole resource.
+  bool fetchDelta(const String& path, const String& resourceId, int resourcePriority);
+  
+  // Last transfer results
+  int getLastHttpCode() { return lastHttpCode; }
+  size_t getLastSize() { return lastSize; }
+  bool wasCompressed() { return lastCompressed; }
+  bool wasPatched() { return lastPatched; }
+  int getLastVersion() { return lastVersion; }
+  const String& getLastHash() { return lastHash; }
+  const String& getLastHints() { return lastHints; }   // Comma-separated likely-next resource IDs
+};
+
+// Implementation
+ResourceLoader::ResourceLoader(ResourceCache& targetCache, HttpSession& httpSession) 
+  : cache(targetCache), session(httpSession) {
+  reservation.buffer = nullptr;
+  reservation.capacity = 0;
+  reservation.accounted = 0;
+  metrics = nullptr;
+  priority = PRIORITY_NORMAL;
+  contentLength = -1;
+  consumed = 0;
+  written = 0;
+  lastHttpCode = 0;
+  lastSize = 0;
+  lastCompressed = false;
+  lastPatched = false;
+  lastVersion = 0;
+  bodyStart = 0;
+  decodeTime = 0;
+  insertTime = 0;
+  decoded = false;
+  resetParser();
+}
+
+void ResourceLoader::resetParser() {
+  state = LOADER_EXPECT_OBJECT;
+  key[0] = '\0';
+  keyLength = 0;
+  escaped = false;
+  inNestedString = false;
+  nestedDepth = 0;
+  compressed = false;
+  unicodeDigits = 0;
+  unicodeValue = 0;
+  highSurrogate = 0;
+}
+
+bool ResourceLoader::fetch(const String& path, const String& resourceId, int resourcePriority) {
+  priority = resourcePriority;
+  lastSize = 0;
+  lastCompressed = false;
+  
+  lastHttpCode = session.get(path, LOADER_READ_TIMEOUT);
+  HTTPClient& http = session.response();
+  contentLength = http.getSize();  // -1 when the server sent no length
+  consumed = 0;
+  written = 0;
+  beginStages();
+  
+  if (lastHttpCode != HTTP_CODE_OK) {
+    VRAM_LOGW("loader", "HTTP error for resource %s: %d", resourceId.c_str(), lastHttpCode);
+    finish();
+    return false;
+  }
+  
+  resetParser();
+  pump(resourceId, responseEnd());
+  finish();
+  
+  if (state != LOADER_DONE) {
+    VRAM_LOGW("loader", "Incomplete or invalid response for resource %s", resourceId.c_str());
+    cache.abort(reservation);
+    return false;
+  }
+  
+  if (!commitEntry(resourceId, written)) {
+    return false;
+  }
+  endStages();
+  
+  lastSize = written;
+  lastCompressed = compressed;
+  return true;
+}
+
+bool ResourceLoader::fetchRaw(const String& path, const String& resourceId, int resourcePriority) {
+  priority = resourcePriority;
+  lastSize = 0;
+  lastCompressed = false;
+  lastPatched = false;
+  lastHints = "";
+  
+  // A cached copy with a known ETag only needs revalidating
+  String etag = cache.getETag(resourceId);
+  if (etag.length() > 0) {
+    session.addHeader("If-None-Match", "\"" + etag + "\"");
+  }
+  
+  const char* headerKeys[] = {"X-Resource-Size", "X-Resource-Hash", 
+                              "X-Resource-Version", "X-Resource-Compression", "X-Prefetch-Hints"};
+  lastHttpCode = session.get(path, LOADER_READ_TIMEOUT, headerKeys, 5);
+  HTTPClient& http = session.response();
+  contentLength = http.getSize();
+  consumed = 0;
+  written = 0;
+  beginStages();
+  
+  if (lastHttpCode == HTTP_CODE_NOT_MODIFIED) {
+    return revalidated(http, resourceId, resourcePriority);
+  }
+  
+  if (lastHttpCode != HTTP_CODE_OK) {
+    VRAM_LOGW("loader", "HTTP error for resource %s: %d", resourceId.c_str(), lastHttpCode);
+    finish();
+    return false;
+  }
+  
+  String compression = http.header("X-Resource-Compression");
+  int format = compressionFormat(compression.c_str());
+  if (format == LOADER_FORMAT_UNSUPPORTED) {
+    VRAM_LOGW("loader", "Unsupported compression '%s' for resource %s", 
+                        compression.c_str(), resourceId.c_str());
+    finish();
+    return false;
+  }
+  
+  // X-Resource-Size is the original size, so the buffer is reserved before any byte arrives
+  resetParser();
+  size_t resourceSize = http.header("X-Resource-Size").toInt();
+  if (!framed() || (format == LOADER_FORMAT_NONE && contentLength >= 0 && (size_t)contentLength != resourceSize)) {
+    VRAM_LOGW("loader", "Length mismatch for resource %s (%d vs %d bytes)", 
+                        resourceId.c_str(), contentLength, resourceSize);
+    finish();
+    return false;
+  }
+  
+  int version = http.header("X-Resource-Version").toInt();
+  String hash = http.header("X-Resource-Hash");
+  lastHints = http.header("X-Prefetch-Hints");
+  
+  if (!beginBody(resourceId, resourceSize, format)) {
+    finish();
+    return false;
+  }
+  
+  pump(resourceId, responseEnd());
+  finish();
+  
+  if (!commitBody(resourceId, resourceSize, format)) {
+    return false;
+  }
+  validateEntry(resourceId, version, hash.c_str());
+  endStages();
+  
+  lastSize = written;
+  lastCompressed = (format != LOADER_FORMAT_NONE);
+  lastVersion = version;
+  lastHash = hash;
+  return true;
+}
+
+int ResourceLoader::fetchBatch(const String& path, BatchItem* items, size_t count, bool compress) {
+  lastSize = 0;
+  lastCompressed = false;
+  lastHints = "";
+  
+  // Resource IDs are plain names, so the request is built without a JSON library.
+  // Cached items carry their validators so unchanged ones come back as 304 frames.
+  String body = compress ? "{\"compress\":true,\"resources\":[" : "{\"compress\":false,\"resources\":[";
+  for (size_t i = 0; i < count; i++) {
+    items[i].status = 0;
+    items[i].version = 0;
+    if (i > 0) body += ",";
+    body += "{\"id\":\"" + items[i].resourceId + "\",\"version\":" + String(cache.getVersion(items[i].resourceId));
+    String etag = cache.getETag(items[i].resourceId);
+    if (etag.length() > 0) {
+      body += ",\"etag\":\"" + etag + "\"";
+    }
+    body += "}";
+  }
+  body += "]}";
+  
+  const char* headerKeys[] = {"X-Prefetch-Hints"};
+  lastHttpCode = session.post(path, body, "application/json", LOADER_READ_TIMEOUT, headerKeys, 1);
+  HTTPClient& http = session.response();
+  contentLength = http.getSize();
+  consumed = 0;
+  written = 0;
+  beginStages();
+  
+  if (lastHttpCode != HTTP_CODE_OK) {
+    VRAM_LOGW("loader", "HTTP error for batch of %d resources: %d", count, lastHttpCode);
+    finish();
+    return 0;
+  }
+  lastHints = http.header("X-Prefetch-Hints");
+  
+  int delivered = 0;
+  char line[LOADER_FRAME_LINE];
+  
+  // Each frame: "<status> <id> <version> <size> <compression> <length> <hash>\n" + <length> bytes
+  while (consumed < responseEnd() && readLine(line, sizeof(line))) {
+    int status, version;
+    unsigned long resourceSize, length;
+    char id[CACHE_ID_LENGTH];
+    char compression[16];
+    char hash[72] = "-";
+    if (sscanf(line, "%d %31s %d %lu %15s %lu %64s", &status, id, &version, &resourceSize, 
+               compression, &length, hash) < 6) {
+      VRAM_LOGW("loader", "Malformed batch frame: %s", line);
+      break;
+    }
+    
+    BatchItem* item = nullptr;
+    for (size_t i = 0; i < count; i++) {
+      if (items[i].resourceId == id) {
+        item = &items[i];
+        break;
+      }
+    }
+    
+    size_t frameEnd = consumed + length;
+    int format = compressionFormat(compression);
+    bool stored = false;
+    
+    if (item != nullptr && status == HTTP_CODE_OK && format != LOADER_FORMAT_UNSUPPORTED &&
+        (format != LOADER_FORMAT_NONE || length == resourceSize)) {
+      priority = item->priority;
+      if (beginBody(item->resourceId, resourceSize, format)) {
+        pump(item->resourceId, frameEnd);
+        stored = commitBody(item->resourceId, resourceSize, format);
+      }
+    } else if (item != nullptr && status != HTTP_CODE_OK) {
+      item->status = status;
+      if (status == HTTP_CODE_NOT_MODIFIED && cache.touch(item->resourceId)) {
+        cache.updatePriority(item->resourceId, item->priority);
+        item->version = version;
+        delivered++;
+      }
+    }
+    
+    if (stored) {
+      validateEntry(item->resourceId, version, strcmp(hash, "-") != 0 ? hash : "");
+      item->status = status;
+      item->version = version;
+      lastSize += written;
+      lastCompressed = lastCompressed || (format != LOADER_FORMAT_NONE);
+      delivered++;
+      VRAM_LOGD("loader", "Batch item %s stored (%d bytes)", id, written);
+    } else if (status == HTTP_CODE_OK) {
+      VRAM_LOGW("loader", "Batch item %s not stored", id);
+    }
+    
+    // Whatever part of the frame was not consumed is skipped to reach the next header
+    if (consumed < frameEnd && !skip(frameEnd - consumed)) break;
+  }
+  
+  finish();
+  
+  // One sample per response: the transfer covers every frame
+  if (lastSize > 0) {
+    endStages();
+  }
+  return delivered;
+}
+
+bool ResourceLoader::fetchDelta(const String& path, const String& resourceId, int resourcePriority) {
+  priority = resourcePriority;
+  lastSize = 0;
+  lastCompressed = false;
+  lastPatched = false;
+  lastHints = "";
+  
+  // Versions restart when a resource is recreated, so the base is named by its hash too
+  int baseVersion = cache.getVersion(resourceId);
+  if (baseVersion <= 0) {
+    return false;
+  }
+  String query = String(path.indexOf('?') < 0 ? "?from=" : "&from=") + String(baseVersion);
+  String etag = cache.getETag(resourceId);
+  if (etag.length() > 0) {
+    query += "&base=" + etag;
+  }
+  
+  const char* headerKeys[] = {"X-Resource-Size", "X-Resource-Hash", "X-Resource-Version",
+                              "X-Delta-Capacity", "X-Prefetch-Hints"};
+  lastHttpCode = session.get(path + query, LOADER_READ_TIMEOUT, headerKeys, 5);
+  HTTPClient& http = session.response();
+  contentLength = http.getSize();
+  consumed = 0;
+  written = 0;
+  beginStages();
+  
+  if (lastHttpCode == HTTP_CODE_NOT_MODIFIED) {
+    return revalidated(http, resourceId, resourcePriority);
+  }
+  
+  if (lastHttpCode != HTTP_CODE_OK) {
+    // 410 when the server no longer keeps the cached version
+    VRAM_LOGD("loader", "No delta for resource %s from version %d: %d", 
+                        resourceId.c_str(), baseVersion, lastHttpCode);
+    finish();
+    return false;
+  }
+  
+  // X-Delta-Capacity is the largest the buffer gets while the hunks are applied
+  size_t resourceSize = http.header("X-Resource-Size").toInt();
+  size_t capacity = http.header("X-Delta-Capacity").toInt();
+  int version = http.header("X-Resource-Version").toInt();
+  String hash = http.header("X-Resource-Hash");
+  lastHints = http.header("X-Prefetch-Hints");
+  if (!framed() || capacity < resourceSize || hash.length() == 0) {
+    VRAM_LOGW("loader", "Invalid delta response for resource %s", resourceId.c_str());
+    finish();
+    return false;
+  }
+  
+  size_t length;
+  uint32_t checkoutStart = micros();
+  bool checkedOut = cache.checkout(resourceId, capacity, reservation, length);
+  insertTime += micros() - checkoutStart;
+  if (!checkedOut) {
+    finish();
+    return false;
+  }
+  
+  bool applied = applyHunks(resourceId, length);
+  finish();
+  
+  // A wrong base or a broken transfer must not survive as the cached copy
+  if (!applied || length != resourceSize || !matchesHash(reservation.buffer, length, hash)) {
+    VRAM_LOGW("loader", "Delta for resource %s did not apply, cached copy dropped", resourceId.c_str());
+    cache.abort(reservation);
+    return false;
+  }
+  
+  if (!commitEntry(resourceId, length)) {
+    return false;
+  }
+  validateEntry(resourceId, version, hash.c_str());
+  endStages();
+  
+  VRAM_LOGD("loader", "Patched %s to version %d (%d of %d bytes sent)", 
+                      resourceId.c_str(), version, contentLength, length);
+  lastSize = length;
+  lastPatched = true;
+  lastVersion = version;
+  lastHash = hash;
+  return true;
+}
+
+bool ResourceLoader::revalidated(HTTPClient& http, const String& resourceId, int resourcePriority) {
+  contentLength = 0;  // A 304 never has a body, whatever its headers say
+  lastVersion = http.header("X-Resource-Version").toInt();
+  lastHints = http.header("X-Prefetch-Hints");
+  finish();
+  if (!cache.touch(resourceId)) {
+    return false;
+  }
+  // A prefetched copy takes on the priority it is now wanted at
+  cache.updatePriority(resourceId, resourcePriority);
+  return true;
+}
+
+bool ResourceLoader::applyHunks(const String& resourceId, size_t& length) {
+  char* buffer = reservation.buffer;
+  char line[LOADER_FRAME_LINE];
+  
+  // Each hunk: "<offset> <delete> <insert>\n" + <insert> bytes. Offsets are into the
+  // buffer as patched so far, so hunks apply in order with no second copy.
+  while (consumed < responseEnd() && waitBody()) {
+    unsigned long offset, removed, inserted;
+    if (!readLine(line, sizeof(line)) ||
+        sscanf(line, "%lu %lu %lu", &offset, &removed, &inserted) != 3) {
+      VRAM_LOGW("loader", "Malformed delta hunk for resource %s", resourceId.c_str());
+      return false;
+    }
+    if (offset > length || removed > length - offset || 
+        inserted > reservation.capacity - (length - removed)) {
+      VRAM_LOGW("loader", "Delta hunk out of range for resource %s", resourceId.c_str());
+      return false;
+    }
+    
+    // Shift the tail to its new place, then stream the new bytes into the gap
+    memmove(buffer + offset + inserted, buffer + offset + removed, length - offset - removed);
+    length = length - removed + inserted;
+    if (!receive((uint8_t*)buffer + offset, inserted)) {
+      return false;
+    }
+  }
+  return contentLength >= 0 ? consumed == (size_t)contentLength : session.bodyComplete();
+}
+
+bool ResourceLoader::matchesHash(const char* data, size_t length, const String& hash) {
+  uint8_t digest[32];
+  char hex[sizeof(digest) * 2 + 1];
+  mbedtls_sha256((const unsigned char*)data, length, digest, 0);
+  for (size_t i = 0; i < sizeof(digest); i++) {
+    sprintf(hex + i * 2, "%02x", digest[i]);
+  }
+  return hash == hex;
+}
+
+bool ResourceLoader::beginBody(const String& resourceId, size_t resourceSize, int format) {
+  if (!reserveEntry(resourceSize, resourceId.c_str())) {
+    return false;
+  }
+  
+  written = 0;
+  state = (resourceSize == 0) ? LOADER_DONE : LOADER_IN_RAW;
+  
+  // Compressed bodies inflate chunk by chunk into the same reservation
+  if (format != LOADER_FORMAT_NONE) {
+    if (!inflater.begin((uint8_t*)reservation.buffer, resourceSize, format)) {
+      cache.abort(reservation);
+      return false;
+    }
+    state = LOADER_IN_INFLATE;
+  }
+  return true;
+}
+  
+bool ResourceLoader::commitBody(const String& resourceId, size_t resourceSize, int format) {
+  if (format != LOADER_FORMAT_NONE) {
+    inflater.end();
+    if (state == LOADER_DONE && written != resourceSize) {
+      VRAM_LOGW("loader", "Inflated %d bytes, expected %d", written, resourceSize);
+      state = LOADER_FAILED;
+    }
+  }
+  
+  if (state != LOADER_DONE) {
+    VRAM_LOGW("loader", "Incomplete response for resource %s (%d of %d bytes)", 
+                        resourceId.c_str(), written, resourceSize);
+    cache.abort(reservation);
+    return false;
+  }
+  
+  return commitEntry(resourceId, written);
+}
+
+void ResourceLoader::beginStages() {
+  bodyStart = micros();
+  decodeTime = 0;
+  insertTime = 0;
+  decoded = false;
+  
+  if (metrics == nullptr || lastHttpCode <= 0) return;
+  if (session.getLastConnectTime() > 0) {
+    metrics->record(STAGE_CONNECT, session.getLastConnectTime());
+  }
+  metrics->record(STAGE_FIRST_BYTE, session.getLastResponseTime());
+}
+
+void ResourceLoader::endStages() {
+  if (metrics == nullptr) return;
+  
+  // Whatever the body took beyond decoding and the cache was the network
+  uint32_t elapsed = micros() - bodyStart;
+  uint32_t local = decodeTime + insertTime;
+  metrics->record(STAGE_TRANSFER, elapsed > local ? elapsed - local : 0);
+  if (decoded) {
+    metrics->record(STAGE_DECODE, decodeTime);
+  }
+  metrics->record(STAGE_CACHE_INSERT, insertTime);
+}
+
+bool ResourceLoader::reserveEntry(size_t size, const char* resourceId) {
+  uint32_t start = micros();
+  bool reserved = cache.reserve(size, priority, reservation, resourceId);
+  insertTime += micros() - start;
+  return reserved;
+}
+
+bool ResourceLoader::commitEntry(const String& resourceId, size_t length) {
+  uint32_t start = micros();
+  bool committed = cache.commit(resourceId, reservation, length, priority);
+  insertTime += micros() - start;
+  return committed;
+}
+
+void ResourceLoader::validateEntry(const String& resourceId, int version, const char* hash) {
+  // Persisting a critical resource to flash happens here
+  uint32_t start = micros();
+  cache.setValidator(resourceId, version, hash);
+  insertTime += micros() - start;
+}
+
+int ResourceLoader::compressionFormat(const char* name) {
+  if (name[0] == '\0' || strcmp(name, "none") == 0) return LOADER_FORMAT_NONE;
+  if (strcmp(name, "gzip") == 0) return INFLATE_FORMAT_GZIP;
+  if (strcmp(name, "deflate") == 0) return INFLATE_FORMAT_DEFLATE;
+  return LOADER_FORMAT_UNSUPPORTED;
+}
+
+void ResourceLoader::pump(const String& resourceId, size_t bodyEnd) {
+  uint8_t chunk[LOADER_CHUNK_SIZE];
+  unsigned long lastData = millis();
+  
+  while (state != LOADER_DONE && state != LOADER_FAILED) {
+    if (consumed >= bodyEnd) break;
+    
+    size_t available = session.available();
+    if (available == 0) {
+      if (!session.bodyPending()) break;
+      if (millis() - lastData > LOADER_READ_TIMEOUT) {
+        VRAM_LOGW("loader", "Timed out streaming resource %s", resourceId.c_str());
+        break;
+      }
+      delay(1);
+      continue;
+    }
+    
+    // Never read past the body, which may be one frame of a larger response
+    if (available > bodyEnd - consumed) available = bodyEnd - consumed;
+    
+    if (state == LOADER_IN_RAW) {
+      // Raw bodies are read straight into the reservation
+      size_t room = reservation.capacity - written;
+      int count = session.read((uint8_t*)reservation.buffer + written,
+                               available < room ? available : room);
+      lastData = millis();
+      written += count;
+      consumed += count;
+      if (written == reservation.capacity) state = LOADER_DONE;
+      continue;
+    }
+    
+    int count = session.read(chunk, available < sizeof(chunk) ? available : sizeof(chunk));
+    lastData = millis();
+    
+    // Reserving the payload buffer happens mid-envelope and is not decoding
+    uint32_t decodeStart = micros();
+    uint32_t insertBefore = insertTime;
+    decoded = true;
+    
+    if (state == LOADER_IN_INFLATE) {
+      consumed += count;
+      if (!inflater.feed(chunk, count)) {
+        state = LOADER_FAILED;
+      } else if (inflater.isDone()) {
+        state = LOADER_DONE;
+      }
+      written = inflater.getOutputLength();
+    } else {
+      int i = 0;
+      for (; i < count && state != LOADER_DONE && state != LOADER_FAILED; i++) {
+        consumed++;
+        consume((char)chunk[i]);
+      }
+      // Bytes read past the end of the envelope are still this body's
+      consumed += count - i;
+    }
+    decodeTime += (micros() - decodeStart) - (insertTime - insertBefore);
+  }
+}
+
+void ResourceLoader::finish() {
+  size_t remaining = 0;
+  if (contentLength >= 0 && consumed < (size_t)contentLength) {
+    remaining = contentLength - consumed;
+  }
+  
+  // A chunked body ends with its last chunk; without one, a missing length
+  // means the body runs to the close
+  if (contentLength < 0) {
+    if (session.drain(LOADER_DRAIN_LIMIT)) {
+      session.end();
+    } else {
+      session.close();
+    }
+    return;
+  }
+  
+  // With too much left, the stream cannot be resynchronised cheaply
+  if (remaining > LOADER_DRAIN_LIMIT) {
+    session.close();
+    return;
+  }
+  
+  // Skip the rest of the body so the next response starts on a clean boundary
+  if (skip(remaining)) {
+    session.end();
+  } else {
+    session.close();
+  }
+}
+
+bool ResourceLoader::waitBody() {
+  // False at the end of the body as well as on a timeout
+  unsigned long start = millis();
+  while (session.available() == 0) {
+    if (!session.bodyPending() || millis() - start > LOADER_READ_TIMEOUT) return false;
+    delay(1);
+  }
+  return true;
+}
+
+bool ResourceLoader::receive(uint8_t* target, size_t bytes) {
+  uint8_t chunk[64];
+  unsigned long lastData = millis();
+  
+  // Without a target the bytes are skipped
+  while (bytes > 0) {
+    size_t available = session.available();
+    if (available == 0) {
+      if (!session.bodyPending() || millis() - lastData > LOADER_READ_TIMEOUT) return false;
+      delay(1);
+      continue;
+    }
+    if (target == nullptr && available > sizeof(chunk)) available = sizeof(chunk);
+    if (available > bytes) available = bytes;
+    size_t count = session.read(target != nullptr ? target : chunk, available);
+    if (target != nullptr) target += count;
+    bytes -= count;
+    consumed += count;
+    lastData = millis();
+  }
+  return true;
+}
+  
+bool ResourceLoader::readLine(char* line, size_t size) {
+  size_t length = 0;
+  unsigned long lastData = millis();
+  
+  while (consumed < responseEnd()) {
+    if (session.available() == 0) {
+      if (!session.bodyPending() || millis() - lastData > LOADER_READ_TIMEOUT) return false;
+      delay(1);
+      continue;
+    }
+    int c = session.read();
+    consumed++;
+    lastData = millis();
+    
+    if (c == '\n') {
+      line[length] = '\0';
+      return true;
+    }
+    if (length >= size - 1) {
+      VRAM_LOGW("loader", "Frame header line too long");
+      return false;
+    }
+    line[length++] = c;
+  }
+  return false;
+}
+
+void ResourceLoader::consume(char c) {
+  switch (state) {
+    case LOADER_EXPECT_OBJECT:
+      if (c == '{') state = LOADER_EXPECT_KEY;
+      break;
+    
+    case LOADER_EXPECT_KEY:
+      if (c == '"') {
+        keyLength = 0;
+        key[0] = '\0';
+        escaped = false;
+        state = LOADER_IN_KEY;
+      } else if (c == '}') {
+        // Envelope ended without a "data" field
+        state = LOADER_FAILED;
+      }
+      break;
+    
+    case LOADER_IN_KEY:
+      if (escaped) {
+        escaped = false;
+      } else if (c == '\\') {
+        escaped = true;
+        break;
+      } else if (c == '"') {
+        state = LOADER_EXPECT_COLON;
+        break;
+      }
+      if (keyLength < LOADER_KEY_LENGTH - 1) {
+        key[keyLength++] = c;
+        key[keyLength] = '\0';
+      }
+      break;
+    
+    case LOADER_EXPECT_COLON:
+      if (c == ':') state = LOADER_EXPECT_VALUE;
+      break;
+    
+    case LOADER_EXPECT_VALUE:
+      if (isSpace(c)) break;
+      escaped = false;
+      if (c == '"' && keyIs("data")) {
+        beginPayload();
+      } else if (c == '"') {
+        state = LOADER_SKIP_STRING;
+      } else if (c == '{' || c == '[') {
+        nestedDepth = 1;
+        inNestedString = false;
+        state = LOADER_SKIP_NESTED;
+      } else {
+        // Flask sorts keys, so "compressed" always precedes "data"
+        if (keyIs("compressed")) compressed = (c == 't');
+        state = LOADER_SKIP_LITERAL;
+      }
+      break;
+    
+    case LOADER_SKIP_STRING:
+      if (escaped) {
+        escaped = false;
+      } else if (c == '\\') {
+        escaped = true;
+      } else if (c == '"') {
+        state = LOADER_EXPECT_KEY;
+      }
+      break;
+    
+    case LOADER_SKIP_NESTED:
+      if (inNestedString) {
+        if (escaped) escaped = false;
+        else if (c == '\\') escaped = true;
+        else if (c == '"') inNestedString = false;
+      } else if (c == '"') {
+        inNestedString = true;
+      } else if (c == '{' || c == '[') {
+        nestedDepth++;
+      } else if ((c == '}' || c == ']') && --nestedDepth == 0) {
+        state = LOADER_EXPECT_KEY;
+      }
+      break;
+    
+    case LOADER_SKIP_LITERAL:
+      if (c == ',') state = LOADER_EXPECT_KEY;
+      else if (c == '}') state = LOADER_FAILED;
+      break;
+    
+    case LOADER_IN_DATA:
+      consumeData(c);
+      break;
+    
+    default:
+      break;
+  }
+}
+
+void ResourceLoader::beginPayload() {
+  // Hex-encoded gzip in JSON is only kept for older clients; fetchRaw() inflates
+  if (compressed) {
+    VRAM_LOGW("loader", "Compressed JSON payloads are not supported, use the raw endpoint");
+    state = LOADER_FAILED;
+    return;
+  }
+  
+  // What is left of the response bounds the decoded payload
+  size_t capacity = MAX_RESOURCE_SIZE;
+  if (contentLength >= 0) {
+    size_t remaining = (size_t)contentLength - consumed;
+    if (remaining < capacity) capacity = remaining;
+  }
+  
+  if (!reserveEntry(capacity, nullptr)) {
+    state = LOADER_FAILED;
+    return;
+  }
+  written = 0;
+  state = LOADER_IN_DATA;
+}
+
+void ResourceLoader::consumeData(char c) {
+  if (unicodeDigits > 0) {
+    int digit = hexValue(c);
+    if (digit < 0) {
+      state = LOADER_FAILED;
+      return;
+    }
+    unicodeValue = (unicodeValue << 4) | digit;
+    if (--unicodeDigits == 0) {
+      if (unicodeValue >= 0xD800 && unicodeValue <= 0xDBFF) {
+        highSurrogate = unicodeValue;  // Wait for the low half
+      } else if (unicodeValue >= 0xDC00 && unicodeValue <= 0xDFFF && highSurrogate != 0) {
+        emitCodepoint(0x10000 + ((highSurrogate - 0xD800) << 10) + (unicodeValue - 0xDC00));
+        highSurrogate = 0;
+      } else {
+        emitCodepoint(unicodeValue);
+      }
+    }
+    return;
+  }
+  
+  if (escaped) {
+    escaped = false;
+    char decoded;
+    switch (c) {
+      case 'n': decoded = '\n'; break;
+      case 'r': decoded = '\r'; break;
+      case 't': decoded = '\t'; break;
+      case 'b': decoded = '\b'; break;
+      case 'f': decoded = '\f'; break;
+      case 'u':
+        unicodeDigits = 4;
+        unicodeValue = 0;
+        return;
+      default: decoded = c; break;  // \" \\ \/
+    }
+    emit(decoded);
+    return;
+  }
+  
+  if (c == '\\') {
+    escaped = true;
+  } else if (c == '"') {
+    state = LOADER_DONE;
+  } else {
+    emit(c);
+  }
+}
+
+void ResourceLoader::emit(uint8_t value) {
+  if (state == LOADER_FAILED) return;
+  if (written >= reservation.capacity) {
+    VRAM_LOGW("loader", "Payload exceeds reserved %d bytes", reservation.capacity);
+    state = LOADER_FAILED;
+    return;
+  }
+  reservation.buffer[written++] = value;
+}
+
+void ResourceLoader::emitCodepoint(uint32_t codepoint) {
+  if (codepoint < 0x80) {
+    emit(codepoint);
+  } else if (codepoint < 0x800) {
+    emit(0xC0 | (codepoint >> 6));
+    emit(0x80 | (codepoint & 0x3F));
+  } else if (codepoint < 0x10000) {
+    emit(0xE0 | (codepoint >> 12));
+    emit(0x80 | ((codepoint >> 6) & 0x3F));
+    emit(0x80 | (codepoint & 0x3F));
+  } else {
+    emit(0xF0 | (codepoint >> 18));
+    emit(0x80 | ((codepoint >> 12) & 0x3F));
+    emit(0x80 | ((codepoint >> 6) & 0x3F));
+    emit(0x80 | (codepoint & 0x3F));
+  }
+}
+
+int ResourceLoader::hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+#endif // RESOURCE_LOADER_H
\ No newline at end of file
@@ -0,0 +1,325 @@
+/*
+ * Resource Manifest for VRAM System
+ * Binary listing of every resource on the server, searched in place so
+ * downloads can be judged by size before they start
+ */
+
+#ifndef RESOURCE_MANIFEST_H
+#define RESOURCE_MANIFEST_H
+
+#include <Arduino.h>
+#include "http_session.h"
+#include "memory_manager.h"
+#include "vram_log.h"
+
+// Manifest configuration; server/resource_manifest.py writes the same layout
+#define MANIFEST_PATH             "/api/manifest"
+#define MANIFEST_MAGIC            0x464D5256u   // "VRMF" read little-endian
+#define MANIFEST_FORMAT           1
+#define MANIFEST_MAX_RECORDS      1024          // server/resource_manifest.py refuses larger catalogs...
+#define MANIFEST_MAX_NAMES        2048          // ...and more bytes of category names
+#define MANIFEST_MAX_SIZE         (sizeof(ManifestHeader) + MANIFEST_MAX_RECORDS * sizeof(ManifestRecord) + MANIFEST_MAX_NAMES)
+#define MANIFEST_TIMEOUT          5000
+#define MANIFEST_ETAG_LENGTH      17            // Server ETag, NUL included
+#define MANIFEST_REFRESH_INTERVAL 300000        // Revalidated this often (ms)...
+#define MANIFEST_REFRESH_HOLDOFF  5000          // ...and this long after the catalog last changed
+
+// Fixed-width layout, little-endian like the ESP32, so fields are read straight from the buffer
+struct ManifestHeader {
+  uint32_t magic;
+  uint8_t format;
+  uint8_t recordSize;
+  uint16_t recordCount;
+  uint16_t categoryCount;   // NUL-terminated names follow the records
+  uint16_t reserved;
+  uint32_t totalSize;       // Bytes of every resource listed
+};
+
+struct ManifestRecord {
+  uint32_t idHash;          // FNV-1a of the resource ID; records are sorted by it
+  uint32_t size;            // Uncompressed bytes
+  uint32_t version;
+  uint8_t priority;
+  uint8_t category;         // Index into the category names
+  uint16_t reserved;
+};
+
+static_assert(sizeof(ManifestHeader) == 16 && sizeof(ManifestRecord) == 16,
+              "Manifest structs must match the wire layout");
+
+// Manifest statistics
+struct ManifestStats {
+  unsigned long fetches;
+  unsigned long notModified;
+  unsigned long failed;
+  unsigned long lookups;
+  unsigned long hits;
+  int lastHttpCode;
+};
+
+// The whole manifest is kept as received, in one buffer. It is replaced
+// by the task that fetches it while others look resources up, so lookups
+// copy a record out under the lock instead of handing out pointers.
+class ResourceManifest {
+private:
+  uint8_t* buffer;
+  size_t length;
+  uint16_t recordCount;
+  char etag[MANIFEST_ETAG_LENGTH];
+  unsigned long fetchTime;
+  ManifestStats stats;
+  SemaphoreHandle_t mutex;
+  
+  static uint32_t hashId(const char* resourceId);
+  static bool validate(const uint8_t* data, size_t size);
+  const ManifestRecord* records() const { return (const ManifestRecord*)(buffer + sizeof(ManifestHeader)); }
+  bool readBody(HttpSession& session, uint8_t* target, size_t size);
+
+public:
+  ResourceManifest();
+  ~ResourceManifest();
+  
+  // Fetch or revalidate the manifest; the current one stays on any failure.
+  // Blocks on the network; the async loader runs it on its task.
+  bool fetch(HttpSession& session);
+  
+  // Binary search by ID hash. Two IDs sharing a hash both find the first.
+  bool lookup(const char* resourceId, ManifestRecord& record);
+  bool lookup(const String& resourceId, ManifestRecord& record) { return lookup(resourceId.c_str(), record); }
+  
+  // Walking every record
+  bool isLoaded() { return buffer != nullptr; }
+  uint16_t getRecordCount() { return recordCount; }
+  bool getRecord(uint16_t index, ManifestRecord& record);
+  String getCategory(uint8_t category);
+  size_t getTotalSize();
+  unsigned long getAge() { return buffer != nullptr ? millis() - fetchTime : 0; }
+  
+  // Statistics
+  ManifestStats getStats() { return stats; }
+  void printStats();
+};
+
+// Implementation
+ResourceManifest::ResourceManifest() {
+  buffer = nullptr;
+  length = 0;
+  recordCount = 0;
+  etag[0] = '\0';
+  fetchTime = 0;
+  memset(&stats, 0, sizeof(stats));
+  mutex = xSemaphoreCreateRecursiveMutex();   // Created with the global, first taken by fetch() or a lookup
+}
+
+ResourceManifest::~ResourceManifest() {
+  if (buffer != nullptr) {
+    VRAM_FREE(buffer);
+  }
+}
+
+uint32_t ResourceManifest::hashId(const char* resourceId) {
+  uint32_t hash = 2166136261u;   // FNV-1a, as ResourceCache::hashKey()
+  while (*resourceId) {
+    hash ^= (uint8_t)*resourceId++;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+bool ResourceManifest::validate(const uint8_t* data, size_t size) {
+  const ManifestHeader* header = (const ManifestHeader*)data;
+  if (size < sizeof(ManifestHeader) || header->magic != MANIFEST_MAGIC ||
+      header->format != MANIFEST_FORMAT || header->recordSize != sizeof(ManifestRecord)) {
+    VRAM_LOGW("manifest", "Unsupported manifest format");
+    return false;
+  }
+  
+  size_t namesStart = sizeof(ManifestHeader) + (size_t)header->recordCount * sizeof(ManifestRecord);
+  if (namesStart > size) {
+    VRAM_LOGW("manifest", "Manifest truncated (%d records in %d bytes)", header->recordCount, size);
+    return false;
+  }
+  
+  // Lookups rely on the order, and category indexes on the names being there
+  const ManifestRecord* entries = (const ManifestRecord*)(data + sizeof(ManifestHeader));
+  for (uint16_t i = 0; i < header->recordCount; i++) {
+    if ((i > 0 && entries[i].idHash < entries[i - 1].idHash) || entries[i].category >= header->categoryCount) {
+      VRAM_LOGW("manifest", "Manifest record %d out of order or uncategorised", i);
+      return false;
+    }
+  }
+  
+  size_t offset = namesStart;
+  for (uint16_t i = 0; i < header->categoryCount; i++) {
+    const void* end = (offset < size) ? memchr(data + offset, '\0', size - offset) : nullptr;
+    if (end == nullptr) {
+      VRAM_LOGW("manifest", "Manifest category names truncated");
+      return false;
+    }
+    offset = (const uint8_t*)end - data + 1;
+  }
+  return true;
+}
+
+bool ResourceManifest::readBody(HttpSession& session, uint8_t* target, size_t size) {
+  size_t received = 0;
+  unsigned long lastData = millis();
+  
+  while (received < size) {
+    size_t available = session.available();
+    if (available == 0) {
+      if (!session.bodyPending() || millis() - lastData > MANIFEST_TIMEOUT) return false;
+      delay(1);
+      continue;
+    }
+    if (available > size - received) available = size - received;
+    received += session.read(target + received, available);
+    lastData = millis();
+  }
+  return true;
+}
+
+bool ResourceManifest::fetch(HttpSession& session) {
+  if (etag[0] != '\0') {
+    session.addHeader("If-None-Match", "\"" + String(etag) + "\"");
+  }
+  
+  const char* headerKeys[] = {"ETag"};
+  stats.lastHttpCode = session.get(MANIFEST_PATH, MANIFEST_TIMEOUT, headerKeys, 1);
+  HTTPClient& http = session.response();
+  
+  if (stats.lastHttpCode == HTTP_CODE_NOT_MODIFIED) {
+    session.end();
+    fetchTime = millis();
+    stats.notModified++;
+    return true;
+  }
+  
+  int size = (stats.lastHttpCode == HTTP_CODE_OK) ? http.getSize() : -1;
+  if (size < (int)sizeof(ManifestHeader) || size > (int)MANIFEST_MAX_SIZE) {
+    VRAM_LOGW("manifest", "Manifest fetch failed: HTTP %d, %d bytes", stats.lastHttpCode, size);
+    session.close();   // Whatever body there is goes unread
+    stats.failed++;
+    return false;
+  }
+  
+  // Read into a second buffer, so lookups carry on against the current one
+  uint8_t* incoming = (uint8_t*)VRAM_MALLOC(size, "manifest");
+  if (incoming == nullptr) {
+    VRAM_LOGW("manifest", "No memory for manifest (%d bytes)", size);
+    session.close();
+    stats.failed++;
+    return false;
+  }
+  
+  String receivedTag = http.header("ETag");
+  if (!readBody(session, incoming, size)) {
+    VRAM_LOGW("manifest", "Timed out reading manifest");
+    session.close();
+    VRAM_FREE(incoming);
+    stats.failed++;
+    return false;
+  }
+  session.end();
+  
+  if (!validate(incoming, size)) {
+    VRAM_LOGW("manifest", "Invalid manifest ignored");
+    VRAM_FREE(incoming);
+    stats.failed++;
+    return false;
+  }
+  
+  receivedTag.replace("\"", "");
+  uint8_t* previous;
+  {
+    VramLock guard(mutex);
+    previous = buffer;
+    buffer = incoming;
+    length = size;
+    recordCount = ((const ManifestHeader*)incoming)->recordCount;
+    strncpy(etag, receivedTag.c_str(), MANIFEST_ETAG_LENGTH - 1);
+    etag[MANIFEST_ETAG_LENGTH - 1] = '\0';
+    fetchTime = millis();
+  }
+  if (previous != nullptr) {
+    VRAM_FREE(previous);
+  }
+  
+  stats.fetches++;
+  VRAM_LOGI("manifest", "Manifest: %d resources, %d bytes", recordCount, size);
+  return true;
+}
+
+bool ResourceManifest::lookup(const char* resourceId, ManifestRecord& record) {
+  uint32_t hash = hashId(resourceId);
+  VramLock guard(mutex);
+  stats.lookups++;
+  if (buffer == nullptr) {
+    return false;
+  }
+  
+  // First record whose hash is not below the one wanted
+  const ManifestRecord* entries = records();
+  uint16_t low = 0;
+  uint16_t high = recordCount;
+  while (low < high) {
+    uint16_t middle = low + (high - low) / 2;
+    if (entries[middle].idHash < hash) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  
+  if (low == recordCount || entries[low].idHash != hash) {
+    return false;
+  }
+  record = entries[low];
+  stats.hits++;
+  return true;
+}
+
+bool ResourceManifest::getRecord(uint16_t index, ManifestRecord& record) {
+  VramLock guard(mutex);
+  if (buffer == nullptr || index >= recordCount) {
+    return false;
+  }
+  record = records()[index];
+  return true;
+}
+
+String ResourceManifest::getCategory(uint8_t category) {
+  VramLock guard(mutex);
+  if (buffer == nullptr || category >= ((const ManifestHeader*)buffer)->categoryCount) {
+    return "";
+  }
+  
+  // Validated on receipt: every name is there and terminated
+  const char* name = (const char*)(records() + recordCount);
+  for (uint8_t i = 0; i < category; i++) {
+    name += strlen(name) + 1;
+  }
+  return String(name);
+}
+
+size_t ResourceManifest::getTotalSize() {
+  VramLock guard(mutex);
+  return buffer != nullptr ? ((const ManifestHeader*)buffer)->totalSize : 0;
+}
+
+void ResourceManifest::printStats() {
+  Serial.println("\n=== Resource Manifest ===");
+  if (isLoaded()) {
+    Serial.printf("Resources: %d (%d bytes on server), manifest %d bytes\n",
+                  recordCount, getTotalSize(), length);
+    Serial.printf("ETag: %s, age: %lus\n", etag, getAge() / 1000);
+  } else {
+    Serial.println("Not loaded");
+  }
+  Serial.printf("Fetches: %lu, Not Modified: %lu, Failed: %lu (last HTTP %d)\n",
+                stats.fetches, stats.notModified, stats.failed, stats.lastHttpCode);
+  Serial.printf("Lookups: %lu, Found: %lu\n", stats.lookups, stats.hits);
+  Serial.println("=========================\n");
+}
+
+#endif // RESOURCE_MANIFEST_H
\ No newline at end of file
@@ -0,0 +1,214 @@
+/*
+ * Status Display for VRAM System
+ * Retained text lines, pushed to the panel only when they change
+ */
+
+#ifndef STATUS_DISPLAY_H
+#define STATUS_DISPLAY_H
+
+#include <M5StickCPlus2.h>
+#include "vram_log.h"
+
+// Display configuration
+#define STATUS_MAX_LINES      6
+#define STATUS_TEXT_LENGTH    32
+#define STATUS_FONT           (&fonts::Orbitron_Light_24)
+#define STATUS_BACKGROUND     BLACK
+#define STATUS_SPRITE_DEPTH   8             // RGB332: one byte per pixel in the line buffer
+#define STATUS_MARGIN         2             // Pixels pushed either side of the text
+
+// One line of text centered across the display
+struct StatusLine {
+  bool used;
+  int y;                                    // Vertical center
+  float textSize;
+  uint16_t color;
+  char text[STATUS_TEXT_LENGTH];
+  bool dirty;
+  int drawnWidth;                           // Extent on the panel now, 0 when blank
+  int drawnHeight;
+};
+
+// Display statistics
+struct DisplayStats {
+  unsigned long renders;                    // render() calls that pushed anything
+  unsigned long linesPushed;
+  unsigned long pixelsPushed;
+  unsigned long screenClears;
+};
+
+// Screens are built from lines every time they are shown; lines that
+// come out the same are not sent again. A changed line is drawn into a
+// one-line sprite and only the rectangle covering the old and the new
+// text is pushed, so the panel never shows a cleared frame. Lines
+// taller than the sprite, like titles, are drawn in place with the
+// background as padding. Only a switch to another screen clears it.
+class StatusDisplay {
+private:
+  M5GFX& display;
+  M5Canvas canvas;
+  bool spriteReady;
+  int spriteHeight;
+  int screen;                               // Screen on the panel, -1 before the first
+  StatusLine lines[STATUS_MAX_LINES];
+  DisplayStats stats;
+  
+  void pushLine(StatusLine& line);
+  void erase(StatusLine& line);
+
+public:
+  StatusDisplay(M5GFX& target);
+  
+  // Allocates the line sprite; call once rotation is set.
+  // Without it, every line is drawn in place.
+  bool begin();
+  
+  // A different screen from the one shown clears the panel and forgets its lines
+  void beginScreen(int screenId);
+  
+  // Set a line of the current screen; an unchanged line costs nothing
+  void setLine(int index, int y, float textSize, uint16_t color, const char* text);
+  
+  // Push changed lines; returns how many were drawn
+  int render();
+  
+  // Statistics
+  DisplayStats getStats() { return stats; }
+  void printStats();
+};
+
+// Implementation
+StatusDisplay::StatusDisplay(M5GFX& target) : display(target), canvas(&target) {
+  spriteReady = false;
+  spriteHeight = 0;
+  screen = -1;
+  memset(lines, 0, sizeof(lines));
+  memset(&stats, 0, sizeof(stats));
+}
+
+bool StatusDisplay::begin() {
+  canvas.setColorDepth(STATUS_SPRITE_DEPTH);
+  canvas.setFont(STATUS_FONT);
+  canvas.setTextSize(1);
+  canvas.setTextDatum(middle_center);
+  spriteHeight = canvas.fontHeight();
+  
+  spriteReady = canvas.createSprite(display.width(), spriteHeight) != nullptr;
+  if (!spriteReady) {
+    VRAM_LOGW("display", "No memory for the line sprite, drawing in place");
+    return false;
+  }
+  VRAM_LOGD("display", "Line sprite %dx%d", display.width(), spriteHeight);
+  return true;
+}
+
+void StatusDisplay::beginScreen(int screenId) {
+  if (screenId == screen) return;
+  
+  display.fillScreen(STATUS_BACKGROUND);
+  memset(lines, 0, sizeof(lines));
+  screen = screenId;
+  stats.screenClears++;
+}
+
+void StatusDisplay::setLine(int index, int y, float textSize, uint16_t color, const char* text) {
+  if (index < 0 || index >= STATUS_MAX_LINES) return;
+  StatusLine& line = lines[index];
+  
+  // A line that moves leaves its old place blank
+  if (line.used && (line.y != y || line.textSize != textSize)) {
+    erase(line);
+  }
+  
+  if (line.used && line.y == y && line.textSize == textSize && line.color == color &&
+      strncmp(line.text, text, STATUS_TEXT_LENGTH - 1) == 0) {
+    return;
+  }
+  
+  line.used = true;
+  line.y = y;
+  line.textSize = textSize;
+  line.color = color;
+  strncpy(line.text, text, STATUS_TEXT_LENGTH - 1);
+  line.text[STATUS_TEXT_LENGTH - 1] = '\0';
+  line.dirty = true;
+}
+
+void StatusDisplay::erase(StatusLine& line) {
+  if (line.drawnWidth > 0) {
+    display.fillRect((display.width() - line.drawnWidth) / 2, line.y - line.drawnHeight / 2,
+                     line.drawnWidth, line.drawnHeight, STATUS_BACKGROUND);
+    stats.pixelsPushed += line.drawnWidth * line.drawnHeight;
+  }
+  line.drawnWidth = 0;
+  line.drawnHeight = 0;
+}
+
+int StatusDisplay::render() {
+  int pushed = 0;
+  display.startWrite();
+  for (int i = 0; i < STATUS_MAX_LINES; i++) {
+    if (lines[i].used && lines[i].dirty) {
+      pushLine(lines[i]);
+      pushed++;
+    }
+  }
+  display.endWrite();
+  
+  if (pushed > 0) {
+    stats.renders++;
+    stats.linesPushed += pushed;
+  }
+  return pushed;
+}
+
+void StatusDisplay::pushLine(StatusLine& line) {
+  canvas.setTextSize(line.textSize);
+  int height = canvas.fontHeight();
+  int width = canvas.textWidth(line.text) + 2 * STATUS_MARGIN;
+  
+  // Cover whatever is there now as well as the new text
+  int dirtyWidth = width > line.drawnWidth ? width : line.drawnWidth;
+  int dirtyHeight = height > line.drawnHeight ? height : line.drawnHeight;
+  if (dirtyWidth > display.width()) dirtyWidth = display.width();
+  int left = (display.width() - dirtyWidth) / 2;
+  int top = line.y - dirtyHeight / 2;
+  
+  if (spriteReady && dirtyHeight <= spriteHeight) {
+    canvas.fillSprite(STATUS_BACKGROUND);
+    canvas.setTextColor(line.color);
+    canvas.drawString(line.text, canvas.width() / 2, dirtyHeight / 2);
+    
+    // The clip keeps the transfer to the dirty rectangle
+    display.setClipRect(left, top, dirtyWidth, dirtyHeight);
+    canvas.pushSprite(&display, 0, top);
+    display.clearClipRect();
+  } else {
+    // Too tall for the sprite: the padding paints over the old text
+    display.setFont(STATUS_FONT);
+    display.setTextSize(line.textSize);
+    display.setTextDatum(middle_center);
+    display.setTextColor(line.color, STATUS_BACKGROUND);
+    display.setTextPadding(dirtyWidth);
+    display.drawString(line.text, display.width() / 2, line.y);
+    display.setTextPadding(0);
+  }
+  
+  stats.pixelsPushed += dirtyWidth * dirtyHeight;
+  line.drawnWidth = width;
+  line.drawnHeight = height;
+  line.dirty = false;
+}
+
+void StatusDisplay::printStats() {
+  unsigned long frame = (unsigned long)display.width() * display.height();
+  Serial.println("\n=== Display Statistics ===");
+  Serial.printf("Line Sprite: %s\n", spriteReady ? "yes" : "no");
+  Serial.printf("Renders: %lu, Lines Pushed: %lu\n", stats.renders, stats.linesPushed);
+  Serial.printf("Pixels Pushed: %lu (%.1f full frames)\n", stats.pixelsPushed,
+                frame > 0 ? (float)stats.pixelsPushed / frame : 0.0f);
+  Serial.printf("Screen Clears: %lu\n", stats.screenClears);
+  Serial.println("==========================\n");
+}
+
+#endif // STATUS_DISPLAY_H
\ No newline at end of file
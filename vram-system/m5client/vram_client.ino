@@ -10,29 +10,64 @@
 #include <WiFi.h>
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
+
+// Raise to VRAM_LOG_DEBUG to trace every allocation and cache operation
+#define VRAM_LOG_LEVEL VRAM_LOG_INFO
+
+#include "vram_log.h"
 #include "memory_manager.h"
 #include "resource_cache.h"
+#include "resource_loader.h"
+#include "load_metrics.h"
+#include "resource_manifest.h"
+#include "memory_pressure.h"
+#include "async_loader.h"
 #include "wifi_manager.h"
+#include "event_channel.h"
+#include "status_display.h"
 
 // Configuration
-#define MEMORY_THRESHOLD_PERCENT 90
-#define CLEANUP_PERCENTAGE 30
-#define SERVER_CHECK_INTERVAL 30000  // 30 seconds
+#define SERVER_CHECK_INTERVAL 30000  // 30 seconds, only while the event channel is down
 #define MEMORY_CHECK_INTERVAL 5000   // 5 seconds
+#define LOAD_DISPLAY_TIMEOUT (HTTP_SESSION_TIMEOUT + LOADER_READ_TIMEOUT)  // Response wait plus one stalled read
 
 // Global objects
+VramLogger vramLog;
 MemoryManager memoryManager;
 ResourceCache resourceCache;
+MemoryPressure memoryPressure(memoryManager, resourceCache);
 WiFiManager wifiManager;
+ResourceLoader resourceLoader(resourceCache, wifiManager.getSession());
+LoadMetrics loadMetrics;
+ResourceManifest resourceManifest;
+AsyncLoader asyncLoader(resourceLoader, resourceCache, wifiManager.getSession());
+EventChannel eventChannel(wifiManager.getSession());
+StatusDisplay statusDisplay(M5.Display);
+
+// Screens; switching between them clears the display, redrawing one does not
+enum Screen {
+  SCREEN_BOOT,
+  SCREEN_MAIN,
+  SCREEN_STATUS,
+  SCREEN_ERROR,
+  SCREEN_MEMORY,
+  SCREEN_STATS
+};
 
 // System state
 struct SystemState {
   bool serverConnected = false;
   unsigned long lastServerCheck = 0;
   unsigned long lastMemoryCheck = 0;
+  unsigned long lastMetricsReport = 0;
+  unsigned long lastManifestRefresh = 0;
+  unsigned long lastCatalogChange = 0;
+  bool catalogChanged = false;          // An invalidation arrived since the manifest was fetched
   int totalRequests = 0;
   int failedRequests = 0;
   float avgResponseTime = 0.0;
+  unsigned long displayHoldStart = 0;   // Keeps a status screen up without blocking loop()
+  unsigned long displayHoldTime = 0;
 } systemState;
 
 void setup() {
@@ -44,6 +79,7 @@ void setup() {
   M5.Display.setTextDatum(middle_center);
   M5.Display.setFont(&fonts::Orbitron_Light_24);
   M5.Display.setTextSize(1);
+  statusDisplay.begin();
   
   Serial.begin(115200);
   delay(1000);
@@ -51,35 +87,83 @@ void setup() {
   // Initialize display
   displayBootScreen();
   
-  // Initialize memory manager
+  // Initialize memory manager; the sampled profile goes out with metrics reports
   memoryManager.begin();
+  memoryManager.enableProfiler();
   
-  // Initialize resource cache
+  // Initialize resource cache; resources saved before the last restart are usable right away
   resourceCache.begin();
+  if (resourceCache.enablePersistence()) {
+    Serial.printf("Restored %d resources from flash\n", resourceCache.getPersistentStore().getEntryCount());
+  }
+  
+  // Evicts between watermarks, and at once when an allocation fails
+  memoryPressure.begin();
+  
+  // Every load from here on is timed stage by stage
+  resourceLoader.setMetrics(&loadMetrics);
   
   // Initialize WiFi
   displayStatus("Connecting WiFi...");
-  if (!wifiManager.connect()) {
+  bool wifiConnected = wifiManager.connect();
+  if (!wifiConnected && resourceCache.getPersistentStore().getEntryCount() == 0) {
     displayError("WiFi Failed!");
     ESP.restart();
   }
   
-  displayStatus("WiFi Connected");
-  delay(1000);
+  if (wifiConnected) {
+    displayStatus("WiFi Connected");
+    delay(1000);
   
-  // Test server connection
-  displayStatus("Testing Server...");
-  testServerConnection();
+    // Test server connection
+    displayStatus("Testing Server...");
+    testServerConnection();
   
-  // Load initial resources
-  loadInitialResources();
+    // Sizes of everything on the server, before anything is downloaded
+    if (systemState.serverConnected && resourceManifest.fetch(wifiManager.getSession())) {
+      Serial.printf("Manifest lists %d resources\n", resourceManifest.getRecordCount());
+    }
+    systemState.lastManifestRefresh = millis();
+    
+    // Persisted copies only need revalidating: unchanged ones come back as 304
+    loadInitialResources();
+  } else {
+    displayStatus("Offline: Using Flash");
+    delay(1000);
+  }
   
   displayStatus("System Ready!");
   delay(2000);
+  
+  // From here on, log lines are buffered and drained from loop()
+  vramLog.setSinks(VRAM_LOG_SINK_RING);
+  
+  // Later downloads and health checks run on the loader task,
+  // starting with whatever the server expects us to need next
+  String hints = resourceLoader.getLastHints();
+  asyncLoader.setManifest(&resourceManifest);
+  if (!asyncLoader.begin()) {
+    Serial.println("Async loader unavailable");
+  } else if (hints.length() > 0) {
+    Serial.printf("Prefetching %d hinted resources\n", asyncLoader.prefetch(hints));
+  }
+  
+  // Server liveness and invalidations arrive over one stream instead of polling
+  if (!eventChannel.begin(onChannelEvent)) {
+    Serial.println("Event channel unavailable, polling server health");
+  }
 }
 
 void loop() {
   M5.update();
+  vramLog.flush();
+  
+  // WiFi events and reconnect retries; never blocks
+  wifiManager.update();
+  
+  // Run callbacks for finished downloads and received server events
+  asyncLoader.poll();
+  eventChannel.poll();
   
   unsigned long currentTime = millis();
   
@@ -89,12 +173,26 @@ void loop() {
     systemState.lastMemoryCheck = currentTime;
   }
   
-  // Check server connection periodically
-  if (currentTime - systemState.lastServerCheck > SERVER_CHECK_INTERVAL) {
+  // Check server connection periodically when there is no event stream to tell us
+  if (!eventChannel.isRunning() && currentTime - systemState.lastServerCheck > SERVER_CHECK_INTERVAL) {
     checkServerConnection();
     systemState.lastServerCheck = currentTime;
   }
   
+  // Stage histograms go to the server from the loader task
+  if (systemState.serverConnected && currentTime - systemState.lastMetricsReport > METRICS_REPORT_INTERVAL) {
+    asyncLoader.requestMetricsReport();
+    systemState.lastMetricsReport = currentTime;
+  }
+  
+  // The manifest is revalidated on a timer, and once a burst of invalidations has settled
+  bool manifestDue = currentTime - systemState.lastManifestRefresh > MANIFEST_REFRESH_INTERVAL ||
+                     (systemState.catalogChanged && currentTime - systemState.lastCatalogChange > MANIFEST_REFRESH_HOLDOFF);
+  if (systemState.serverConnected && manifestDue && asyncLoader.requestManifestRefresh()) {
+    systemState.lastManifestRefresh = currentTime;
+    systemState.catalogChanged = false;
+  }
+  
   // Handle button presses
   if (M5.BtnA.wasPressed()) {
     handleButtonA();
@@ -115,117 +213,74 @@ void loop() {
 }
 
 void displayBootScreen() {
-  M5.Display.clear();
-  M5.Display.setTextSize(2);
-  M5.Display.drawString("VRAM System", M5.Display.width() / 2, 30);
-  M5.Display.setTextSize(1);
-  M5.Display.drawString("M5StickC Plus2", M5.Display.width() / 2, 60);
-  M5.Display.drawString("Initializing...", M5.Display.width() / 2, 90);
+  statusDisplay.beginScreen(SCREEN_BOOT);
+  statusDisplay.setLine(0, 30, 2, GREEN, "VRAM System");
+  statusDisplay.setLine(1, 60, 1, GREEN, "M5StickC Plus2");
+  statusDisplay.setLine(2, 90, 1, GREEN, "Initializing...");
+  statusDisplay.render();
 }
 
 void displayStatus(const char* message) {
-  M5.Display.clear();
-  M5.Display.drawString("VRAM System", M5.Display.width() / 2, 20);
-  M5.Display.setTextColor(YELLOW);
-  M5.Display.drawString(message, M5.Display.width() / 2, 60);
-  M5.Display.setTextColor(GREEN);
+  // Consecutive messages only redraw the message line
+  statusDisplay.beginScreen(SCREEN_STATUS);
+  statusDisplay.setLine(0, 20, 1, GREEN, "VRAM System");
+  statusDisplay.setLine(1, 60, 1, YELLOW, message);
+  statusDisplay.render();
 }
 
 void displayError(const char* message) {
-  M5.Display.clear();
-  M5.Display.setTextColor(RED);
-  M5.Display.drawString("ERROR", M5.Display.width() / 2, 20);
-  M5.Display.drawString(message, M5.Display.width() / 2, 60);
-  M5.Display.setTextColor(GREEN);
+  statusDisplay.beginScreen(SCREEN_ERROR);
+  statusDisplay.setLine(0, 20, 1, RED, "ERROR");
+  statusDisplay.setLine(1, 60, 1, RED, message);
+  statusDisplay.render();
 }
 
 void testServerConnection() {
-  HTTPClient http;
-  http.begin(wifiManager.getServerURL() + "/api/health");
-  http.setTimeout(5000);
+  systemState.serverConnected = wifiManager.testServerConnection();
   
-  int httpCode = http.GET();
-  if (httpCode == HTTP_CODE_OK) {
-    systemState.serverConnected = true;
+  if (systemState.serverConnected) {
     Serial.println("Server connection successful");
   } else {
-    systemState.serverConnected = false;
-    Serial.printf("Server connection failed: %d\n", httpCode);
+    Serial.println("Server connection failed");
   }
-  
-  http.end();
 }
 
 void loadInitialResources() {
   displayStatus("Loading Resources...");
   
-  // Load critical configuration first
-  requestResource("config_main", PRIORITY_CRITICAL);
-  delay(500);
+  // Critical configuration, libraries and UI strings in a single round-trip
+  BatchItem initialResources[] = {
+    {"config_main", PRIORITY_CRITICAL, 0, 0},
+    {"lib_sensor", PRIORITY_IMPORTANT, 0, 0},
+    {"ui_strings", PRIORITY_IMPORTANT, 0, 0}
+  };
+  size_t count = sizeof(initialResources) / sizeof(initialResources[0]);
   
-  // Load important libraries
-  requestResource("lib_sensor", PRIORITY_IMPORTANT);
-  delay(500);
-  
-  // Load UI resources
-  requestResource("ui_strings", PRIORITY_IMPORTANT);
-  delay(500);
-  
-  Serial.println("Initial resources loaded");
+  int loaded = requestResources(initialResources, count);
+  Serial.printf("Initial resources loaded (%d/%d)\n", loaded, count);
 }
-
-bool requestResource(const String& resourceId, int priority) {
+  
+int requestResources(BatchItem* items, size_t count) {
   if (!systemState.serverConnected) {
     Serial.println("Server not connected");
-    return false;
+    return 0;
   }
   
   unsigned long startTime = millis();
   systemState.totalRequests++;
   
-  HTTPClient http;
-  String url = wifiManager.getServerURL() + "/api/resources/" + resourceId;
+  // One framed response for the whole set; each item streams into the cache with its own priority
+  int loaded = resourceLoader.fetchBatch("/api/resources/batch", items, count, true);
   
-  // Add compression parameter for large resources
-  if (priority <= PRIORITY_NORMAL) {
-    url += "?compress=true";
+  for (size_t i = 0; i < count; i++) {
+    if (items[i].status == HTTP_CODE_OK) {
+      Serial.printf("Resource %s loaded\n", items[i].resourceId.c_str());
+    } else if (items[i].status != HTTP_CODE_NOT_MODIFIED) {
+      Serial.printf("Resource %s not loaded (%d)\n", items[i].resourceId.c_str(), items[i].status);
+    }
   }
   
-  http.begin(url);
-  http.setTimeout(10000);
-  
-  int httpCode = http.GET();
-  bool success = false;
-  
-  if (httpCode == HTTP_CODE_OK) {
-    String payload = http.getString();
-    
-    // Parse JSON response
-    DynamicJsonDocument doc(8192);
-    DeserializationError error = deserializeJson(doc, payload);
-    
-    if (!error) {
-      String data = doc["data"];
-      bool compressed = doc["compressed"] | false;
-      int size = doc["size"] | 0;
-      
-      // Decompress if necessary
-      if (compressed) {
-        // Handle compressed data (hex decode + gzip decompress)
-        data = decompressHexData(data);
-      }
-      
-      // Store in cache
-      success = resourceCache.store(resourceId, data, priority, size);
-      
-      if (success) {
-        Serial.printf("Resource %s loaded (%d bytes)\n", resourceId.c_str(), size);
-      }
-    } else {
-      Serial.printf("JSON parse error: %s\n", error.c_str());
-    }
-  } else {
-    Serial.printf("HTTP error for resource %s: %d\n", resourceId.c_str(), httpCode);
+  if (loaded < (int)count) {
     systemState.failedRequests++;
   }
   
@@ -233,69 +288,130 @@ bool requestResource(const String& resourceId, int priority) {
   unsigned long responseTime = millis() - startTime;
   systemState.avgResponseTime = (systemState.avgResponseTime * (systemState.totalRequests - 1) + responseTime) / systemState.totalRequests;
   
-  http.end();
-  return success;
+  return loaded;
 }
 
-String decompressHexData(const String& hexData) {
-  // Convert hex string to bytes
-  int len = hexData.length() / 2;
-  uint8_t* bytes = (uint8_t*)malloc(len);
-  
-  for (int i = 0; i < len; i++) {
-    String byteString = hexData.substring(i * 2, i * 2 + 2);
-    bytes[i] = (uint8_t)strtol(byteString.c_str(), NULL, 16);
+bool requestResource(const String& resourceId, int priority) {
+  if (!systemState.serverConnected) {
+    Serial.println("Server not connected");
+    return false;
   }
   
-  // For simplicity, we'll just return the hex decoded data
-  // In a full implementation, you'd use a gzip library here
-  String result = String((char*)bytes);
-  free(bytes);
+  // Queued for the loader task, which streams the binary body straight into a
+  // cache reservation, inflating on the fly. Already cached resources are
+  // revalidated and patched in place from a delta if they changed. Compress large resources.
+  if (!asyncLoader.request(resourceId, priority, onResourceLoaded, nullptr, priority <= PRIORITY_NORMAL)) {
+    Serial.printf("Resource %s not queued\n", resourceId.c_str());
+    return false;
+  }
   
-  return result;
+  systemState.totalRequests++;
+  return true;
+}
+  
+void onResourceLoaded(const AsyncResult& result, void* context) {
+  if (result.success && result.httpCode == HTTP_CODE_NOT_MODIFIED) {
+    Serial.printf("Resource %s unchanged, cached copy kept\n", result.resourceId);
+  } else if (result.success && result.patched) {
+    Serial.printf("Resource %s patched (%d bytes)\n", result.resourceId, result.size);
+  } else if (result.success) {
+    Serial.printf("Resource %s loaded (%d bytes)\n", result.resourceId, result.size);
+  } else {
+    Serial.printf("HTTP error for resource %s: %d\n", result.resourceId, result.httpCode);
+    systemState.failedRequests++;
+  }
+  
+  // Update response time statistics
+  systemState.avgResponseTime = (systemState.avgResponseTime * (systemState.totalRequests - 1) + result.elapsed) / systemState.totalRequests;
+  
+  if (result.success) {
+    displayStatus("Resource Loaded!");
+  } else {
+    displayError("Load Failed!");
+  }
+  holdDisplay(2000);
 }
 
 void checkMemoryUsage() {
-  MemoryInfo memInfo = memoryManager.getMemoryInfo();
+  // Above the high watermark, evicts just enough to get under the low one;
+  // evicted resources move to PSRAM when it is fitted
+  int freedResources = memoryPressure.update();
   
-  // Check if memory usage is too high
-  if (memInfo.usagePercent >= MEMORY_THRESHOLD_PERCENT) {
-    Serial.println("Memory threshold exceeded, triggering cleanup");
-    displayStatus("Cleaning Memory...");
-    
-    // Calculate how much to free (30% of total memory)
-    size_t targetFreeBytes = (memInfo.totalHeap * CLEANUP_PERCENTAGE) / 100;
-    
-    // Use LRU algorithm to free memory
-    int freedResources = resourceCache.freeMemory(targetFreeBytes);
-    
-    Serial.printf("Freed %d resources\n", freedResources);
-    
-    // Force garbage collection
-    memoryManager.forceGarbageCollection();
-    
-    // Update memory info
-    memInfo = memoryManager.getMemoryInfo();
-    Serial.printf("Memory after cleanup: %d%% used\n", memInfo.usagePercent);
+  if (freedResources > 0) {
+    Serial.printf("Memory pressure: freed %d resources, now %d%% used\n",
+                  freedResources, memoryPressure.getStats().lastUsagePercent);
   }
 }
 
 void checkServerConnection() {
-  HTTPClient http;
-  http.begin(wifiManager.getServerURL() + "/api/health");
-  http.setTimeout(5000);
+  // HEAD over the shared connection, issued from the loader task
+  asyncLoader.requestHealthCheck(onServerChecked);
+}
   
-  int httpCode = http.GET();
+void onServerChecked(const AsyncResult& result, void* context) {
   bool wasConnected = systemState.serverConnected;
-  systemState.serverConnected = (httpCode == HTTP_CODE_OK);
+  systemState.serverConnected = result.success;
   
   if (!wasConnected && systemState.serverConnected) {
     Serial.println("Server connection restored");
   } else if (wasConnected && !systemState.serverConnected) {
     Serial.println("Server connection lost");
   }
-  
-  http.end();
+}
+
+void onChannelEvent(const ChannelEvent& event, void* context) {
+  switch (event.type) {
+    case CHANNEL_CONNECTED:
+    case CHANNEL_LOST: {
+      bool wasConnected = systemState.serverConnected;
+      systemState.serverConnected = event.type == CHANNEL_CONNECTED;
+      if (wasConnected != systemState.serverConnected) {
+        Serial.println(systemState.serverConnected ? "Server connection restored" : "Server connection lost");
+      }
+      break;
+    }
+    
+    case CHANNEL_INVALIDATE: {
+      systemState.catalogChanged = true;
+      systemState.lastCatalogChange = millis();
+      
+      // Only cached copies matter; one that already has the new content needs nothing
+      int priority = resourceCache.getPriority(event.resourceId);
+      if (priority == 0 || resourceCache.getETag(event.resourceId) == event.etag) {
+        break;
+      }
+      if (event.version == 0) {
+        resourceCache.remove(event.resourceId);
+        Serial.printf("Resource %s deleted on server, dropped\n", event.resourceId);
+      } else if (!asyncLoader.request(event.resourceId, priority, onResourceRefreshed)) {
+        Serial.printf("Refresh of %s not queued\n", event.resourceId);
+      }
+      break;
+    }
+    
+    case CHANNEL_RESET:
+      systemState.catalogChanged = true;
+      systemState.lastCatalogChange = millis();
+      
+      // Invalidations may have been missed: revalidate what is in RAM, most important first
+      for (int priority = PRIORITY_CRITICAL; priority <= PRIORITY_LOW; priority++) {
+        std::vector<String> resources = resourceCache.getResourcesByPriority(priority);
+        for (size_t i = 0; i < resources.size(); i++) {
+          if (!asyncLoader.request(resources[i], priority, onResourceRefreshed)) {
+            return;   // Queue full; the rest refresh when next requested
+          }
+        }
+      }
+      break;
+  }
+}
+
+void onResourceRefreshed(const AsyncResult& result, void* context) {
+  if (!result.success) {
+    Serial.printf("Refresh of %s failed: %d\n", result.resourceId, result.httpCode);
+  } else if (result.httpCode != HTTP_CODE_NOT_MODIFIED) {
+    Serial.printf("Resource %s refreshed (%d bytes)\n", result.resourceId, result.size);
+  }
 }
 
 void handleButtonA() {
@@ -303,13 +419,13 @@ void handleButtonA() {
   Serial.println("Button A: Requesting demo resource");
   displayStatus("Loading Resource...");
   
+  // The result screen is shown from onResourceLoaded()
   if (requestResource("data_sample", PRIORITY_NORMAL)) {
-    displayStatus("Resource Loaded!");
+    holdDisplay(LOAD_DISPLAY_TIMEOUT);
   } else {
     displayError("Load Failed!");
+    holdDisplay(2000);
   }
-  
-  delay(2000);
 }
 
 void handleButtonB() {
@@ -317,88 +433,91 @@ void handleButtonB() {
   Serial.println("Button B: Showing memory status");
   MemoryInfo memInfo = memoryManager.getMemoryInfo();
   
-  M5.Display.clear();
-  M5.Display.setTextSize(1);
-  M5.Display.drawString("Memory Status", M5.Display.width() / 2, 20);
+  statusDisplay.beginScreen(SCREEN_MEMORY);
+  statusDisplay.setLine(0, 20, 1, GREEN, "Memory Status");
   
   char buffer[64];
   sprintf(buffer, "Used: %d%%", memInfo.usagePercent);
-  M5.Display.drawString(buffer, M5.Display.width() / 2, 40);
+  statusDisplay.setLine(1, 40, 1, GREEN, buffer);
   
   sprintf(buffer, "Free: %d KB", memInfo.freeHeap / 1024);
-  M5.Display.drawString(buffer, M5.Display.width() / 2, 60);
+  statusDisplay.setLine(2, 60, 1, GREEN, buffer);
   
   sprintf(buffer, "Cached: %d", resourceCache.getResourceCount());
-  M5.Display.drawString(buffer, M5.Display.width() / 2, 80);
+  statusDisplay.setLine(3, 80, 1, GREEN, buffer);
+  statusDisplay.render();
   
-  delay(3000);
+  holdDisplay(3000);
 }
 
 void handlePowerButton() {
   // Power button: Show system statistics
   Serial.println("Power button: Showing system stats");
   
-  M5.Display.clear();
-  M5.Display.setTextSize(1);
-  M5.Display.drawString("System Stats", M5.Display.width() / 2, 15);
+  statusDisplay.beginScreen(SCREEN_STATS);
+  statusDisplay.setLine(0, 15, 1, GREEN, "System Stats");
   
   char buffer[64];
   sprintf(buffer, "Requests: %d", systemState.totalRequests);
-  M5.Display.drawString(buffer, M5.Display.width() / 2, 35);
+  statusDisplay.setLine(1, 35, 1, GREEN, buffer);
   
   sprintf(buffer, "Failed: %d", systemState.failedRequests);
-  M5.Display.drawString(buffer, M5.Display.width() / 2, 50);
+  statusDisplay.setLine(2, 50, 1, GREEN, buffer);
   
   sprintf(buffer, "Avg RT: %.1fms", systemState.avgResponseTime);
-  M5.Display.drawString(buffer, M5.Display.width() / 2, 65);
+  statusDisplay.setLine(3, 65, 1, GREEN, buffer);
   
   sprintf(buffer, "Server: %s", systemState.serverConnected ? "OK" : "FAIL");
-  M5.Display.setTextColor(systemState.serverConnected ? GREEN : RED);
-  M5.Display.drawString(buffer, M5.Display.width() / 2, 80);
-  M5.Display.setTextColor(GREEN);
+  statusDisplay.setLine(4, 80, 1, systemState.serverConnected ? GREEN : RED, buffer);
+  statusDisplay.render();
+  statusDisplay.printStats();
+  loadMetrics.printStats();
+  resourceManifest.printStats();
   
-  delay(3000);
+  holdDisplay(3000);
+}
+
+void holdDisplay(unsigned long duration) {
+  systemState.displayHoldStart = millis();
+  systemState.displayHoldTime = duration;
 }
 
 void updateDisplay() {
   static unsigned long lastUpdate = 0;
   
+  if (millis() - systemState.displayHoldStart < systemState.displayHoldTime) return;  // Status screen still up
   if (millis() - lastUpdate < 1000) return;  // Update every second
   lastUpdate = millis();
   
-  M5.Display.clear();
+  // Only lines whose value changed since the last second are redrawn
+  statusDisplay.beginScreen(SCREEN_MAIN);
   
   // Title
-  M5.Display.setTextSize(2);
-  M5.Display.drawString("VRAM", M5.Display.width() / 2, 20);
-  
-  // Status indicators
-  M5.Display.setTextSize(1);
+  statusDisplay.setLine(0, 20, 2, GREEN, "VRAM");
   
   // Memory usage
   MemoryInfo memInfo = memoryManager.getMemoryInfo();
   char buffer[64];
   sprintf(buffer, "Mem: %d%%", memInfo.usagePercent);
   
-  if (memInfo.usagePercent >= MEMORY_THRESHOLD_PERCENT) {
-    M5.Display.setTextColor(RED);
+  uint16_t memoryColor = GREEN;
+  if (memInfo.usagePercent >= memoryPressure.getHighWatermark()) {
+    memoryColor = RED;
   } else if (memInfo.usagePercent >= 70) {
-    M5.Display.setTextColor(YELLOW);
-  } else {
-    M5.Display.setTextColor(GREEN);
+    memoryColor = YELLOW;
   }
-  M5.Display.drawString(buffer, M5.Display.width() / 2, 50);
+  statusDisplay.setLine(1, 50, 1, memoryColor, buffer);
   
   // Server connection status
-  M5.Display.setTextColor(systemState.serverConnected ? GREEN : RED);
-  M5.Display.drawString(systemState.serverConnected ? "Server: OK" : "Server: FAIL", M5.Display.width() / 2, 70);
+  statusDisplay.setLine(2, 70, 1, systemState.serverConnected ? GREEN : RED,
+                        systemState.serverConnected ? "Server: OK" : "Server: FAIL");
   
   // Resource count
-  M5.Display.setTextColor(GREEN);
   sprintf(buffer, "Resources: %d", resourceCache.getResourceCount());
-  M5.Display.drawString(buffer, M5.Display.width() / 2, 90);
+  statusDisplay.setLine(3, 90, 1, GREEN, buffer);
   
   // Button hints
-  M5.Display.setTextSize(0.5);
-  M5.Display.drawString("A:Load B:Mem PWR:Stats", M5.Display.width() / 2, 110);
+  statusDisplay.setLine(4, 110, 0.5, GREEN, "A:Load B:Mem PWR:Stats");
+  
+  statusDisplay.render();
 }
\ No newline at end of file
@@ -0,0 +1,184 @@
+/*
+ * Logging for VRAM System
+ * Leveled diagnostics shared by the VRAM components, with an optional
+ * non-blocking ring buffer sink drained from the main loop
+ */
+
+#ifndef VRAM_LOG_H
+#define VRAM_LOG_H
+
+#include <Arduino.h>
+#include <stdarg.h>
+
+// Log levels
+#define VRAM_LOG_NONE       0
+#define VRAM_LOG_ERROR      1
+#define VRAM_LOG_WARN       2
+#define VRAM_LOG_INFO       3
+#define VRAM_LOG_DEBUG      4
+#define VRAM_LOG_VERBOSE    5
+
+// Compile-time level: calls above it are removed entirely, arguments included.
+// Define before including any VRAM header to override.
+#ifndef VRAM_LOG_LEVEL
+#define VRAM_LOG_LEVEL      VRAM_LOG_INFO
+#endif
+
+// Logger configuration
+#define VRAM_LOG_RING_SIZE  2048          // Ring buffer sink capacity
+#define VRAM_LOG_LINE_LENGTH 160          // Longer lines are truncated
+
+// Output sinks
+#define VRAM_LOG_SINK_SERIAL 0x01         // Blocking Serial writes (default)
+#define VRAM_LOG_SINK_RING   0x02         // Buffered, drained by flush()
+
+class VramLogger {
+private:
+  char ring[VRAM_LOG_RING_SIZE];
+  size_t ringHead;
+  size_t ringTail;
+  size_t ringUsed;
+  unsigned long droppedLines;
+  uint8_t sinks;
+  portMUX_TYPE ringLock;
+  
+  void pushRing(const char* line, size_t length);
+  static char levelChar(int level);
+
+public:
+  VramLogger();
+  
+  // Configuration
+  void setSinks(uint8_t newSinks) { sinks = newSinks; }
+  uint8_t getSinks() { return sinks; }
+  
+  // Output
+  void write(int level, const char* tag, const char* format, ...) __attribute__((format(printf, 4, 5)));
+  size_t flush(bool blocking = false);
+  
+  // Statistics
+  size_t getPending() { return ringUsed; }
+  unsigned long getDroppedLines() { return droppedLines; }
+};
+
+// Global logger instance
+extern VramLogger vramLog;
+
+// Logging macros; the level test is a constant expression, so disabled
+// levels generate no code
+#define VRAM_LOG_AT(level, tag, ...) \
+  do { if ((level) <= VRAM_LOG_LEVEL) vramLog.write((level), (tag), __VA_ARGS__); } while (0)
+
+#define VRAM_LOGE(tag, ...) VRAM_LOG_AT(VRAM_LOG_ERROR, tag, __VA_ARGS__)
+#define VRAM_LOGW(tag, ...) VRAM_LOG_AT(VRAM_LOG_WARN, tag, __VA_ARGS__)
+#define VRAM_LOGI(tag, ...) VRAM_LOG_AT(VRAM_LOG_INFO, tag, __VA_ARGS__)
+#define VRAM_LOGD(tag, ...) VRAM_LOG_AT(VRAM_LOG_DEBUG, tag, __VA_ARGS__)
+#define VRAM_LOGV(tag, ...) VRAM_LOG_AT(VRAM_LOG_VERBOSE, tag, __VA_ARGS__)
+
+// Implementation
+VramLogger::VramLogger() {
+  ringHead = 0;
+  ringTail = 0;
+  ringUsed = 0;
+  droppedLines = 0;
+  sinks = VRAM_LOG_SINK_SERIAL;
+  ringLock = portMUX_INITIALIZER_UNLOCKED;
+}
+
+char VramLogger::levelChar(int level) {
+  switch (level) {
+    case VRAM_LOG_ERROR: return 'E';
+    case VRAM_LOG_WARN: return 'W';
+    case VRAM_LOG_INFO: return 'I';
+    case VRAM_LOG_DEBUG: return 'D';
+    default: return 'V';
+  }
+}
+
+void VramLogger::write(int level, const char* tag, const char* format, ...) {
+  if (sinks == 0) return;
+  
+  char line[VRAM_LOG_LINE_LENGTH];
+  int prefix = snprintf(line, sizeof(line), "[%c][%s] ", levelChar(level), tag);
+  if (prefix < 0 || prefix >= (int)sizeof(line)) return;
+  
+  va_list args;
+  va_start(args, format);
+  vsnprintf(line + prefix, sizeof(line) - prefix, format, args);
+  va_end(args);
+  
+  // Always terminate with a newline, even when the message was truncated
+  size_t length = strlen(line);
+  if (length >= sizeof(line) - 1) {
+    length = sizeof(line) - 2;
+  }
+  line[length++] = '\n';
+  line[length] = '\0';
+  
+  if (sinks & VRAM_LOG_SINK_RING) {
+    pushRing(line, length);
+  }
+  if (sinks & VRAM_LOG_SINK_SERIAL) {
+    Serial.write((const uint8_t*)line, length);
+  }
+}
+
+void VramLogger::pushRing(const char* line, size_t length) {
+  portENTER_CRITICAL(&ringLock);
+  
+  // Whole lines only: a line that does not fit is dropped, never split
+  if (length > VRAM_LOG_RING_SIZE - ringUsed) {
+    droppedLines++;
+    portEXIT_CRITICAL(&ringLock);
+    return;
+  }
+  
+  size_t firstPart = VRAM_LOG_RING_SIZE - ringHead;
+  if (firstPart > length) firstPart = length;
+  memcpy(ring + ringHead, line, firstPart);
+  memcpy(ring, line + firstPart, length - firstPart);
+  ringHead = (ringHead + length) % VRAM_LOG_RING_SIZE;
+  ringUsed += length;
+  
+  portEXIT_CRITICAL(&ringLock);
+}
+
+size_t VramLogger::flush(bool blocking) {
+  size_t written = 0;
+  
+  while (true) {
+    portENTER_CRITICAL(&ringLock);
+    size_t chunk = ringUsed;
+    size_t tail = ringTail;
+    portEXIT_CRITICAL(&ringLock);
+    
+    if (chunk == 0) break;
+    if (chunk > VRAM_LOG_RING_SIZE - tail) {
+      chunk = VRAM_LOG_RING_SIZE - tail;
+    }
+    
+    // Only hand Serial what its TX buffer can take without blocking
+    if (!blocking) {
+      int writable = Serial.availableForWrite();
+      if (writable <= 0) break;
+      if (chunk > (size_t)writable) chunk = writable;
+    }
+    
+    Serial.write((const uint8_t*)ring + tail, chunk);
+    written += chunk;
+    
+    portENTER_CRITICAL(&ringLock);
+    ringTail = (ringTail + chunk) % VRAM_LOG_RING_SIZE;
+    ringUsed -= chunk;
+    portEXIT_CRITICAL(&ringLock);
+  }
+  
+  if (droppedLines > 0 && blocking) {
+    Serial.printf("[W][log] %lu lines dropped\n", droppedLines);
+    droppedLines = 0;
+  }
+  
+  return written;
+}
+
+#endif // VRAM_LOG_H
\ No newline at end of file
@@ -9,15 +9,27 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include <HTTPClient.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include "http_session.h"
+#include "vram_log.h"
 
 // Default configuration
 #define DEFAULT_WIFI_SSID "VRAM_Network"
 #define DEFAULT_WIFI_PASSWORD "vram123456"
 #define DEFAULT_SERVER_URL "http://192.168.1.100:5000"
-#define WIFI_CONNECT_TIMEOUT 15000
-#define WIFI_RECONNECT_INTERVAL 30000
+#define WIFI_CONNECT_TIMEOUT 15000      // How long connect() waits before leaving it to update()
+#define WIFI_ATTEMPT_TIMEOUT 10000      // One association attempt
+#define WIFI_BACKOFF_MIN 500            // First retry delay; doubles per failure
+#define WIFI_BACKOFF_MAX 30000
+#define WIFI_EVENT_WAIT 250             // connect() re-checks timers at least this often
 #define CONNECTION_CHECK_INTERVAL 60000
 
+// Event bits set from the WiFi event task
+#define WIFI_BIT_GOT_IP       (1 << 0)
+#define WIFI_BIT_DISCONNECTED (1 << 1)
+
 // WiFi status
 enum WiFiStatus {
   WIFI_DISCONNECTED,
@@ -32,28 +44,50 @@ struct ConnectionStats {
   unsigned long totalConnections;
   unsigned long failedConnections;
   unsigned long reconnections;
+  unsigned long fastReconnects;
   unsigned long lastConnectTime;
   unsigned long totalUptime;
   int signalStrength;
   String lastError;
 };
 
+// Connection state is driven by ESP32 WiFi events instead of polling:
+// the event callback only records what happened, and update() does the
+// rest from the main loop without blocking. A lost link is retried at
+// once on the last BSSID and channel, then with exponential backoff.
+// While the link is down the shared session reports offline, so queued
+// loads wait for it instead of timing out one by one.
 class WiFiManager {
 private:
   String ssid;
   String password;
   String serverURL;
-  WiFiStatus status;
+  std::atomic<int> status;        // WiFiStatus; the event callback moves it too
   ConnectionStats stats;
-  unsigned long lastReconnectAttempt;
+  EventGroupHandle_t events;
+  std::atomic<uint8_t> lastReason;
+  bool eventsRegistered;
+  bool linkUp;                    // Connection bookkeeping done by update()
+  unsigned long attemptStart;
+  unsigned long retryFrom;
+  unsigned long retryDelay;
   unsigned long lastConnectionCheck;
   bool autoReconnect;
   int maxReconnectAttempts;
   int reconnectAttempts;
-  
-  void updateConnectionStats();
+  uint8_t cachedBSSID[6];
+  int32_t cachedChannel;
+  bool hasCachedBSSID;
+  bool fastAttempt;
+  HttpSession session;
+  
+  void onWiFiEvent(arduino_event_id_t event, arduino_event_info_t info);
+  void processEvents();
+  void startAttempt();
+  void failAttempt(const String& error);
+  void markLinkUp();
+  void markLinkDown();
   void handleConnectionFailure(const String& error);
-  bool performConnection();
   
 public:
   WiFiManager();
@@ -62,30 +96,33 @@ public:
   void setCredentials(const String& ssid, const String& password);
   void setServerURL(const String& url);
   void setAutoReconnect(bool enable);
-  void setMaxReconnectAttempts(int attempts);
+  void setMaxReconnectAttempts(int attempts);   // 0 retries forever
   
   // Connection management
-  bool connect();
+  bool connect();   // Waits up to WIFI_CONNECT_TIMEOUT, then keeps trying from update()
   bool connect(const String& ssid, const String& password);
   void disconnect();
-  bool isConnected();
-  bool reconnect();
+  bool isConnected() { return status.load() == WIFI_CONNECTED; }
+  bool reconnect(); // Starts an attempt without waiting for it
   
   // Status and monitoring
-  WiFiStatus getStatus() { return status; }
+  WiFiStatus getStatus() { return (WiFiStatus)status.load(); }
   String getStatusString();
   int getSignalStrength();
   String getIPAddress();
   String getMACAddress();
   String getServerURL() { return serverURL; }
   
+  // Shared keep-alive connection to the server
+  HttpSession& getSession() { return session; }
+  
   // Statistics
   ConnectionStats getStats() { return stats; }
   void printConnectionInfo();
   void resetStats();
   
   // Maintenance
-  void update();  // Call in main loop
+  void update();  // Call in main loop; never blocks
   bool checkConnection();
   void handleReconnection();
   
@@ -101,30 +138,45 @@ WiFiManager::WiFiManager() {
   password = DEFAULT_WIFI_PASSWORD;
   serverURL = DEFAULT_SERVER_URL;
   status = WIFI_DISCONNECTED;
-  lastReconnectAttempt = 0;
+  events = xEventGroupCreate();
+  lastReason = 0;
+  eventsRegistered = false;
+  linkUp = false;
+  attemptStart = 0;
+  retryFrom = 0;
+  retryDelay = 0;
   lastConnectionCheck = 0;
   autoReconnect = true;
-  maxReconnectAttempts = 5;
+  maxReconnectAttempts = 0;
   reconnectAttempts = 0;
+  cachedChannel = 0;
+  hasCachedBSSID = false;
+  fastAttempt = false;
+  session.setBaseURL(serverURL);
+  session.setOnline(false);
   
   // Initialize stats
   memset(&stats, 0, sizeof(stats));
 }
 
 void WiFiManager::setCredentials(const String& newSSID, const String& newPassword) {
+  if (newSSID != ssid) {
+    hasCachedBSSID = false;
+  }
   ssid = newSSID;
   password = newPassword;
-  Serial.printf("WiFi credentials set: %s\n", ssid.c_str());
+  VRAM_LOGI("wifi", "WiFi credentials set: %s", ssid.c_str());
 }
 
 void WiFiManager::setServerURL(const String& url) {
   serverURL = url;
-  Serial.printf("Server URL set: %s\n", serverURL.c_str());
+  session.setBaseURL(serverURL);
+  VRAM_LOGI("wifi", "Server URL set: %s", serverURL.c_str());
 }
 
 void WiFiManager::setAutoReconnect(bool enable) {
   autoReconnect = enable;
-  Serial.printf("Auto-reconnect: %s\n", enable ? "enabled" : "disabled");
+  VRAM_LOGI("wifi", "Auto-reconnect: %s", enable ? "enabled" : "disabled");
 }
 
 void WiFiManager::setMaxReconnectAttempts(int attempts) {
@@ -136,73 +188,200 @@ bool WiFiManager::connect() {
 }
 
 bool WiFiManager::connect(const String& connectSSID, const String& connectPassword) {
-  Serial.printf("Connecting to WiFi: %s\n", connectSSID.c_str());
-  
-  status = WIFI_CONNECTING;
-  stats.totalConnections++;
-  
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(connectSSID.c_str(), connectPassword.c_str());
+  setCredentials(connectSSID, connectPassword);
   
-  unsigned long startTime = millis();
-  while (WiFi.status() != WL_CONNECTED && millis() - startTime < WIFI_CONNECT_TIMEOUT) {
-    delay(100);
-    Serial.print(".");
+  processEvents();
+  if (isConnected()) {
+    return true;
   }
-  Serial.println();
   
-  if (WiFi.status() == WL_CONNECTED) {
-    status = WIFI_CONNECTED;
-    updateConnectionStats();
-    reconnectAttempts = 0;
+  VRAM_LOGI("wifi", "Connecting to WiFi: %s", ssid.c_str());
+  reconnectAttempts = 0;
+  startAttempt();
     
-    Serial.printf("WiFi connected successfully!\n");
-    Serial.printf("IP Address: %s\n", WiFi.localIP().toString().c_str());
-    Serial.printf("Signal Strength: %d dBm\n", WiFi.RSSI());
+  // Sleeps on the event bits; update() handles the outcome and any retries
+  unsigned long startTime = millis();
+  while (millis() - startTime < WIFI_CONNECT_TIMEOUT) {
+    xEventGroupWaitBits(events, WIFI_BIT_GOT_IP | WIFI_BIT_DISCONNECTED, pdFALSE, pdFALSE,
+                        pdMS_TO_TICKS(WIFI_EVENT_WAIT));
+    update();
     
-    return true;
-  } else {
-    status = WIFI_FAILED;
-    stats.failedConnections++;
-    handleConnectionFailure("Connection timeout");
-    return false;
+    int current = status.load();
+    if (current == WIFI_CONNECTED) {
+      return true;
+    }
+    if (current == WIFI_FAILED || current == WIFI_DISCONNECTED) {
+      return false;
+    }
   }
+  
+  VRAM_LOGW("wifi", "WiFi not connected after %d ms, retrying in the background", WIFI_CONNECT_TIMEOUT);
+  return false;
 }
 
 void WiFiManager::disconnect() {
-  Serial.println("Disconnecting WiFi...");
-  WiFi.disconnect();
+  VRAM_LOGI("wifi", "Disconnecting WiFi...");
+  
+  // Set first, so the events the disconnect causes are ignored
   status = WIFI_DISCONNECTED;
-}
-
-bool WiFiManager::isConnected() {
-  return WiFi.status() == WL_CONNECTED && status == WIFI_CONNECTED;
+  if (linkUp) {
+    markLinkDown();
+  }
+  session.setOnline(false);
+  session.close();
+  WiFi.disconnect();
 }
 
 bool WiFiManager::reconnect() {
-  if (reconnectAttempts >= maxReconnectAttempts) {
-    Serial.printf("Max reconnect attempts (%d) reached\n", maxReconnectAttempts);
+  processEvents();
+  if (status.load() == WIFI_CONNECTING) {
     return false;
   }
   
-  Serial.printf("Reconnection attempt %d/%d\n", reconnectAttempts + 1, maxReconnectAttempts);
+  VRAM_LOGI("wifi", "Reconnecting to WiFi: %s", ssid.c_str());
+  if (linkUp) {
+    status = WIFI_RECONNECTING;
+    markLinkDown();
+    WiFi.disconnect();
+  }
   status = WIFI_RECONNECTING;
-  stats.reconnections++;
+  reconnectAttempts = 0;
+  startAttempt();
+  return true;
+}
+
+void WiFiManager::onWiFiEvent(arduino_event_id_t event, arduino_event_info_t info) {
+  // Runs on the WiFi event task: record the change, leave the work to update()
+  if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+    int expected = WIFI_CONNECTING;
+    if (!status.compare_exchange_strong(expected, WIFI_CONNECTED)) {
+      expected = WIFI_RECONNECTING;
+      if (!status.compare_exchange_strong(expected, WIFI_CONNECTED)) return;
+    }
+    session.setOnline(true);
+    xEventGroupSetBits(events, WIFI_BIT_GOT_IP);
+  } else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED) {
+    uint8_t reason = info.wifi_sta_disconnected.reason;
+    
+    // Our own WiFi.disconnect() ahead of a retry
+    if (reason == WIFI_REASON_ASSOC_LEAVE && status.load() != WIFI_CONNECTED) return;
+    
+    lastReason = reason;
+    int expected = WIFI_CONNECTED;
+    status.compare_exchange_strong(expected, WIFI_RECONNECTING);
+    session.setOnline(false);
+    xEventGroupSetBits(events, WIFI_BIT_DISCONNECTED);
+  }
+}
+
+void WiFiManager::processEvents() {
+  EventBits_t bits = xEventGroupClearBits(events, WIFI_BIT_GOT_IP | WIFI_BIT_DISCONNECTED);
+  int current = status.load();
+  
+  if (linkUp && current != WIFI_CONNECTED) {
+    VRAM_LOGW("wifi", "WiFi connection lost! (reason %d)", lastReason.load());
+    markLinkDown();
+    handleConnectionFailure("Connection lost");
+    
+    if (current == WIFI_RECONNECTING && autoReconnect) {
+      reconnectAttempts = 0;
+      startAttempt();
+    } else if (current == WIFI_RECONNECTING) {
+      status = WIFI_DISCONNECTED;
+    }
+  } else if (!linkUp && current == WIFI_CONNECTED) {
+    markLinkUp();
+  } else if ((bits & WIFI_BIT_DISCONNECTED) && current == WIFI_CONNECTING) {
+    failAttempt("Disconnected (reason " + String(lastReason.load()) + ")");
+  }
+}
+
+void WiFiManager::startAttempt() {
+  if (!eventsRegistered) {
+    WiFi.onEvent([this](arduino_event_id_t event, arduino_event_info_t info) {
+      onWiFiEvent(event, info);
+    });
+    WiFi.persistent(false);
+    eventsRegistered = true;
+  }
+  
+  xEventGroupClearBits(events, WIFI_BIT_GOT_IP | WIFI_BIT_DISCONNECTED);
+  if (status.load() == WIFI_RECONNECTING) {
+    stats.reconnections++;
+  }
+  stats.totalConnections++;
+  
+  // Before begin(): GOT_IP may arrive before it returns
+  status = WIFI_CONNECTING;
+  attemptStart = millis();
+  
+  // Retries are ours, with backoff, rather than the driver's
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(false);
+  
+  // Skipping the scan makes a reconnect to the same AP much quicker
+  fastAttempt = hasCachedBSSID;
+  if (fastAttempt) {
+    VRAM_LOGI("wifi", "Fast reconnect on channel %d", cachedChannel);
+    stats.fastReconnects++;
+    WiFi.begin(ssid.c_str(), password.c_str(), cachedChannel, cachedBSSID);
+  } else {
+    WiFi.begin(ssid.c_str(), password.c_str());
+  }
+}
+
+void WiFiManager::failAttempt(const String& error) {
+  stats.failedConnections++;
+  handleConnectionFailure(error);
   reconnectAttempts++;
   
-  WiFi.disconnect();
-  delay(1000);
+  // The AP may have moved; the next attempt scans again
+  bool wasFast = fastAttempt;
+  hasCachedBSSID = false;
+  fastAttempt = false;
   
-  bool success = connect();
-  if (success) {
-    reconnectAttempts = 0;
+  if (!autoReconnect || (maxReconnectAttempts > 0 && reconnectAttempts >= maxReconnectAttempts)) {
+    VRAM_LOGW("wifi", "Giving up after %d attempts", reconnectAttempts);
+    status = WIFI_FAILED;
+    return;
   }
   
-  return success;
+  // Equal jitter: half the backoff fixed, half random, so devices do not retry in step
+  unsigned long backoff = WIFI_BACKOFF_MAX;
+  if (reconnectAttempts < 16 && ((unsigned long)WIFI_BACKOFF_MIN << (reconnectAttempts - 1)) < backoff) {
+    backoff = (unsigned long)WIFI_BACKOFF_MIN << (reconnectAttempts - 1);
+  }
+  retryDelay = wasFast ? 0 : backoff / 2 + random(backoff / 2 + 1);
+  retryFrom = millis();
+  status = WIFI_RECONNECTING;
+  VRAM_LOGI("wifi", "Retrying WiFi in %lu ms", retryDelay);
+}
+
+void WiFiManager::markLinkUp() {
+  linkUp = true;
+  reconnectAttempts = 0;
+  stats.lastConnectTime = millis();
+  stats.signalStrength = WiFi.RSSI();
+  lastConnectionCheck = stats.lastConnectTime;
+  
+  memcpy(cachedBSSID, WiFi.BSSID(), sizeof(cachedBSSID));
+  cachedChannel = WiFi.channel();
+  hasCachedBSSID = true;
+  
+  VRAM_LOGI("wifi", "WiFi connected successfully");
+  VRAM_LOGI("wifi", "IP Address: %s", WiFi.localIP().toString().c_str());
+  VRAM_LOGI("wifi", "Signal Strength: %d dBm", stats.signalStrength);
+}
+
+void WiFiManager::markLinkDown() {
+  linkUp = false;
+  stats.totalUptime += millis() - stats.lastConnectTime;
+  session.setOnline(false);
+  session.close();
 }
 
 String WiFiManager::getStatusString() {
-  switch (status) {
+  switch (status.load()) {
     case WIFI_DISCONNECTED: return "Disconnected";
     case WIFI_CONNECTING: return "Connecting";
     case WIFI_CONNECTED: return "Connected";
@@ -230,18 +409,9 @@ String WiFiManager::getMACAddress() {
   return WiFi.macAddress();
 }
 
-void WiFiManager::updateConnectionStats() {
-  stats.lastConnectTime = millis();
-  stats.signalStrength = WiFi.RSSI();
-  
-  if (status == WIFI_CONNECTED) {
-    stats.totalUptime += millis() - stats.lastConnectTime;
-  }
-}
-
 void WiFiManager::handleConnectionFailure(const String& error) {
   stats.lastError = error;
-  Serial.printf("WiFi connection failed: %s\n", error.c_str());
+  VRAM_LOGW("wifi", "WiFi connection failed: %s", error.c_str());
 }
 
 void WiFiManager::printConnectionInfo() {
@@ -256,8 +426,11 @@ void WiFiManager::printConnectionInfo() {
   Serial.println("\n=== Connection Statistics ===");
   Serial.printf("Total Connections: %lu\n", stats.totalConnections);
   Serial.printf("Failed Connections: %lu\n", stats.failedConnections);
-  Serial.printf("Reconnections: %lu\n", stats.reconnections);
-  Serial.printf("Total Uptime: %lu ms\n", stats.totalUptime);
+  Serial.printf("Reconnections: %lu (%lu fast)\n", stats.reconnections, stats.fastReconnects);
+  Serial.printf("Total Uptime: %lu ms\n", stats.totalUptime + (linkUp ? millis() - stats.lastConnectTime : 0));
+  SessionStats sessionStats = session.getStats();
+  Serial.printf("HTTP Requests: %lu (%lu reused, %lu reconnects)\n", sessionStats.requests, 
+                sessionStats.reusedConnections, sessionStats.reconnects);
   if (!stats.lastError.isEmpty()) {
     Serial.printf("Last Error: %s\n", stats.lastError.c_str());
   }
@@ -267,48 +440,38 @@ void WiFiManager::printConnectionInfo() {
 void WiFiManager::resetStats() {
   memset(&stats, 0, sizeof(stats));
   stats.lastConnectTime = millis();
-  Serial.println("WiFi statistics reset");
+  VRAM_LOGI("wifi", "WiFi statistics reset");
 }
 
 void WiFiManager::update() {
+  processEvents();
+  
   unsigned long currentTime = millis();
+  int current = status.load();
   
-  // Check connection status periodically
-  if (currentTime - lastConnectionCheck > CONNECTION_CHECK_INTERVAL) {
-    checkConnection();
-    lastConnectionCheck = currentTime;
+  if (current == WIFI_CONNECTING && currentTime - attemptStart > WIFI_ATTEMPT_TIMEOUT) {
+    WiFi.disconnect();
+    failAttempt("Connection timeout");
+  } else if (current == WIFI_RECONNECTING && currentTime - retryFrom >= retryDelay) {
+    startAttempt();
   }
   
-  // Handle auto-reconnection
-  if (autoReconnect && !isConnected() && 
-      currentTime - lastReconnectAttempt > WIFI_RECONNECT_INTERVAL) {
-    handleReconnection();
-    lastReconnectAttempt = currentTime;
+  // Signal strength for the statistics
+  if (isConnected() && currentTime - lastConnectionCheck > CONNECTION_CHECK_INTERVAL) {
+    stats.signalStrength = WiFi.RSSI();
+    lastConnectionCheck = currentTime;
   }
 }
 
 bool WiFiManager::checkConnection() {
-  bool wasConnected = isConnected();
-  bool isStillConnected = (WiFi.status() == WL_CONNECTED);
-  
-  if (wasConnected && !isStillConnected) {
-    Serial.println("WiFi connection lost!");
-    status = WIFI_DISCONNECTED;
-    handleConnectionFailure("Connection lost");
-    return false;
-  } else if (!wasConnected && isStillConnected) {
-    Serial.println("WiFi connection restored!");
-    status = WIFI_CONNECTED;
-    updateConnectionStats();
-    return true;
-  }
-  
-  return isStillConnected;
+  processEvents();
+  return isConnected();
 }
 
 void WiFiManager::handleReconnection() {
-  if (status == WIFI_DISCONNECTED || status == WIFI_FAILED) {
-    Serial.println("Attempting auto-reconnection...");
+  int current = status.load();
+  if (current == WIFI_DISCONNECTED || current == WIFI_FAILED) {
+    VRAM_LOGI("wifi", "Attempting auto-reconnection...");
     reconnect();
   }
 }
@@ -318,6 +481,13 @@ bool WiFiManager::ping(const String& host, int timeout) {
     return false;
   }
   
+  // Server URLs go over the shared connection; HEAD leaves no body to drain
+  if (host.startsWith(serverURL)) {
+    int httpCode = session.head(host.substring(serverURL.length()), timeout);
+    session.end();
+    return httpCode > 0;
+  }
+  
   HTTPClient http;
   http.begin(host);
   http.setTimeout(timeout);
@@ -329,24 +499,21 @@ bool WiFiManager::ping(const String& host, int timeout) {
 }
 
 bool WiFiManager::testServerConnection() {
-  Serial.printf("Testing server connection: %s\n", serverURL.c_str());
+  VRAM_LOGI("wifi", "Testing server connection: %s", serverURL.c_str());
   
-  HTTPClient http;
-  String testURL = serverURL + "/api/health";
-  http.begin(testURL);
-  http.setTimeout(5000);
-  
-  int httpCode = http.GET();
+  int httpCode = session.get("/api/health");
   bool success = (httpCode == HTTP_CODE_OK);
   
+  // Read the whole body so the connection stays usable
+  String response = httpCode > 0 ? session.response().getString() : String();
+  
   if (success) {
-    String response = http.getString();
-    Serial.printf("Server test successful: %s\n", response.c_str());
+    VRAM_LOGI("wifi", "Server test successful: %s", response.c_str());
   } else {
-    Serial.printf("Server test failed with code: %d\n", httpCode);
+    VRAM_LOGW("wifi", "Server test failed with code: %d", httpCode);
   }
   
-  http.end();
+  session.end();
   return success;
 }
 
@@ -355,7 +522,7 @@ String WiFiManager::scanNetworks() {
     return "WiFi not connected";
   }
   
-  Serial.println("Scanning for networks...");
+  VRAM_LOGI("wifi", "Scanning for networks...");
   int networks = WiFi.scanNetworks();
   
   String result = "Found " + String(networks) + " networks:\n";
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""
+VRAM System - Access Predictor
+Learns which resources clients tend to request next
+"""
+
+import json
+import logging
+import threading
+from datetime import datetime
+from typing import Dict, Iterable, List, Optional, Tuple
+
+class AccessPredictor:
+    """
+    First-order "what comes next" model built from the access log:
+    - Counts transitions between consecutive accesses of one client
+    - Ignores gaps longer than the sequence window
+    - Halves a resource's counts once they grow large, so old habits fade
+    """
+    
+    def __init__(self, sequence_window: float = 300, max_count: int = 64,
+                 min_support: int = 2, min_confidence: float = 0.2):
+        self.sequence_window = sequence_window    # Seconds between accesses that still count as a sequence
+        self.max_count = max_count                # Per-resource total that triggers aging
+        self.min_support = min_support            # Transitions seen fewer times are never hinted
+        self.min_confidence = min_confidence      # Minimum share of a resource's successors
+        
+        self.transitions: Dict[str, Dict[str, int]] = {}
+        self.last_access: Dict[str, Tuple[str, float]] = {}
+        self.lock = threading.Lock()
+    
+    def load_log(self, log_file: str):
+        """Replay an access log written by ResourceManager.log_access"""
+        replayed = 0
+        try:
+            with open(log_file, 'r') as f:
+                for line in f:
+                    try:
+                        entry = json.loads(line)
+                        if entry.get('prefetch'):
+                            continue
+                        timestamp = datetime.fromisoformat(entry['timestamp']).timestamp()
+                        self.record(entry['resource_id'], entry.get('client_ip', 'unknown'), timestamp)
+                        replayed += 1
+                    except (ValueError, KeyError):
+                        continue
+        except FileNotFoundError:
+            return
+        except Exception as e:
+            logging.error(f"Error replaying access log: {e}")
+        
+        logging.info(f"AccessPredictor replayed {replayed} accesses")
+    
+    def record(self, resource_id: str, client: str, timestamp: Optional[float] = None):
+        """Record a demand access; prefetches must not be recorded"""
+        if timestamp is None:
+            timestamp = datetime.now().timestamp()
+        
+        with self.lock:
+            previous = self.last_access.get(client)
+            self.last_access[client] = (resource_id, timestamp)
+            
+            if previous is None:
+                return
+            previous_id, previous_time = previous
+            if previous_id == resource_id or timestamp - previous_time > self.sequence_window:
+                return
+            
+            successors = self.transitions.setdefault(previous_id, {})
+            successors[resource_id] = successors.get(resource_id, 0) + 1
+            
+            if sum(successors.values()) > self.max_count:
+                for next_id in list(successors):
+                    successors[next_id] //= 2
+                    if successors[next_id] == 0:
+                        del successors[next_id]
+    
+    def predict(self, resource_ids: Iterable[str], limit: int = 3) -> List[str]:
+        """Most likely next resources after any of resource_ids, best first"""
+        requested = set(resource_ids)
+        scores: Dict[str, float] = {}
+        
+        with self.lock:
+            for resource_id in requested:
+                successors = self.transitions.get(resource_id)
+                if not successors:
+                    continue
+                total = sum(successors.values())
+                for next_id, count in successors.items():
+                    confidence = count / total
+                    if next_id in requested or count < self.min_support or confidence < self.min_confidence:
+                        continue
+                    scores[next_id] = max(scores.get(next_id, 0), confidence)
+        
+        ranked = sorted(scores.items(), key=lambda x: x[1], reverse=True)
+        return [next_id for next_id, _ in ranked[:limit]]
+    
+    def forget(self, resource_id: str):
+        """Drop a deleted resource from the model"""
+        with self.lock:
+            self.transitions.pop(resource_id, None)
+            for successors in self.transitions.values():
+                successors.pop(resource_id, None)
+            for client, (last_id, _) in list(self.last_access.items()):
+                if last_id == resource_id:
+                    del self.last_access[client]
\ No newline at end of file
@@ -9,10 +9,13 @@ import os
 import json
 import logging
 import hashlib
-import gzip
 from datetime import datetime
 import time
 from resource_manager import ResourceManager
+from event_channel import EventChannel
+from request_stats import RequestStats
+from metrics_store import MetricsStore
+from resource_manifest import ManifestLimitError, MAX_RECORDS
 
 # Configure logging
 logging.basicConfig(
@@ -26,13 +29,23 @@ logging.basicConfig(
 
 app = Flask(__name__)
 resource_manager = ResourceManager('resources/')
+event_channel = EventChannel()
+metrics_store = MetricsStore()
 
-# Performance tracking
-request_stats = {
-    'total_requests': 0,
-    'avg_response_time': 0,
-    'failed_requests': 0
-}
+# Batch limits
+BATCH_MAX_RESOURCES = 16
+
+# Clients keep this many content hash characters per cached resource as its ETag
+ETAG_LENGTH = 16
+
+# Clients store resource IDs inline; CACHE_ID_LENGTH in resource_cache.h, less the NUL
+MAX_RESOURCE_ID_LENGTH = 31
+
+# Likely-next resources suggested per response
+PREFETCH_HINT_LIMIT = 3
+
+# Performance tracking; sharded per serving thread
+request_stats = RequestStats()
 
 def track_performance(func):
     """Decorator to track API performance"""
@@ -40,21 +53,70 @@ def track_performance(func):
         start_time = time.time()
         try:
             result = func(*args, **kwargs)
-            request_stats['total_requests'] += 1
             response_time = (time.time() - start_time) * 1000  # ms
-            request_stats['avg_response_time'] = (
-                (request_stats['avg_response_time'] * (request_stats['total_requests'] - 1) + response_time) 
-                / request_stats['total_requests']
-            )
+            request_stats.record(response_time)
             logging.info(f"API call {func.__name__} completed in {response_time:.2f}ms")
             return result
         except Exception as e:
-            request_stats['failed_requests'] += 1
+            request_stats.record_failure()
             logging.error(f"API call {func.__name__} failed: {str(e)}")
             return jsonify({'error': str(e)}), 500
     wrapper.__name__ = func.__name__
     return wrapper
 
+def accepted_encodings(compress):
+    """
+    Precompressed variants a request may be sent, most preferred first
+    
+    compress is true (any encoding the device inflates, raw deflate first
+    as it skips the gzip header and CRC32), 'gzip', 'deflate' or false.
+    """
+    value = str(compress).lower()
+    if value == 'true':
+        return ('deflate', 'gzip')
+    if value in ('gzip', 'deflate'):
+        return (value,)
+    return ()
+
+def resource_etag(version_info):
+    """Short strong ETag derived from the resource content hash"""
+    return (version_info.get('hash') or '')[:ETAG_LENGTH]
+
+def is_not_modified(version_info):
+    """True when the request's If-None-Match names the current content"""
+    etag = resource_etag(version_info)
+    return bool(etag) and request.if_none_match.contains(etag)
+
+def not_modified_response(version_info):
+    """Empty 304 carrying the same validators as a full response"""
+    response = app.response_class(status=304)
+    response.set_etag(resource_etag(version_info))
+    response.headers['X-Resource-Version'] = str(version_info['version'])
+    return response
+
+def is_prefetch_request():
+    """True for speculative fetches made on a previous hint"""
+    return request.args.get('prefetch', 'false').lower() == 'true'
+
+def log_resource_access(resource_id):
+    """Log an access; only demand accesses teach the predictor"""
+    resource_manager.log_access(resource_id, request.remote_addr, prefetch=is_prefetch_request())
+
+def publish_invalidation(resource_id, version, data_hash):
+    """Tell streaming clients a resource changed, carrying the ETag they cache it under"""
+    event_channel.publish_invalidation(resource_id, version, (data_hash or '')[:ETAG_LENGTH])
+
+resource_manager.add_change_listener(publish_invalidation)
+
+def add_prefetch_hints(response, resource_ids):
+    """Suggest what the client is likely to need next in X-Prefetch-Hints"""
+    if is_prefetch_request():
+        return response  # Hints on hints would chain speculative fetches
+    hints = resource_manager.get_prefetch_hints(resource_ids, PREFETCH_HINT_LIMIT)
+    if hints:
+        response.headers['X-Prefetch-Hints'] = ','.join(hints)
+    return response
+
 @app.route('/api/health', methods=['GET'])
 @track_performance
 def health_check():
@@ -62,9 +124,22 @@ def health_check():
     return jsonify({
         'status': 'healthy',
         'timestamp': datetime.now().isoformat(),
-        'stats': request_stats
+        'stats': request_stats.snapshot()
     })
 
+@app.route('/api/events', methods=['GET'])
+def stream_events():
+    """
+    Server-Sent Events stream of heartbeats and resource invalidations
+    
+    Not tracked as a request: it stays open for as long as the client does.
+    """
+    last_event_id = request.headers.get('Last-Event-ID') or request.args.get('last_event_id')
+    response = app.response_class(event_channel.stream(last_event_id), mimetype='text/event-stream')
+    response.headers['Cache-Control'] = 'no-cache'
+    response.headers['X-Accel-Buffering'] = 'no'  # Keep proxies from holding events back
+    return response
+
 @app.route('/api/resources/<resource_id>', methods=['GET'])
 @track_performance
 def get_resource(resource_id):
@@ -75,38 +150,198 @@ def get_resource(resource_id):
     try:
         compress = request.args.get('compress', 'false').lower() == 'true'
         
-        resource_data = resource_manager.get_resource(resource_id)
-        if not resource_data:
+        # Revalidation only needs the metadata
+        version_info = resource_manager.get_version_info(resource_id)
+        if version_info and is_not_modified(version_info):
+            log_resource_access(resource_id)
+            return add_prefetch_hints(not_modified_response(version_info), [resource_id])
+        
+        # Compressed JSON payloads are always gzip, already built at upload
+        result = resource_manager.get_resource_body(resource_id, ('gzip',) if compress else ())
+        if not result:
             return jsonify({'error': 'Resource not found'}), 404
+        body, compression, version_info = result
         
         # Log access
-        resource_manager.log_access(resource_id, request.remote_addr)
+        log_resource_access(resource_id)
         
-        if compress and len(resource_data) > 512:  # Compress if > 512 bytes
-            compressed_data = gzip.compress(resource_data)
+        if compression == 'gzip':
             response = jsonify({
                 'resource_id': resource_id,
-                'data': compressed_data.hex(),  # Send as hex for JSON compatibility
+                'data': body.hex(),  # Send as hex for JSON compatibility
                 'compressed': True,
-                'original_size': len(resource_data),
-                'compressed_size': len(compressed_data),
+                'original_size': version_info['size'],
+                'compressed_size': len(body),
                 'timestamp': datetime.now().isoformat()
             })
         else:
             response = jsonify({
                 'resource_id': resource_id,
-                'data': resource_data.decode('utf-8') if isinstance(resource_data, bytes) else resource_data,
+                'data': body.decode('utf-8') if isinstance(body, bytes) else body,
                 'compressed': False,
-                'size': len(resource_data),
+                'size': len(body),
                 'timestamp': datetime.now().isoformat()
             })
         
-        return response
+        response.set_etag(resource_etag(version_info))
+        return add_prefetch_hints(response, [resource_id])
         
     except Exception as e:
         logging.error(f"Error getting resource {resource_id}: {str(e)}")
         return jsonify({'error': 'Internal server error'}), 500
 
+@app.route('/api/resources/<resource_id>/raw', methods=['GET'])
+@track_performance
+def get_resource_raw(resource_id):
+    """
+    Get a specific resource as raw bytes
+    Metadata travels in X-Resource-* headers instead of a JSON envelope
+    """
+    try:
+        encodings = accepted_encodings(request.args.get('compress', 'false'))
+        
+        # Revalidation only needs the metadata
+        version_info = resource_manager.get_version_info(resource_id)
+        if version_info and is_not_modified(version_info):
+            log_resource_access(resource_id)
+            return add_prefetch_hints(not_modified_response(version_info), [resource_id])
+        
+        # Sent straight from the stored blob or its precompressed variant;
+        # headers come with it, in case the resource changed since the check above
+        result = resource_manager.get_resource_body(resource_id, encodings)
+        if not result:
+            return jsonify({'error': 'Resource not found'}), 404
+        body, compression, version_info = result
+        
+        # Log access
+        log_resource_access(resource_id)
+        
+        response = app.response_class(body, mimetype='application/octet-stream')
+        response.headers['X-Resource-Size'] = str(version_info['size'])
+        response.headers['X-Resource-Hash'] = version_info['hash']
+        response.headers['X-Resource-Version'] = str(version_info['version'])
+        response.headers['X-Resource-Compression'] = compression
+        response.set_etag(resource_etag(version_info))
+        return add_prefetch_hints(response, [resource_id])
+    
+    except Exception as e:
+        logging.error(f"Error getting raw resource {resource_id}: {str(e)}")
+        return jsonify({'error': 'Internal server error'}), 500
+
+@app.route('/api/resources/<resource_id>/delta', methods=['GET'])
+@track_performance
+def get_resource_delta(resource_id):
+    """
+    Get the patch from a version the client holds to the current content
+    Query: from=<cached version>, base=<cached ETag, optional>
+    The body is a series of "<offset> <delete> <insert>\\n" hunks, each followed
+    by <insert> bytes; X-Delta-Capacity is the buffer size patching needs.
+    410 when that version is no longer kept and the whole resource must be fetched
+    """
+    try:
+        from_version = request.args.get('from', type=int)
+        if from_version is None:
+            return jsonify({'error': 'Missing required parameter: from'}), 400
+        base_etag = request.args.get('base') or None
+        
+        version_info = resource_manager.get_version_info(resource_id)
+        if not version_info:
+            return jsonify({'error': 'Resource not found'}), 404
+        
+        etag = resource_etag(version_info)
+        if from_version == version_info['version'] and (not base_etag or base_etag == etag):
+            log_resource_access(resource_id)
+            return add_prefetch_hints(not_modified_response(version_info), [resource_id])
+        
+        delta = resource_manager.get_delta(resource_id, from_version, base_etag)
+        if delta is None:
+            return jsonify({'error': f'No delta from version {from_version}',
+                            'version': version_info['version']}), 410
+        
+        log_resource_access(resource_id)
+        
+        response = app.response_class(delta['body'], mimetype='application/octet-stream')
+        response.headers['X-Resource-Size'] = str(version_info['size'])
+        response.headers['X-Resource-Hash'] = version_info['hash']
+        response.headers['X-Resource-Version'] = str(version_info['version'])
+        response.headers['X-Delta-Base'] = str(delta['base_version'])
+        response.headers['X-Delta-Capacity'] = str(delta['capacity'])
+        response.set_etag(etag)
+        return add_prefetch_hints(response, [resource_id])
+    
+    except Exception as e:
+        logging.error(f"Error getting delta for {resource_id}: {str(e)}")
+        return jsonify({'error': 'Internal server error'}), 500
+
+@app.route('/api/resources/batch', methods=['POST'])
+@track_performance
+def get_resource_batch():
+    """
+    Get several resources in one framed octet-stream response
+    Each frame is a header line followed by <length> body bytes:
+    "<status> <resource_id> <version> <size> <compression> <length> <hash>\\n"
+    Status is 200 (body follows), 304 (cached copy is current) or 404
+    """
+    try:
+        data = request.get_json(silent=True)
+        if not data or not isinstance(data.get('resources'), list):
+            return jsonify({'error': 'Missing required field: resources'}), 400
+        
+        items = data['resources']
+        if len(items) > BATCH_MAX_RESOURCES:
+            return jsonify({'error': f'At most {BATCH_MAX_RESOURCES} resources per batch'}), 400
+        
+        encodings = accepted_encodings(data.get('compress', False))
+        frames = []
+        requested_ids = []
+        
+        for item in items:
+            # Items are {"id": ..., "version": <cached version, 0 if none>, "etag": ...} or bare IDs
+            if isinstance(item, dict):
+                resource_id = str(item.get('id', ''))
+                cached_version = item.get('version', 0)
+                cached_etag = item.get('etag')
+            else:
+                resource_id = str(item)
+                cached_version = 0
+                cached_etag = None
+            
+            if not resource_id or any(c.isspace() for c in resource_id):
+                return jsonify({'error': f'Invalid resource id: {resource_id!r}'}), 400
+            requested_ids.append(resource_id)
+            
+            # Up-to-date items are answered from metadata without reading the file.
+            # The ETag wins over the version, which restarts if a resource is recreated.
+            version_info = resource_manager.get_version_info(resource_id)
+            if version_info and cached_etag:
+                current = cached_etag == resource_etag(version_info)
+            else:
+                current = version_info is not None and cached_version == version_info['version']
+            if current:
+                log_resource_access(resource_id)
+                frames.append(f'304 {resource_id} {version_info["version"]} {version_info["size"]} none 0 '
+                              f'{version_info["hash"] or "-"}\n'.encode())
+                continue
+            
+            result = resource_manager.get_resource_body(resource_id, encodings) if version_info else None
+            if result is None:
+                frames.append(f'404 {resource_id} 0 0 none 0 -\n'.encode())
+                continue
+            body, compression, version_info = result
+            
+            version = version_info['version']
+            log_resource_access(resource_id)
+            frames.append(f'200 {resource_id} {version} {version_info["size"]} {compression} {len(body)} {version_info["hash"] or "-"}\n'.encode())
+            frames.append(body)
+        
+        response = app.response_class(b''.join(frames), mimetype='application/octet-stream')
+        response.headers['X-Batch-Count'] = str(len(items))
+        return add_prefetch_hints(response, requested_ids)
+    
+    except Exception as e:
+        logging.error(f"Error getting resource batch: {str(e)}")
+        return jsonify({'error': 'Internal server error'}), 500
+
 @app.route('/api/resources', methods=['GET'])
 @track_performance
 def list_resources():
@@ -130,7 +365,7 @@ def list_resources():
         
         return jsonify({
             'resources': resources,
-            'total_count': len(resource_manager.get_all_resources()),
+            'total_count': resource_manager.count_resources(),
             'page': page,
             'per_page': per_page,
             'timestamp': datetime.now().isoformat()
@@ -140,6 +375,32 @@ def list_resources():
         logging.error(f"Error listing resources: {str(e)}")
         return jsonify({'error': 'Internal server error'}), 500
 
+@app.route('/api/manifest', methods=['GET'])
+@track_performance
+def get_manifest():
+    """
+    Get every resource's ID hash, size, version, priority and category
+    as fixed-width binary records (see resource_manifest.py)
+    """
+    try:
+        manifest, etag = resource_manager.get_manifest()
+        if request.if_none_match.contains(etag):
+            response = app.response_class(status=304)
+            response.set_etag(etag)
+            return response
+        
+        response = app.response_class(manifest, mimetype='application/octet-stream')
+        response.set_etag(etag)
+        return response
+    
+    except ManifestLimitError as e:
+        logging.error(f"Catalog exceeds the manifest limits: {str(e)}")
+        return jsonify({'error': f'Catalog exceeds the manifest limits: {str(e)}'}), 500
+    
+    except Exception as e:
+        logging.error(f"Error building manifest: {str(e)}")
+        return jsonify({'error': 'Internal server error'}), 500
+
 @app.route('/api/resources/<resource_id>/version', methods=['GET'])
 @track_performance
 def check_version(resource_id):
@@ -170,6 +431,10 @@ def upload_resource():
         
         resource_id = data['resource_id']
         content = data['content']
+        if not isinstance(resource_id, str) or not 0 < len(resource_id.encode('utf-8')) <= MAX_RESOURCE_ID_LENGTH:
+            return jsonify({'error': f'resource_id must be 1 to {MAX_RESOURCE_ID_LENGTH} bytes'}), 400
+        if resource_manager.count_resources() >= MAX_RECORDS and resource_manager.get_version_info(resource_id) is None:
+            return jsonify({'error': f'Catalog is full: the manifest lists at most {MAX_RECORDS} resources'}), 507
         category = data.get('category', 'general')
         priority = data.get('priority', 1)
         
@@ -222,7 +487,9 @@ def get_stats():
     """
     try:
         stats = resource_manager.get_usage_stats()
-        stats.update(request_stats)
+        stats.update(request_stats.snapshot())
+        stats['event_channel'] = event_channel.get_stats()
+        stats['device_metrics'] = metrics_store.get_stats()
         
         return jsonify({
             'server_stats': stats,
@@ -233,6 +500,59 @@ def get_stats():
         logging.error(f"Error getting stats: {str(e)}")
         return jsonify({'error': 'Internal server error'}), 500
 
+@app.route('/api/metrics', methods=['POST'])
+@track_performance
+def report_metrics():
+    """
+    Record a device's load stage histograms and cache/heap counters
+    """
+    try:
+        data = request.get_json(silent=True)
+        if not isinstance(data, dict) or not data.get('device'):
+            return jsonify({'error': 'Device id required'}), 400
+        
+        device_id = str(data['device'])
+        try:
+            metrics_store.ingest(device_id, data)
+        except (ValueError, TypeError, AttributeError) as e:
+            return jsonify({'error': f'Invalid metrics report: {str(e)}'}), 400
+        
+        return jsonify({
+            'message': 'Metrics recorded',
+            'device': device_id,
+            'timestamp': datetime.now().isoformat()
+        })
+    
+    except Exception as e:
+        logging.error(f"Error recording metrics: {str(e)}")
+        return jsonify({'error': 'Internal server error'}), 500
+
+@app.route('/api/metrics', methods=['GET'])
+@track_performance
+def get_metrics():
+    """
+    Get stage latency percentiles for the fleet and each device, or one device
+    """
+    try:
+        device_id = request.args.get('device')
+        if device_id:
+            device = metrics_store.get_device(device_id)
+            if device is None:
+                return jsonify({'error': 'Device not found'}), 404
+            return jsonify({
+                'device': device_id,
+                'metrics': device,
+                'timestamp': datetime.now().isoformat()
+            })
+        
+        summary = metrics_store.get_summary()
+        summary['timestamp'] = datetime.now().isoformat()
+        return jsonify(summary)
+    
+    except Exception as e:
+        logging.error(f"Error getting metrics: {str(e)}")
+        return jsonify({'error': 'Internal server error'}), 500
+
 @app.route('/api/optimize', methods=['POST'])
 @track_performance
 def optimize_resources():
@@ -263,14 +583,18 @@ def not_found(error):
 def internal_error(error):
     return jsonify({'error': 'Internal server error'}), 500
 
-if __name__ == '__main__':
+def prepare():
+    """Startup work for either way of serving"""
     logging.info("Starting VRAM System Server...")
     logging.info(f"Resource directory: {resource_manager.resource_dir}")
     
     # Create initial demo resources
     resource_manager.create_demo_resources()
     
-    # Run the server
+if __name__ == '__main__':
+    prepare()
+    
+    # Development server; gunicorn.conf.py runs it in production
     app.run(
         host='0.0.0.0',
         port=5000,
@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""
+VRAM System - Blob Store
+Content-addressed resource files with precompressed variants
+"""
+
+import gzip
+import os
+import zlib
+from typing import Dict, Optional
+
+# Suffix of each precompressed variant next to its blob
+ENCODING_SUFFIXES = {
+    'gzip': '.gz',          # For HTTP clients and the JSON endpoint
+    'deflate': '.deflate'   # Raw deflate: no header or CRC32 for the device to check
+}
+
+# Smaller blobs are always sent as they are
+MIN_COMPRESS_SIZE = 512
+
+def _encode(data: bytes, encoding: str) -> bytes:
+    # Built once per blob, so the slowest, smallest level is worth it
+    if encoding == 'gzip':
+        return gzip.compress(data, compresslevel=9, mtime=0)
+    compressor = zlib.compressobj(9, zlib.DEFLATED, -zlib.MAX_WBITS)
+    return compressor.compress(data) + compressor.flush()
+
+class BlobStore:
+    """
+    Files named by their SHA-256 under blobs/<hash[:2]>/<hash>:
+    - Identical content is stored once, however many resources and versions
+      refer to it; the caller decides when a blob is no longer referenced
+    - Compressed variants are built with the blob and kept only when smaller,
+      so no request ever pays for compression
+    """
+    
+    def __init__(self, root: str):
+        self.root = root
+        os.makedirs(self.root, exist_ok=True)
+    
+    def path(self, data_hash: str, encoding: Optional[str] = None) -> str:
+        suffix = ENCODING_SUFFIXES[encoding] if encoding else ''
+        return os.path.join(self.root, data_hash[:2], data_hash + suffix)
+    
+    def contains(self, data_hash: str) -> bool:
+        return os.path.exists(self.path(data_hash))
+    
+    def _write(self, path: str, data: bytes):
+        # Written aside and renamed, so a reader never sees a partial blob
+        temp_path = path + '.tmp'
+        with open(temp_path, 'wb') as f:
+            f.write(data)
+        os.replace(temp_path, path)
+    
+    def put(self, data_hash: str, data: bytes) -> Dict[str, int]:
+        """Store content and its variants unless already present; returns variant sizes"""
+        if self.contains(data_hash):
+            return self.encodings(data_hash)
+        
+        os.makedirs(os.path.dirname(self.path(data_hash)), exist_ok=True)
+        encodings = {}
+        if len(data) > MIN_COMPRESS_SIZE:
+            for encoding in ENCODING_SUFFIXES:
+                encoded = _encode(data, encoding)
+                if len(encoded) < len(data):
+                    self._write(self.path(data_hash, encoding), encoded)
+                    encodings[encoding] = len(encoded)
+        # The plain blob goes last: once it exists, so do its variants
+        self._write(self.path(data_hash), data)
+        return encodings
+    
+    def encodings(self, data_hash: str) -> Dict[str, int]:
+        """Sizes of the variants kept for a blob"""
+        encodings = {}
+        for encoding in ENCODING_SUFFIXES:
+            path = self.path(data_hash, encoding)
+            if os.path.exists(path):
+                encodings[encoding] = os.path.getsize(path)
+        return encodings
+    
+    def read(self, data_hash: str, encoding: Optional[str] = None) -> bytes:
+        with open(self.path(data_hash, encoding), 'rb') as f:
+            return f.read()
+    
+    def remove(self, data_hash: str):
+        for encoding in [None] + list(ENCODING_SUFFIXES):
+            path = self.path(data_hash, encoding)
+            if os.path.exists(path):
+                os.remove(path)
\ No newline at end of file
@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+"""
+VRAM System - Content Cache
+Resource bytes kept in memory, least recently used dropped first
+"""
+
+import threading
+from collections import OrderedDict
+from typing import Any, Dict, Optional, Tuple
+
+class ContentCache:
+    """
+    Byte-bounded LRU of resource contents:
+    - Each entry remembers the content hash it was stored under, and a
+      lookup only hits when that is still the hash in the metadata, so a
+      stale entry can never be served after an update
+    - Resources larger than a share of the budget are not cached, so one
+      big file cannot flush everything else
+    """
+    
+    def __init__(self, max_bytes: int = 8 * 1024 * 1024, max_entry_share: float = 0.25):
+        self.max_bytes = max_bytes                            # Total content kept
+        self.max_entry_bytes = int(max_bytes * max_entry_share)
+        self.entries: 'OrderedDict[str, Tuple[str, bytes]]' = OrderedDict()
+        self.size = 0
+        self.lock = threading.Lock()
+        
+        self.hits = 0
+        self.misses = 0
+        self.evictions = 0
+    
+    def get(self, resource_id: str, data_hash: Optional[str]) -> Optional[bytes]:
+        """Cached content of resource_id if it was stored under data_hash"""
+        with self.lock:
+            entry = self.entries.get(resource_id)
+            if entry is None or entry[0] != data_hash:
+                self.misses += 1
+                return None
+            self.entries.move_to_end(resource_id)
+            self.hits += 1
+            return entry[1]
+    
+    def put(self, resource_id: str, data_hash: str, data: bytes):
+        """Cache content, replacing any older entry of the same resource"""
+        with self.lock:
+            self._remove(resource_id)
+            if len(data) > self.max_entry_bytes:
+                return
+            self.entries[resource_id] = (data_hash, data)
+            self.size += len(data)
+            while self.size > self.max_bytes:
+                _, (_, old) = self.entries.popitem(last=False)
+                self.size -= len(old)
+                self.evictions += 1
+    
+    def discard(self, resource_id: str):
+        with self.lock:
+            self._remove(resource_id)
+    
+    def _remove(self, resource_id: str):
+        """Drop an entry; lock held"""
+        entry = self.entries.pop(resource_id, None)
+        if entry is not None:
+            self.size -= len(entry[1])
+    
+    def get_stats(self) -> Dict[str, Any]:
+        with self.lock:
+            lookups = self.hits + self.misses
+            return {
+                'entries': len(self.entries),
+                'size_bytes': self.size,
+                'max_bytes': self.max_bytes,
+                'hits': self.hits,
+                'misses': self.misses,
+                'hit_rate': round(self.hits / lookups, 3) if lookups else 0,
+                'evictions': self.evictions
+            }
\ No newline at end of file
@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+"""
+VRAM System - Event Channel
+Server-Sent Events stream of heartbeats and resource invalidations
+"""
+
+import queue
+import threading
+import time
+from collections import deque
+from typing import Dict, Iterator, List, Optional
+
+class _Subscriber:
+    """One open stream; lagged once its queue overflowed"""
+    
+    def __init__(self, depth: int):
+        self.events = queue.Queue(maxsize=depth)
+        self.lagged = False
+
+class EventChannel:
+    """
+    Fans events out to every open stream:
+    - Event ids are "<epoch>-<seq>", the epoch changing with each server start
+    - Recent events are kept, so a client reconnecting with Last-Event-ID
+      is replayed what it missed
+    - A client whose id is unknown, too old, or who fell behind is sent a
+      reset instead, telling it to revalidate everything it caches
+    - Idle streams carry a heartbeat, which is all clients need for liveness
+    - Waits use threading and queue only, so under gunicorn's gevent worker,
+      which patches both before importing the app, a stream blocked in its
+      queue is a parked greenlet and never holds up other requests
+    """
+    
+    def __init__(self, heartbeat_interval: float = 15, replay_depth: int = 256,
+                 queue_depth: int = 64):
+        self.heartbeat_interval = heartbeat_interval  # Seconds of silence before a heartbeat
+        self.queue_depth = queue_depth                # Events buffered per stream
+        self.epoch = format(int(time.time()), 'x')
+        self.seq = 0
+        self.replay = deque(maxlen=replay_depth)      # (seq, frame) of recent events
+        self.subscribers = set()
+        self.lock = threading.Lock()
+        
+        self.stats = {
+            'connects': 0,
+            'published': 0,
+            'replayed': 0,
+            'resets': 0,
+            'lagged': 0
+        }
+    
+    def _event_id(self, seq: int) -> str:
+        return f'{self.epoch}-{seq}'
+    
+    def _frame(self, name: str, data: str = '', event_id: Optional[str] = None) -> str:
+        lines = []
+        if event_id:
+            lines.append(f'id: {event_id}')
+        lines.append(f'event: {name}')
+        lines.append(f'data: {data}')
+        return '\n'.join(lines) + '\n\n'
+    
+    def _missed(self, last_event_id: Optional[str]) -> Optional[List[str]]:
+        """Frames after last_event_id, or None when they are no longer known; lock held"""
+        if not last_event_id:
+            return []
+        epoch, _, seq = last_event_id.partition('-')
+        if epoch != self.epoch or not seq.isdigit() or int(seq) > self.seq:
+            return None
+        seq = int(seq)
+        if seq == self.seq:
+            return []
+        if not self.replay or self.replay[0][0] > seq + 1:
+            return None
+        return [frame for event_seq, frame in self.replay if event_seq > seq]
+    
+    def publish(self, name: str, data: str):
+        """Send an event to every open stream and keep it for replay"""
+        with self.lock:
+            self.seq += 1
+            frame = self._frame(name, data, self._event_id(self.seq))
+            self.replay.append((self.seq, frame))
+            self.stats['published'] += 1
+            for subscriber in self.subscribers:
+                if subscriber.lagged:
+                    continue
+                try:
+                    subscriber.events.put_nowait(frame)
+                except queue.Full:
+                    subscriber.lagged = True
+                    self.stats['lagged'] += 1
+    
+    def publish_invalidation(self, resource_id: str, version: int, etag: str):
+        """A resource changed; version 0 and an empty etag once it is deleted"""
+        self.publish('invalidate', f'{resource_id} {version} {etag or "-"}')
+    
+    def _reset_frame(self) -> str:
+        """Reset positioned at the newest event; lock held"""
+        self.stats['resets'] += 1
+        return self._frame('reset', '', self._event_id(self.seq))
+    
+    def stream(self, last_event_id: Optional[str] = None) -> Iterator[str]:
+        """Generator of SSE frames for one client, ending when it disconnects"""
+        subscriber = _Subscriber(self.queue_depth)
+        with self.lock:
+            missed = self._missed(last_event_id)
+            if missed is None:
+                first = [self._reset_frame()]
+            else:
+                # The first heartbeat tells a new client where it stands
+                self.stats['replayed'] += len(missed)
+                first = missed + [self._frame('heartbeat', '', self._event_id(self.seq))]
+            self.subscribers.add(subscriber)
+            self.stats['connects'] += 1
+        
+        try:
+            for frame in first:
+                yield frame
+            while True:
+                try:
+                    frame = subscriber.events.get(timeout=self.heartbeat_interval)
+                except queue.Empty:
+                    frame = self._frame('heartbeat')
+                
+                if subscriber.lagged:
+                    # Queued events are covered by the reset
+                    with self.lock:
+                        while not subscriber.events.empty():
+                            subscriber.events.get_nowait()
+                        subscriber.lagged = False
+                        frame = self._reset_frame()
+                yield frame
+        finally:
+            with self.lock:
+                self.subscribers.discard(subscriber)
+    
+    def get_stats(self) -> Dict[str, int]:
+        with self.lock:
+            stats = dict(self.stats)
+            stats['subscribers'] = len(self.subscribers)
+        return stats
\ No newline at end of file
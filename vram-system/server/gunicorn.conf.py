@@ -0,0 +1,40 @@
+#!/usr/bin/env python3
+"""
+VRAM System - Production Server Configuration
+gunicorn -c gunicorn.conf.py app:app
+"""
+
+import os
+
+bind = os.environ.get('VRAM_BIND', '0.0.0.0:5000')
+
+# One process: metadata, the content cache and event stream subscribers all
+# live in ResourceManager and EventChannel memory, which workers would not
+# share. Concurrency comes from gevent instead: every connection, an open
+# event stream or an idle keep-alive one, is a greenlet on the worker's event
+# loop rather than an OS thread, so one per device costs a few KB
+workers = 1
+worker_class = 'gevent'
+worker_connections = int(os.environ.get('VRAM_CONNECTIONS', '2048'))
+
+# The gevent worker patches threading, queue and socket before it imports the
+# app; preloading would build EventChannel and the locks unpatched
+preload_app = False
+
+# Devices reuse one connection per HttpSession, held for up to 75s between
+# requests; each waiting one is a parked greenlet
+keepalive = 75
+timeout = 60
+graceful_timeout = 10
+
+accesslog = None            # app.py logs every API call already
+errorlog = '-'
+
+def post_worker_init(worker):
+    # An unpatched EventChannel would block the whole loop in a stream's queue wait
+    from gevent import monkey
+    if not monkey.is_module_patched('threading'):
+        raise RuntimeError('gevent worker did not patch threading; event streams would stall every request')
+    
+    from app import prepare
+    prepare()
\ No newline at end of file
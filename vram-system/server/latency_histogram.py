@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""
+VRAM System - Latency Histogram
+Log-linear microsecond buckets shared with the device's load_metrics.h
+"""
+
+from typing import Any, Dict, Iterable, List
+
+# Same layout as the device: exact below 4us, then 4 buckets per power of two
+SUB_BUCKET_BITS = 2
+SUB_BUCKETS = 1 << SUB_BUCKET_BITS
+BUCKETS = 100                               # Up to 2^26us (67s); longer times land in the last
+
+def bucket_for(micros: int) -> int:
+    if micros < SUB_BUCKETS:
+        return max(micros, 0)
+    shift = micros.bit_length() - 1 - SUB_BUCKET_BITS
+    bucket = (shift + 1) * SUB_BUCKETS + (micros >> shift) - SUB_BUCKETS
+    return min(bucket, BUCKETS - 1)
+
+def bucket_upper(bucket: int) -> int:
+    """Largest value a bucket holds"""
+    if bucket < SUB_BUCKETS:
+        return bucket
+    shift = bucket // SUB_BUCKETS - 1
+    top = SUB_BUCKETS + bucket % SUB_BUCKETS
+    return ((top + 1) << shift) - 1
+
+class LatencyHistogram:
+    """
+    Fixed-bucket latency distribution:
+    - Recording and merging are a few integer operations, whatever the count
+    - Percentiles are bucket upper bounds, within 25% of the true value and
+      never above the largest value seen
+    """
+    
+    __slots__ = ('counts', 'count', 'sum', 'max')
+    
+    def __init__(self):
+        self.counts: List[int] = [0] * BUCKETS
+        self.count = 0
+        self.sum = 0
+        self.max = 0
+    
+    def record(self, micros: int):
+        micros = int(micros)
+        self.counts[bucket_for(micros)] += 1
+        self.count += 1
+        self.sum += micros
+        self.max = max(self.max, micros)
+    
+    def merge(self, other: 'LatencyHistogram'):
+        for bucket, count in enumerate(other.counts):
+            self.counts[bucket] += count
+        self.count += other.count
+        self.sum += other.sum
+        self.max = max(self.max, other.max)
+    
+    @classmethod
+    def from_report(cls, report: Dict[str, Any]) -> 'LatencyHistogram':
+        """Histogram from a device report: {"n", "sum", "max", "b": [bucket, count, ...]}"""
+        histogram = cls()
+        pairs = report.get('b', [])
+        if not isinstance(pairs, list) or len(pairs) % 2 != 0:
+            raise ValueError('Histogram buckets must be [bucket, count, ...] pairs')
+        for bucket, count in zip(pairs[0::2], pairs[1::2]):
+            if not isinstance(bucket, int) or not isinstance(count, int) or \
+               not 0 <= bucket < BUCKETS or count < 0:
+                raise ValueError(f'Invalid histogram bucket {bucket}: {count}')
+            histogram.counts[bucket] += count
+        
+        # Device bucket counts saturate, so n can exceed their sum
+        histogram.count = max(int(report.get('n', 0)), sum(histogram.counts))
+        histogram.sum = int(report.get('sum', 0))
+        histogram.max = int(report.get('max', 0))
+        return histogram
+    
+    def percentile(self, fraction: float) -> int:
+        counted = sum(self.counts)
+        if counted == 0:
+            return 0
+        rank = max(int(fraction * counted + 0.5), 1)
+        seen = 0
+        for bucket, count in enumerate(self.counts):
+            seen += count
+            if seen >= rank:
+                return min(bucket_upper(bucket), self.max)
+        return self.max
+    
+    def summary(self, percentiles: Iterable[int] = (50, 90, 99)) -> Dict[str, Any]:
+        result = {
+            'count': self.count,
+            'mean_us': round(self.sum / self.count) if self.count else 0,
+            'max_us': self.max
+        }
+        for p in percentiles:
+            result[f'p{p}_us'] = self.percentile(p / 100)
+        return result
\ No newline at end of file
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""
+VRAM System - Metrics Store
+Per-device load stage histograms and counters reported by clients
+"""
+
+import threading
+import time
+from collections import OrderedDict
+from typing import Any, Dict, Optional
+
+from latency_histogram import LatencyHistogram
+
+# Stages a device times for every load, in order
+LOAD_STAGES = ('connect', 'first_byte', 'transfer', 'decode', 'cache_insert')
+
+class DeviceMetrics:
+    """Everything one device has reported"""
+    
+    def __init__(self):
+        self.stages = {stage: LatencyHistogram() for stage in LOAD_STAGES}
+        self.reports = 0
+        self.first_seen = time.time()
+        self.last_seen = self.first_seen
+        self.uptime = 0
+        self.cache: Dict[str, int] = {}
+        self.memory: Dict[str, int] = {}
+        self.lowest_free_heap: Optional[int] = None
+        self.heap: Optional[Dict[str, Any]] = None
+
+class MetricsStore:
+    """
+    In-memory aggregation of device metric reports:
+    - Each report carries the stage histograms since the device's previous
+      one, so they are merged into its running totals and the fleet's
+    - Cache and heap counters are kept as last reported, plus the lowest
+      free heap any report has shown
+    - Heap profiles are cumulative, so only the latest is kept; allocation
+      rates per identifier come from the difference to the one before
+    - When more devices report than are kept, the longest silent is dropped
+    """
+    
+    def __init__(self, max_devices: int = 256):
+        self.max_devices = max_devices
+        self.devices: 'OrderedDict[str, DeviceMetrics]' = OrderedDict()
+        self.fleet = {stage: LatencyHistogram() for stage in LOAD_STAGES}
+        self.reports = 0
+        self.lock = threading.Lock()
+    
+    def ingest(self, device_id: str, report: Dict[str, Any]):
+        """Merge one report; raises ValueError if it is malformed"""
+        stages_reported = report.get('stages', {})
+        if not isinstance(stages_reported, dict):
+            raise ValueError('stages must be an object')
+        
+        # Parsed up front, so a bad report changes nothing
+        stages = {}
+        for stage, histogram in stages_reported.items():
+            if stage not in LOAD_STAGES or not isinstance(histogram, dict):
+                raise ValueError(f'Unknown stage: {stage}')
+            stages[stage] = LatencyHistogram.from_report(histogram)
+        cache = {key: int(value) for key, value in report.get('cache', {}).items()}
+        memory = {key: int(value) for key, value in report.get('memory', {}).items()}
+        heap = report.get('heap')
+        if heap is not None:
+            if not isinstance(heap, dict) or not isinstance(heap.get('identifiers', []), list) or \
+               not isinstance(heap.get('sites', []), list) or not isinstance(heap.get('elapsed', 0), int):
+                raise ValueError('heap must be an object with identifiers and sites lists')
+            for entry in heap.get('identifiers', []):
+                if not isinstance(entry, dict) or not isinstance(entry.get('allocs', 0), int):
+                    raise ValueError('heap identifiers must be objects with allocation counts')
+        
+        with self.lock:
+            device = self.devices.pop(device_id, None) or DeviceMetrics()
+            self.devices[device_id] = device
+            while len(self.devices) > self.max_devices:
+                self.devices.popitem(last=False)
+            
+            for stage, histogram in stages.items():
+                device.stages[stage].merge(histogram)
+                self.fleet[stage].merge(histogram)
+            
+            device.reports += 1
+            device.last_seen = time.time()
+            device.uptime = int(report.get('uptime', 0))
+            device.cache = cache
+            device.memory = memory
+            if heap is not None:
+                device.heap = self._with_rates(heap, device.heap)
+            if 'min_free_heap' in memory:
+                lowest = memory['min_free_heap']
+                if device.lowest_free_heap is None or lowest < device.lowest_free_heap:
+                    device.lowest_free_heap = lowest
+            self.reports += 1
+    
+    @staticmethod
+    def _with_rates(heap: Dict[str, Any], previous: Optional[Dict[str, Any]]) -> Dict[str, Any]:
+        """Add allocs/s per identifier since the previous profile, or since profiling began"""
+        elapsed = int(heap.get('elapsed', 0))
+        earlier = {}
+        since = 0
+        # A profile that went back in time was restarted; rate it from zero
+        if previous is not None and int(previous.get('elapsed', 0)) <= elapsed:
+            earlier = {entry.get('name'): int(entry.get('allocs', 0))
+                       for entry in previous.get('identifiers', [])}
+            since = int(previous.get('elapsed', 0))
+        
+        for entry in heap.get('identifiers', []):
+            allocs = int(entry.get('allocs', 0)) - earlier.get(entry.get('name'), 0)
+            window = elapsed - since
+            entry['alloc_rate'] = round(max(allocs, 0) * 1000 / window, 2) if window > 0 else 0
+        return heap
+    
+    def _describe(self, device: DeviceMetrics) -> Dict[str, Any]:
+        return {
+            'stages': {stage: histogram.summary() for stage, histogram in device.stages.items()
+                       if histogram.count > 0},
+            'reports': device.reports,
+            'last_seen': device.last_seen,
+            'uptime_ms': device.uptime,
+            'cache': device.cache,
+            'memory': device.memory,
+            'lowest_free_heap': device.lowest_free_heap,
+            'heap': device.heap
+        }
+    
+    def get_device(self, device_id: str) -> Optional[Dict[str, Any]]:
+        with self.lock:
+            device = self.devices.get(device_id)
+            return self._describe(device) if device is not None else None
+    
+    def get_summary(self) -> Dict[str, Any]:
+        """Fleet-wide stage percentiles, then each device's"""
+        with self.lock:
+            return {
+                'fleet': {stage: histogram.summary() for stage, histogram in self.fleet.items()
+                          if histogram.count > 0},
+                'devices': {device_id: self._describe(device)
+                            for device_id, device in self.devices.items()}
+            }
+    
+    def get_stats(self) -> Dict[str, int]:
+        with self.lock:
+            return {'devices': len(self.devices), 'reports': self.reports}
\ No newline at end of file
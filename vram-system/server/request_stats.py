@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""
+VRAM System - Request Statistics
+Per-thread request counters summed only when read
+"""
+
+import threading
+from typing import Dict, List, Tuple
+
+from latency_histogram import LatencyHistogram
+
+def _cooperative() -> bool:
+    """True under a gevent worker, whose greenlets all share one OS thread"""
+    try:
+        from gevent import monkey
+    except ImportError:
+        return False
+    return monkey.is_module_patched('threading')
+
+class _Shard:
+    """Counters written by one thread only"""
+    
+    __slots__ = ('requests', 'failures', 'total_time', 'latency')
+    
+    def __init__(self):
+        self.requests = 0
+        self.failures = 0
+        self.total_time = 0.0
+        self.latency = LatencyHistogram()
+
+class RequestStats:
+    """
+    Request counters without a shared lock on the request path:
+    - Each serving thread updates its own shard, which no other thread writes
+    - Reading sums every shard; a snapshot taken while requests complete can
+      be a request behind, never torn within one counter
+    - A lock is only taken when a thread records its first request, which is
+      also when shards of finished threads are folded into one, so a server
+      starting a thread per request does not collect shards without end
+    - Under gevent every request is a greenlet of one OS thread, switching
+      only on I/O, so one shard serves them all and no lock is taken at all
+    """
+    
+    def __init__(self):
+        self.local = threading.local()
+        self.shards: List[Tuple[threading.Thread, _Shard]] = []
+        self.retired = _Shard()                   # Totals of threads that have exited
+        self.lock = threading.Lock()
+        self.cooperative = _cooperative()
+    
+    def _shard(self) -> _Shard:
+        if self.cooperative:
+            return self.retired
+        shard = getattr(self.local, 'shard', None)
+        if shard is None:
+            shard = _Shard()
+            with self.lock:
+                self._retire_finished()
+                self.shards.append((threading.current_thread(), shard))
+            self.local.shard = shard
+        return shard
+    
+    def _retire_finished(self):
+        """Fold shards no thread writes any more; lock held"""
+        live = []
+        for thread, shard in self.shards:
+            if thread.is_alive():
+                live.append((thread, shard))
+            else:
+                self.retired.requests += shard.requests
+                self.retired.failures += shard.failures
+                self.retired.total_time += shard.total_time
+                self.retired.latency.merge(shard.latency)
+        self.shards = live
+    
+    def record(self, response_time: float):
+        """Count a completed request; response_time in ms"""
+        shard = self._shard()
+        shard.requests += 1
+        shard.total_time += response_time
+        shard.latency.record(int(response_time * 1000))
+    
+    def record_failure(self):
+        self._shard().failures += 1
+    
+    def snapshot(self) -> Dict[str, float]:
+        """Totals in the shape clients have always been sent, plus percentiles"""
+        latency = LatencyHistogram()
+        with self.lock:
+            shards = [self.retired] + [shard for _, shard in self.shards]
+            requests = sum(shard.requests for shard in shards)
+            total_time = sum(shard.total_time for shard in shards)
+            failures = sum(shard.failures for shard in shards)
+            for shard in shards:
+                latency.merge(shard.latency)
+        return {
+            'total_requests': requests,
+            'avg_response_time': total_time / requests if requests else 0,
+            'p50_response_time': latency.percentile(0.50) / 1000,
+            'p99_response_time': latency.percentile(0.99) / 1000,
+            'failed_requests': failures
+        }
\ No newline at end of file
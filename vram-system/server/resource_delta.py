@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+"""
+VRAM System - Resource Delta
+Binary patches between resource versions that clients apply in place
+"""
+
+from difflib import SequenceMatcher
+from typing import List, Tuple
+
+# Above this many hunks the patch is sent as one whole-resource hunk,
+# since the client shifts the buffer tail once per hunk
+MAX_HUNKS = 64
+
+# Matching is quadratic at worst; larger resources are replaced whole
+MAX_MATCH_SIZE = 64 * 1024
+
+def _hunks(old: bytes, new: bytes) -> List[Tuple[int, int, bytes]]:
+    """Edits turning old into new as (offset, delete, insert) in patched-buffer offsets"""
+    # Trimming the common prefix and suffix keeps the matcher on the changed middle
+    prefix = 0
+    limit = min(len(old), len(new))
+    while prefix < limit and old[prefix] == new[prefix]:
+        prefix += 1
+    suffix = 0
+    while suffix < limit - prefix and old[-1 - suffix] == new[-1 - suffix]:
+        suffix += 1
+    old_middle = old[prefix:len(old) - suffix]
+    new_middle = new[prefix:len(new) - suffix]
+    
+    if not old_middle and not new_middle:
+        return []
+    if len(old_middle) + len(new_middle) > MAX_MATCH_SIZE:
+        return [(prefix, len(old_middle), new_middle)]
+    
+    hunks = []
+    matcher = SequenceMatcher(None, old_middle, new_middle, autojunk=False)
+    for tag, i1, i2, j1, j2 in matcher.get_opcodes():
+        if tag == 'equal':
+            continue
+        # Earlier hunks are already applied, so the buffer matches new up to j1
+        hunks.append((prefix + j1, i2 - i1, new_middle[j1:j2]))
+    
+    if len(hunks) > MAX_HUNKS:
+        return [(prefix, len(old_middle), new_middle)]
+    return hunks
+
+def encode_delta(old: bytes, new: bytes) -> Tuple[bytes, int]:
+    """
+    Encode the patch from old to new
+    
+    Each hunk is a "<offset> <delete> <insert>\\n" line followed by <insert> bytes.
+    Applying one deletes <delete> bytes at <offset>, shifting the tail to make
+    room, and writes the inserted bytes there. Offsets count in the buffer as
+    patched so far, so hunks apply front to back within a single buffer.
+    
+    Returns:
+        (body, capacity): capacity is the largest the buffer gets along the way
+    """
+    frames = []
+    size = len(old)
+    capacity = max(len(old), len(new))
+    for offset, delete, insert in _hunks(old, new):
+        frames.append(f'{offset} {delete} {len(insert)}\n'.encode())
+        frames.append(insert)
+        size += len(insert) - delete
+        capacity = max(capacity, size)
+    return b''.join(frames), capacity
\ No newline at end of file
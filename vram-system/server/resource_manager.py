@@ -9,22 +9,63 @@ import json
 import hashlib
 import shutil
 import logging
+import threading
+import atexit
+import functools
 from datetime import datetime, timedelta
-from typing import Dict, List, Optional, Any
+from typing import Callable, Dict, List, Optional, Sequence, Tuple, Any
 import pickle
 import gzip
+from access_predictor import AccessPredictor
+from resource_delta import encode_delta
+from content_cache import ContentCache
+from blob_store import BlobStore, ENCODING_SUFFIXES
+from resource_manifest import build_manifest, manifest_etag
+
+# Encoded deltas kept in memory, most recently built last
+DELTA_CACHE_SIZE = 32
+
+def synchronized(method):
+    """Run a ResourceManager method under its lock"""
+    @functools.wraps(method)
+    def wrapper(self, *args, **kwargs):
+        with self.lock:
+            return method(self, *args, **kwargs)
+    return wrapper
 
 class ResourceManager:
     """
     Manages resources for the VRAM system including:
     - Resource storage and retrieval
-    - Version management
+    - Version management, with superseded versions kept for delta updates
     - Usage tracking and optimization
     - LRU-based cleanup
+    
+    Content is kept in a BlobStore by hash, with its compressed variants,
+    and resources and their kept versions refer to blobs by that hash.
+    
+    Metadata lives in memory. Changes to it, access counters included, only
+    mark it dirty; it is written out at most once per flush interval, as is
+    the access log. Reads are served from an in-memory content cache.
+    
+    Every public method may be called from any serving thread. Metadata is
+    only touched under one reentrant lock, which reads of blobs never hold.
     """
     
-    def __init__(self, resource_dir: str):
+    def __init__(self, resource_dir: str, history_depth: int = 4, flush_interval: float = 2.0):
         self.resource_dir = os.path.abspath(resource_dir)
+        self.history_depth = history_depth        # Superseded versions kept per resource
+        self.flush_interval = flush_interval      # Seconds a metadata or access log change may wait on disk
+        self.lock = threading.RLock()
+        self.flush_lock = threading.Lock()        # Keeps snapshots from landing out of order
+        self.metadata_dirty = False
+        self.pending_accesses: List[str] = []
+        self.write_stats = {'metadata_writes': 0, 'coalesced_updates': 0, 'access_log_writes': 0}
+        self.content_cache = ContentCache()
+        self.delta_cache: Dict[tuple, Dict[str, Any]] = {}
+        self.change_listeners: List[Callable[[str, int, Optional[str]], None]] = []
+        self.catalog_version = 0                  # Bumped whenever a listed field may have changed
+        self.manifest: Optional[Tuple[int, bytes, str]] = None   # catalog_version, manifest, ETag
         self.metadata_file = os.path.join(self.resource_dir, 'metadata.json')
         self.access_log_file = os.path.join(self.resource_dir, 'access.log')
         
@@ -33,6 +74,18 @@ class ResourceManager:
         
         # Load or create metadata
         self.metadata = self._load_metadata()
+        self.blobs = BlobStore(os.path.join(self.resource_dir, 'blobs'))
+        self._migrate_legacy_files()
+        
+        # Learn access sequences from earlier runs
+        self.predictor = AccessPredictor()
+        self.predictor.load_log(self.access_log_file)
+        
+        # Pending writes go out from a background thread, and once more at exit
+        self._stop_flushing = threading.Event()
+        self._flusher = threading.Thread(target=self._flush_loop, name='metadata-flush', daemon=True)
+        self._flusher.start()
+        atexit.register(self.close)
         
         logging.info(f"ResourceManager initialized with directory: {self.resource_dir}")
     
@@ -52,23 +105,157 @@ class ResourceManager:
             'last_updated': datetime.now().isoformat()
         }
     
-    def _save_metadata(self):
-        """Save metadata to file"""
-        try:
-            self.metadata['last_updated'] = datetime.now().isoformat()
-            with open(self.metadata_file, 'w') as f:
-                json.dump(self.metadata, f, indent=2)
-        except Exception as e:
-            logging.error(f"Error saving metadata: {e}")
+    def _mark_dirty(self):
+        """Note a metadata change for the next flush"""
+        with self.lock:
+            self.metadata_dirty = True
+            self.write_stats['coalesced_updates'] += 1
+    
+    def _flush_loop(self):
+        while not self._stop_flushing.wait(self.flush_interval):
+            self.flush()
+    
+    def flush(self):
+        """Write pending metadata and access log entries now"""
+        with self.flush_lock:
+            with self.lock:
+                accesses, self.pending_accesses = self.pending_accesses, []
+                snapshot = None
+                if self.metadata_dirty:
+                    self.metadata['last_updated'] = datetime.now().isoformat()
+                    snapshot = json.dumps(self.metadata, indent=2)
+                    self.metadata_dirty = False
+            
+            # Disk work happens outside the lock, so requests are not held up by it
+            if accesses:
+                try:
+                    with open(self.access_log_file, 'a') as f:
+                        f.writelines(accesses)
+                    self.write_stats['access_log_writes'] += 1
+                except Exception as e:
+                    logging.error(f"Error writing access log: {e}")
+            
+            if snapshot is not None:
+                try:
+                    # Written aside and renamed, so a crash never leaves half a file
+                    temp_file = self.metadata_file + '.tmp'
+                    with open(temp_file, 'w') as f:
+                        f.write(snapshot)
+                    os.replace(temp_file, self.metadata_file)
+                    self.write_stats['metadata_writes'] += 1
+                except Exception as e:
+                    logging.error(f"Error saving metadata: {e}")
+                    self._mark_dirty()
+    
+    def close(self):
+        """Stop the flush thread and write whatever is pending"""
+        self._stop_flushing.set()
+        self.flush()
+    
+    def _get_legacy_path(self, resource_id: str, version: Optional[int] = None) -> str:
+        """Where resources were stored by ID before the blob store"""
+        if version is None:
+            return os.path.join(self.resource_dir, f"{resource_id}.dat")
+        return os.path.join(self.resource_dir, f"{resource_id}.v{version}.dat")
+    
+    def _migrate_legacy_files(self):
+        """Move files stored by ID into the blob store"""
+        moved = 0
+        for resource_id, resource_meta in self.metadata['resources'].items():
+            kept = [(None, resource_meta)] + [(old['version'], old) for old in resource_meta.get('history', [])]
+            for version, entry in kept:
+                legacy_path = self._get_legacy_path(resource_id, version)
+                if not os.path.exists(legacy_path):
+                    continue
+                with open(legacy_path, 'rb') as f:
+                    data = f.read()
+                if self._calculate_hash(data) == entry.get('hash'):
+                    encodings = self.blobs.put(entry['hash'], data)
+                    if version is None:
+                        resource_meta['encodings'] = encodings
+                    os.remove(legacy_path)
+                    moved += 1
+        if moved:
+            logging.info(f"Moved {moved} resource files into the blob store")
+            self._mark_dirty()
+    
+    def _referenced_hashes(self) -> set:
+        """Hashes of every current and kept version"""
+        hashes = set()
+        for resource_meta in self.metadata['resources'].values():
+            hashes.add(resource_meta.get('hash'))
+            hashes.update(old.get('hash') for old in resource_meta.get('history', []))
+        return hashes
+    
+    def _release_blobs(self, hashes):
+        """Remove blobs that nothing refers to any more"""
+        referenced = self._referenced_hashes()
+        for data_hash in set(hashes) - referenced:
+            if not data_hash:
+                continue
+            self.blobs.remove(data_hash)
+            for key in [data_hash] + [data_hash + suffix for suffix in ENCODING_SUFFIXES.values()]:
+                self.content_cache.discard(key)
+    
+    def _archive_version(self, resource_id: str, previous: Dict[str, Any]) -> List[Dict[str, Any]]:
+        """Keep the current content as a superseded version; returns the trimmed history"""
+        history = list(previous.get('history', []))
+        if self.history_depth > 0:
+            version = previous.get('version', 1)
+            history.append({'version': version, 'hash': previous.get('hash'), 'size': previous.get('size', 0)})
+        
+        # Blobs of dropped versions are released once the new metadata is in place
+        while len(history) > self.history_depth:
+            history.pop(0)
+        return history
+    
+    def _forget_deltas(self, resource_id: str):
+        """Drop cached deltas of a resource that changed or went away"""
+        for key in [key for key in self.delta_cache if key[0] == resource_id]:
+            del self.delta_cache[key]
+    
+    def add_change_listener(self, listener: Callable[[str, int, Optional[str]], None]):
+        """Call listener(resource_id, version, hash) when content changes; (id, 0, None) on deletion"""
+        self.change_listeners.append(listener)
     
-    def _get_file_path(self, resource_id: str) -> str:
-        """Get the file path for a resource"""
-        return os.path.join(self.resource_dir, f"{resource_id}.dat")
+    def _notify_change(self, resource_id: str, version: int, data_hash: Optional[str]):
+        for listener in self.change_listeners:
+            try:
+                listener(resource_id, version, data_hash)
+            except Exception as e:
+                logging.error(f"Change listener failed for {resource_id}: {e}")
     
     def _calculate_hash(self, data: bytes) -> str:
         """Calculate SHA256 hash of data"""
         return hashlib.sha256(data).hexdigest()
     
+    def _read_blob(self, data_hash: Optional[str], encoding: Optional[str] = None) -> bytes:
+        """A blob or one of its variants, from the content cache or disk"""
+        if not data_hash:
+            raise FileNotFoundError('Resource has no content hash')
+        key = data_hash + (ENCODING_SUFFIXES[encoding] if encoding else '')
+        data = self.content_cache.get(key, data_hash)
+        if data is not None:
+            return data
+        
+        data = self.blobs.read(data_hash, encoding)
+        # Variants were built from a checked blob; the blob itself is checked on every fill
+        if encoding or self._calculate_hash(data) == data_hash:
+            self.content_cache.put(key, data_hash, data)
+        else:
+            logging.warning(f"Blob {data_hash[:16]} does not match its hash, not cached")
+        return data
+    
+    def _record_read(self, resource_id: str):
+        """Count a read in memory; it reaches disk with the next flush"""
+        with self.lock:
+            resource_meta = self.metadata['resources'].get(resource_id)
+            if resource_meta:
+                resource_meta['last_accessed'] = datetime.now().isoformat()
+                resource_meta['access_count'] = resource_meta.get('access_count', 0) + 1
+                self._mark_dirty()
+    
+    @synchronized
     def store_resource(self, resource_id: str, content: Any, category: str = 'general', priority: int = 1) -> bool:
         """
         Store a resource with metadata
@@ -92,24 +279,49 @@ class ResourceManager:
                 # Serialize objects
                 data = pickle.dumps(content)
             
-            # Store the file
-            file_path = self._get_file_path(resource_id)
-            with open(file_path, 'wb') as f:
-                f.write(data)
+            # Replacing a resource bumps its version only when the content changed,
+            # so clients can revalidate cached copies by version. The replaced
+            # content is kept so those clients can be sent a delta instead.
+            data_hash = self._calculate_hash(data)
+            version = 1
+            history = []
+            changed = True
+            released = []
+            previous = self.metadata['resources'].get(resource_id)
+            if previous:
+                version = previous.get('version', 1)
+                history = previous.get('history', [])
+                changed = previous.get('hash') != data_hash
+                if changed:
+                    released = [previous.get('hash')] + [old.get('hash') for old in history]
+                    history = self._archive_version(resource_id, previous)
+                    version += 1
+                    self._forget_deltas(resource_id)
+            
+            # Content already stored for another resource or version is not written again,
+            # and its compressed variants are reused
+            encodings = self.blobs.put(data_hash, data)
+            self.content_cache.put(data_hash, data_hash, data)
             
             # Update metadata
             self.metadata['resources'][resource_id] = {
                 'size': len(data),
-                'hash': self._calculate_hash(data),
+                'hash': data_hash,
                 'category': category,
                 'priority': priority,
                 'created': datetime.now().isoformat(),
                 'last_accessed': datetime.now().isoformat(),
                 'access_count': 0,
-                'version': 1
+                'version': version,
+                'history': history,
+                'encodings': encodings
             }
             
-            self._save_metadata()
+            self._release_blobs(released)
+            self._mark_dirty()
+            self.catalog_version += 1             # Priority or category may change without the content
+            if changed:
+                self._notify_change(resource_id, version, data_hash)
             logging.info(f"Stored resource {resource_id} ({len(data)} bytes)")
             return True
             
@@ -127,31 +339,63 @@ class ResourceManager:
         Returns:
             bytes: Resource data or None if not found
         """
+        body = self.get_resource_body(resource_id)
+        return body[0] if body else None
+    
+    def get_resource_body(self, resource_id: str,
+                          encodings: Sequence[str] = ()) -> Optional[Tuple[bytes, str, Dict[str, Any]]]:
+        """
+        Retrieve a resource as it is sent, precompressed when possible
+        
+        Args:
+            resource_id: The resource identifier
+            encodings: Acceptable encodings, most preferred first
+        
+        Returns:
+            (body, encoding, version_info): the first precomputed variant the
+            caller accepts, or the plain content with encoding 'none', and
+            the version info of the metadata it was read for, so headers
+            always describe the bytes sent; None if not found
+        """
         try:
-            if resource_id not in self.metadata['resources']:
-                return None
+            with self.lock:
+                resource_meta = self.metadata['resources'].get(resource_id)
+                if resource_meta is None:
+                    return None
+                data_hash = resource_meta.get('hash')
+                available = resource_meta.get('encodings', {})
+                encoding = next((name for name in encodings if name in available), None)
+                version_info = self._version_info(resource_id, resource_meta)
             
-            file_path = self._get_file_path(resource_id)
-            if not os.path.exists(file_path):
-                # Clean up orphaned metadata
-                del self.metadata['resources'][resource_id]
-                self._save_metadata()
-                return None
-            
-            with open(file_path, 'rb') as f:
-                data = f.read()
+            # Only a content cache miss touches the disk, and not under the lock
+            try:
+                body = self._read_blob(data_hash, encoding)
+            except FileNotFoundError:
+                with self.lock:
+                    replaced = self.metadata['resources'].get(resource_id) is not resource_meta
+                if replaced:
+                    # Updated or deleted while being read; its old blob may be gone
+                    return self.get_resource_body(resource_id, encodings)
+                if encoding is None:
+                    # Clean up orphaned metadata
+                    with self.lock:
+                        if self.metadata['resources'].get(resource_id) is resource_meta:
+                            del self.metadata['resources'][resource_id]
+                            self._mark_dirty()
+                    return None
+                logging.warning(f"Missing {encoding} variant of {resource_id}, sending it plain")
+                return self.get_resource_body(resource_id)
             
             # Update access information
-            self.metadata['resources'][resource_id]['last_accessed'] = datetime.now().isoformat()
-            self.metadata['resources'][resource_id]['access_count'] += 1
-            self._save_metadata()
+            self._record_read(resource_id)
             
-            return data
+            return body, encoding or 'none', version_info
             
         except Exception as e:
             logging.error(f"Error retrieving resource {resource_id}: {e}")
             return None
     
+    @synchronized
     def delete_resource(self, resource_id: str) -> bool:
         """
         Delete a resource
@@ -163,15 +407,19 @@ class ResourceManager:
             bool: True if successful, False otherwise
         """
         try:
-            if resource_id not in self.metadata['resources']:
+            resource_meta = self.metadata['resources'].get(resource_id)
+            if resource_meta is None:
                 return False
             
-            file_path = self._get_file_path(resource_id)
-            if os.path.exists(file_path):
-                os.remove(file_path)
-            
+            # Blobs shared with other resources stay
             del self.metadata['resources'][resource_id]
-            self._save_metadata()
+            self._release_blobs([resource_meta.get('hash')] +
+                                [old.get('hash') for old in resource_meta.get('history', [])])
+            self._forget_deltas(resource_id)
+            self._mark_dirty()
+            self.catalog_version += 1
+            self.predictor.forget(resource_id)
+            self._notify_change(resource_id, 0, None)
             
             logging.info(f"Deleted resource {resource_id}")
             return True
@@ -180,6 +428,7 @@ class ResourceManager:
             logging.error(f"Error deleting resource {resource_id}: {e}")
             return False
     
+    @synchronized
     def list_resources(self, category: Optional[str] = None, max_size: Optional[int] = None, 
                       page: int = 1, per_page: int = 50) -> List[Dict[str, Any]]:
         """
@@ -224,10 +473,23 @@ class ResourceManager:
         
         return resources[start_idx:end_idx]
     
+    @synchronized
     def get_all_resources(self) -> Dict[str, Dict[str, Any]]:
-        """Get all resource metadata"""
-        return self.metadata['resources']
+        """Get all resource metadata, as a copy that later updates do not touch"""
+        return {resource_id: dict(meta) for resource_id, meta in self.metadata['resources'].items()}
+    
+    @synchronized
+    def get_manifest(self) -> Tuple[bytes, str]:
+        """Binary manifest of every resource and its ETag, rebuilt only after a change"""
+        if self.manifest is None or self.manifest[0] != self.catalog_version:
+            manifest = build_manifest(self.metadata['resources'])
+            self.manifest = (self.catalog_version, manifest, manifest_etag(manifest))
+        return self.manifest[1], self.manifest[2]
     
+    def count_resources(self) -> int:
+        return len(self.metadata['resources'])
+    
+    @synchronized
     def get_version_info(self, resource_id: str) -> Optional[Dict[str, Any]]:
         """
         Get version information for a resource
@@ -240,32 +502,113 @@ class ResourceManager:
         """
         if resource_id not in self.metadata['resources']:
             return None
+        return self._version_info(resource_id, self.metadata['resources'][resource_id])
         
-        resource_meta = self.metadata['resources'][resource_id]
+    @staticmethod
+    def _version_info(resource_id: str, resource_meta: Dict[str, Any]) -> Dict[str, Any]:
         return {
             'resource_id': resource_id,
             'version': resource_meta.get('version', 1),
             'hash': resource_meta.get('hash'),
             'size': resource_meta.get('size', 0),
             'last_modified': resource_meta.get('created'),
-            'priority': resource_meta.get('priority', 3)
+            'priority': resource_meta.get('priority', 3),
+            'delta_from': [old['version'] for old in resource_meta.get('history', [])]
         }
     
-    def log_access(self, resource_id: str, client_ip: str = 'unknown'):
-        """Log resource access for analytics"""
+    def get_delta(self, resource_id: str, from_version: int, 
+                  base_hash: Optional[str] = None) -> Optional[Dict[str, Any]]:
+        """
+        Get the patch from a kept version of a resource to its current content
+        
+        Args:
+            resource_id: The resource identifier
+            from_version: Version the client holds
+            base_hash: Prefix of the content hash the client holds, if known
+        
+        Returns:
+            Dictionary with the encoded delta and the target version info,
+            or None if that version is not kept or its hash does not match
+        """
+        with self.lock:
+            resource_meta = self.metadata['resources'].get(resource_id)
+            if not resource_meta:
+                return None
+            
+            base = next((old for old in resource_meta.get('history', []) 
+                         if old['version'] == from_version), None)
+            if base is None or (base_hash and not (base.get('hash') or '').startswith(base_hash)):
+                return None
+            
+            key = (resource_id, from_version, resource_meta.get('version', 1))
+            cached = self.delta_cache.pop(key, None)
+            if cached is not None:
+                self.delta_cache[key] = cached
+            old_hash = base.get('hash')
+            new_hash = resource_meta.get('hash')
+        
+        if cached is None:
+            # Blob reads and the diff run without the lock, like any read of content
+            try:
+                old_data = self._read_blob(old_hash)
+                new_data = self._read_blob(new_hash)
+            except OSError as e:
+                logging.error(f"Error reading versions of {resource_id}: {e}")
+                return None
+            
+            body, capacity = encode_delta(old_data, new_data)
+            cached = {
+                'body': body,
+                'capacity': capacity,
+                'base_version': from_version
+            }
+            with self.lock:
+                # A delta of a resource that changed meanwhile is still sent, not kept
+                current = self.metadata['resources'].get(resource_id)
+                if current is not None and current.get('version', 1) == key[2]:
+                    if len(self.delta_cache) >= DELTA_CACHE_SIZE:
+                        del self.delta_cache[next(iter(self.delta_cache))]
+                    self.delta_cache[key] = cached
+        
+        # Served like a read of the resource
+        self._record_read(resource_id)
+        return cached
+    
+    def log_access(self, resource_id: str, client_ip: str = 'unknown', prefetch: bool = False):
+        """Log resource access for analytics; prefetches are logged but not learned from"""
         try:
             log_entry = {
                 'timestamp': datetime.now().isoformat(),
                 'resource_id': resource_id,
                 'client_ip': client_ip
             }
+            if prefetch:
+                log_entry['prefetch'] = True
+            else:
+                self.predictor.record(resource_id, client_ip)
             
-            with open(self.access_log_file, 'a') as f:
-                f.write(json.dumps(log_entry) + '\n')
+            # Appended with the next flush
+            with self.lock:
+                self.pending_accesses.append(json.dumps(log_entry) + '\n')
                 
         except Exception as e:
             logging.error(f"Error logging access: {e}")
     
+    def get_prefetch_hints(self, resource_ids: List[str], limit: int = 3) -> List[str]:
+        """
+        Get resources likely to be requested after resource_ids
+        
+        Args:
+            resource_ids: Resources the client just requested
+            limit: Maximum number of hints
+        
+        Returns:
+            List of existing resource IDs, most likely first
+        """
+        hints = self.predictor.predict(resource_ids, limit)
+        return [rid for rid in hints if rid in self.metadata['resources']]
+    
+    @synchronized
     def get_usage_stats(self) -> Dict[str, Any]:
         """Get usage statistics"""
         total_resources = len(self.metadata['resources'])
@@ -293,7 +636,20 @@ class ResourceManager:
             'total_size_mb': round(total_size / (1024 * 1024), 2),
             'categories': categories,
             'most_accessed': most_accessed,
-            'disk_usage': self._get_disk_usage()
+            'disk_usage': self._get_disk_usage(),
+            'content_cache': self.content_cache.get_stats(),
+            'blob_store': self._get_blob_usage(total_size),
+            'metadata_writes': dict(self.write_stats)
+        }
+    
+    def _get_blob_usage(self, total_size: int) -> Dict[str, int]:
+        """Current versions by blob; shared content counts once"""
+        stored = {meta.get('hash'): meta.get('size', 0) for meta in self.metadata['resources'].values()}
+        stored_size = sum(stored.values())
+        return {
+            'blobs': len(stored),
+            'stored_bytes': stored_size,
+            'dedup_saved_bytes': total_size - stored_size
         }
     
     def _get_disk_usage(self) -> Dict[str, int]:
@@ -309,6 +665,7 @@ class ResourceManager:
         except Exception:
             return {'error': 'Unable to get disk usage'}
     
+    @synchronized
     def optimize_storage(self, max_size: Optional[int] = None) -> Dict[str, Any]:
         """
         Optimize storage by removing least recently used resources
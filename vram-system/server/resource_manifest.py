@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""
+VRAM System - Resource Manifest
+Fixed-width binary listing of every resource, walked in place by clients
+"""
+
+import hashlib
+import struct
+from typing import Any, Dict, List, Tuple
+
+# Layout shared with the device's resource_manifest.h; all fields little-endian
+MANIFEST_MAGIC = b'VRMF'
+MANIFEST_FORMAT = 1
+HEADER = struct.Struct('<4sBBHHHI')         # magic, format, record size, records, categories, reserved, total bytes
+RECORD = struct.Struct('<IIIBBH')           # id hash, size, version, priority, category, reserved
+ETAG_LENGTH = 16
+
+# The device sizes its receive buffer from MANIFEST_MAX_RECORDS and
+# MANIFEST_MAX_NAMES in resource_manifest.h; larger catalogs are refused here
+MAX_RECORDS = 1024
+MAX_NAMES_SIZE = 2048                       # Category names, NULs included
+MAX_CATEGORIES = 0xFF
+
+class ManifestLimitError(ValueError):
+    """The catalog no longer fits in a manifest clients can hold"""
+
+def id_hash(resource_id: str) -> int:
+    """32-bit FNV-1a of the UTF-8 ID, as ResourceCache::hashKey() on the device"""
+    value = 2166136261
+    for byte in resource_id.encode('utf-8'):
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value
+
+def build_manifest(resources: Dict[str, Dict[str, Any]]) -> bytes:
+    """
+    Manifest of the given resource metadata:
+    - A 16-byte header, then one 16-byte record per resource sorted by ID
+      hash, so a client can binary search it without parsing anything
+    - Category names follow as NUL-terminated strings; a record's category
+      is an index into them
+    - IDs themselves are not sent: clients look resources up by the hash of
+      the ID they already have, and two IDs sharing a hash read as the first
+    """
+    categories = sorted({meta.get('category', 'unknown') for meta in resources.values()})
+    names_size = sum(len(name.encode('utf-8')) + 1 for name in categories)
+    if len(resources) > MAX_RECORDS:
+        raise ManifestLimitError(f'{len(resources)} resources; a manifest lists at most {MAX_RECORDS}')
+    if len(categories) > MAX_CATEGORIES or names_size > MAX_NAMES_SIZE:
+        raise ManifestLimitError(f'{len(categories)} categories in {names_size} bytes; a manifest holds '
+                                 f'at most {MAX_CATEGORIES} in {MAX_NAMES_SIZE} bytes')
+    codes = {name: code for code, name in enumerate(categories)}
+    
+    records: List[Tuple[int, int, int, int, int]] = []
+    for resource_id, meta in resources.items():
+        records.append((id_hash(resource_id),
+                        min(int(meta.get('size', 0)), 0xFFFFFFFF),
+                        min(int(meta.get('version', 1)), 0xFFFFFFFF),
+                        max(0, min(int(meta.get('priority', 3)), 0xFF)),
+                        codes[meta.get('category', 'unknown')]))
+    records.sort()
+    
+    total_size = min(sum(record[1] for record in records), 0xFFFFFFFF)
+    parts = [HEADER.pack(MANIFEST_MAGIC, MANIFEST_FORMAT, RECORD.size,
+                         len(records), len(categories), 0, total_size)]
+    parts.extend(RECORD.pack(*record, 0) for record in records)
+    parts.extend(name.encode('utf-8') + b'\0' for name in categories)
+    return b''.join(parts)
+
+def manifest_etag(manifest: bytes) -> str:
+    return hashlib.sha256(manifest).hexdigest()[:ETAG_LENGTH]
+
+def parse_manifest(manifest: bytes) -> Dict[str, Any]:
+    """Readable form of a manifest, for tests and debugging"""
+    magic, format_version, record_size, count, category_count, _, total_size = \
+        HEADER.unpack_from(manifest, 0)
+    if magic != MANIFEST_MAGIC or format_version != MANIFEST_FORMAT or record_size != RECORD.size:
+        raise ValueError('Not a manifest this version understands')
+    
+    offset = HEADER.size + count * RECORD.size
+    categories = manifest[offset:].split(b'\0')[:category_count]
+    records = []
+    for index in range(count):
+        hash_value, size, version, priority, category, _ = \
+            RECORD.unpack_from(manifest, HEADER.size + index * RECORD.size)
+        records.append({'id_hash': hash_value, 'size': size, 'version': version,
+                        'priority': priority, 'category': categories[category].decode('utf-8')})
+    return {'total_size': total_size, 'records': records}
\ No newline at end of file
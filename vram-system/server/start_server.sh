@@ -1,6 +1,13 @@
 #!/bin/bash
 
 # VRAM System Server Startup Script
+# Usage: ./start_server.sh [--production]
+#   --production  Serve with gunicorn (gunicorn.conf.py) instead of Flask's development server
+
+MODE=development
+if [ "$1" = "--production" ]; then
+    MODE=production
+fi
 
 echo "Starting VRAM System Server..."
 echo "================================"
@@ -19,10 +26,26 @@ if [ $? -ne 0 ]; then
     pip3 install -r requirements.txt
 fi
 
+if [ "$MODE" = production ]; then
+    python3 -c "import gunicorn, gevent" 2>/dev/null
+    if [ $? -ne 0 ]; then
+        echo "Installing required packages..."
+        pip3 install -r requirements.txt
+    fi
+fi
+
 # Create resources directory if it doesn't exist
 mkdir -p resources
 
 # Start the server
+if [ "$MODE" = production ]; then
+    echo "Starting gunicorn on ${VRAM_BIND:-0.0.0.0:5000} (gevent, ${VRAM_CONNECTIONS:-2048} connections)"
+    echo "Press Ctrl+C to stop the server"
+    echo "================================"
+    
+    exec python3 -m gunicorn -c gunicorn.conf.py app:app
+fi
+
 echo "Starting Flask server on http://0.0.0.0:5000"
 echo "Press Ctrl+C to stop the server"
 echo "================================"
@@ -125,11 +125,76 @@ run_test "Optimization Endpoint" \
     "curl -s -X POST $SERVER_URL/api/optimize -H 'Content-Type: application/json' -d '{}'" \
     '"message":"Optimization completed"'
 
+# Test 11: Get raw resource bytes
+run_test "Get Raw Resource" \
+    "curl -s -i $SERVER_URL/api/resources/config_main/raw" \
+    'X-Resource-Size: [0-9]+'
+
+# Test 12: Batch fetch
+run_test "Batch Resource Fetch" \
+    "curl -s -X POST $SERVER_URL/api/resources/batch -H 'Content-Type: application/json' -d '{\"resources\": [{\"id\": \"config_main\", \"version\": 0}, \"missing_resource\"]}'" \
+    '^200 config_main [0-9]+ .*404 missing_resource'
+
+# Test 13: Conditional revalidation
+run_test "Resource Revalidation" \
+    "etag=\$(curl -s -i $SERVER_URL/api/resources/config_main/raw | tr -d '\\r' | sed -n 's/^ETag: //Ip'); curl -s -o /dev/null -w '%{http_code}' -H \"If-None-Match: \$etag\" $SERVER_URL/api/resources/config_main/raw" \
+    '^304$'
+
+# Test 14: Prefetch hints learned from access sequences
+run_test "Prefetch Hints" \
+    "for i in 1 2; do curl -s -o /dev/null $SERVER_URL/api/resources/lib_sensor/raw; curl -s -o /dev/null $SERVER_URL/api/resources/data_sample/raw; done; curl -s -i $SERVER_URL/api/resources/lib_sensor/raw | tr -d '\\r'" \
+    'X-Prefetch-Hints: [A-Za-z0-9_,]*data_sample'
+
+# Test 15: Delta against the version before an update
+run_test "Resource Delta" \
+    "curl -s -o /dev/null -X POST $SERVER_URL/api/resources -H 'Content-Type: application/json' -d '{\"resource_id\":\"test_delta\",\"content\":\"delta base\",\"category\":\"test\",\"priority\":3}'; from=\$(curl -s $SERVER_URL/api/resources/test_delta/version | sed -n 's/.*\"version\": *\\([0-9]*\\).*/\\1/p'); curl -s -o /dev/null -X POST $SERVER_URL/api/resources -H 'Content-Type: application/json' -d '{\"resource_id\":\"test_delta\",\"content\":\"delta case\",\"category\":\"test\",\"priority\":3}'; curl -s -i \"$SERVER_URL/api/resources/test_delta/delta?from=\$from\" | tr -d '\\r'; curl -s -o /dev/null -X DELETE $SERVER_URL/api/resources/test_delta" \
+    'X-Delta-Capacity: 10.*6 1 1'
+
+# Test 16: Event stream opens with a heartbeat
+run_test "Event Stream Heartbeat" \
+    "curl -s -N --max-time 2 $SERVER_URL/api/events; true" \
+    'event: heartbeat'
+
+# Test 17: Invalidation pushed when a resource changes
+run_test "Invalidation Event" \
+    "events=\$(mktemp); curl -s -N --max-time 3 $SERVER_URL/api/events > \$events & sleep 1; curl -s -o /dev/null -X POST $SERVER_URL/api/resources -H 'Content-Type: application/json' -d '{\"resource_id\":\"test_event\",\"content\":\"event data\",\"category\":\"test\",\"priority\":3}'; curl -s -o /dev/null -X DELETE $SERVER_URL/api/resources/test_event; wait; cat \$events; rm -f \$events" \
+    'data: test_event 1 [0-9a-f]+.*data: test_event 0 -'
+
+# Test 18: Compressed variant served as stored at upload
+run_test "Precompressed Resource" \
+    "curl -s -o /dev/null -X POST $SERVER_URL/api/resources -H 'Content-Type: application/json' -d \"{\\\"resource_id\\\":\\\"test_packed\\\",\\\"content\\\":\\\"\$(printf 'packed %.0s' {1..200})\\\",\\\"category\\\":\\\"test\\\",\\\"priority\\\":3}\"; curl -s -i '$SERVER_URL/api/resources/test_packed/raw?compress=true' -o - | tr -d '\\r' | grep -a '^X-Resource-Compression'; curl -s -o /dev/null -X DELETE $SERVER_URL/api/resources/test_packed" \
+    'X-Resource-Compression: deflate'
+
+# Test 19: Device stage histograms reported and summarised
+run_test "Device Metrics" \
+    "curl -s -o /dev/null -X POST $SERVER_URL/api/metrics -H 'Content-Type: application/json' -d '{\"device\":\"test_device\",\"uptime\":1000,\"interval\":1000,\"stages\":{\"first_byte\":{\"n\":2,\"sum\":300,\"max\":200,\"b\":[22,1,26,1]}},\"cache\":{\"hits\":1},\"memory\":{\"min_free_heap\":100000}}'; curl -s '$SERVER_URL/api/metrics?device=test_device'" \
+    '"first_byte": *\{[^}]*"p99_us": *200'
+
+# Test 20: Allocation rate from consecutive heap profiles
+run_test "Heap Profile" \
+    "for a in 10 70; do curl -s -o /dev/null -X POST $SERVER_URL/api/metrics -H 'Content-Type: application/json' -d \"{\\\"device\\\":\\\"test_heap\\\",\\\"heap\\\":{\\\"sample_bytes\\\":8192,\\\"elapsed\\\":\$((a * 1000)),\\\"identifiers\\\":[{\\\"name\\\":\\\"cache\\\",\\\"live\\\":4096,\\\"allocs\\\":\$((a * 2))}],\\\"sites\\\":[]}}\"; done; curl -s '$SERVER_URL/api/metrics?device=test_heap'" \
+    '"alloc_rate": *2\.0'
+
+# Test 21: Binary manifest revalidated by ETag
+run_test "Resource Manifest" \
+    "curl -s $SERVER_URL/api/manifest | head -c 4; echo; etag=\$(curl -s -I $SERVER_URL/api/manifest | tr -d '\\r' | sed -n 's/^ETag: *//Ip'); curl -s -o /dev/null -w '%{http_code}' -H \"If-None-Match: \$etag\" $SERVER_URL/api/manifest" \
+    'VRMF.*304'
+
+# Test 22: IDs the device cannot store are refused
+run_test "Long Resource ID Rejected" \
+    "curl -s -o /dev/null -w '%{http_code}' -X POST $SERVER_URL/api/resources -H 'Content-Type: application/json' -d '{\"resource_id\":\"a_resource_id_of_thirty_two_byte\",\"content\":\"x\"}'" \
+    '^400$'
+
+# Test 23: HTTP/1.1 responses keep the connection open for the next request
+run_test "Connection Reuse" \
+    "curl -s -v --http1.1 -o /dev/null -o /dev/null $SERVER_URL/api/health $SERVER_URL/api/resources/config_main/version 2>&1 | tr -d '\\r' | grep -E '^< HTTP/|Re-?using existing connection'" \
+    'HTTP/1\.1 200.*Re-?using existing connection.*HTTP/1\.1 200'
+
 echo ""
 echo "Running performance tests..."
 echo "============================"
 
-# Test 11: Response time check
+# Test 24: Response time check
 start_time=$(date +%s%N)
 curl -s "$SERVER_URL/api/health" >/dev/null
 end_time=$(date +%s%N)
@@ -143,7 +208,7 @@ else
     ((TESTS_FAILED++))
 fi
 
-# Test 12: Concurrent requests
+# Test 25: Concurrent requests
 echo -n "Concurrent Requests... "
 concurrent_results=$(for i in {1..10}; do curl -s "$SERVER_URL/api/health" & done; wait)
 concurrent_success=$(echo "$concurrent_results" | grep -c '"status":"healthy"')
@@ -160,17 +225,41 @@ echo ""
 echo "Testing file structure..."
 echo "========================"
 
-# Test 13: Check required files exist
+# Test 26: Check required files exist
 required_files=(
     "server/app.py"
     "server/resource_manager.py"
+    "server/access_predictor.py"
+    "server/resource_delta.py"
+    "server/event_channel.py"
+    "server/content_cache.py"
+    "server/blob_store.py"
+    "server/request_stats.py"
+    "server/gunicorn.conf.py"
+    "server/latency_histogram.py"
+    "server/metrics_store.py"
+    "server/resource_manifest.py"
     "server/requirements.txt"
     "server/start_server.sh"
     "m5client/vram_client.ino"
     "m5client/memory_manager.h"
+    "m5client/memory_pressure.h"
     "m5client/resource_cache.h"
+    "m5client/eviction_policy.h"
+    "m5client/psram_tier.h"
+    "m5client/persistent_store.h"
+    "m5client/resource_loader.h"
+    "m5client/gzip_inflater.h"
+    "m5client/vram_log.h"
+    "m5client/http_session.h"
+    "m5client/async_loader.h"
     "m5client/wifi_manager.h"
+    "m5client/event_channel.h"
+    "m5client/status_display.h"
+    "m5client/load_metrics.h"
+    "m5client/resource_manifest.h"
     "examples/basic_usage.ino"
+    "examples/benchmark/benchmark.ino"
     "README.md"
     ".gitignore"
 )
@@ -193,7 +282,7 @@ else
     ((TESTS_FAILED++))
 fi
 
-# Test 14: Check file sizes are reasonable
+# Test 27: Check file sizes are reasonable
 echo -n "File Size Check... "
 total_size=$(du -sb . | cut -f1)
 if [ $total_size -lt 1048576 ]; then  # Less than 1MB